@@ -2,35 +2,45 @@
 sourcedir="../src/Shader"
 assetdir="../assets"
 
+# compile_shader <source> <output name without extension> [additional shadercross arguments]
+compile_shader() {
+	filepath="$1"
+	outname="$2"
+	shift 2
+	echo "compiling $filepath -> $outname $*"
+	shadercross "$filepath" -o "${assetdir}/Shaders/SPIRV/${outname}.spv" "$@"
+	shadercross "$filepath" -o "${assetdir}/Shaders/MSL/${outname}.msl" "$@"
+	shadercross "$filepath" -o "${assetdir}/Shaders/DXIL/${outname}.dxil" "$@"
+}
+
 for filepath in "${sourcedir}"/*.vert.hlsl; do
     if [ -f "$filepath" ]; then
 		filename="${filepath##*/}"	
-		echo "compiling $filepath"
-        shadercross "$filepath" -o "${assetdir}/Shaders/SPIRV/${filename/.hlsl/.spv}"
-        shadercross "$filepath" -o "${assetdir}/Shaders/MSL/${filename/.hlsl/.msl}"
-        shadercross "$filepath" -o "${assetdir}/Shaders/DXIL/${filename/.hlsl/.dxil}"
+		compile_shader "$filepath" "${filename/.hlsl/}"
     fi
 done
 
 for filepath in "${sourcedir}"/*.frag.hlsl; do
     if [ -f "$filepath" ]; then
 		filename="${filepath##*/}"		
-		echo "compiling $filepath"
-        shadercross "$filepath" -o "${assetdir}/Shaders/SPIRV/${filename/.hlsl/.spv}"
-        shadercross "$filepath" -o "${assetdir}/Shaders/MSL/${filename/.hlsl/.msl}"
-        shadercross "$filepath" -o "${assetdir}/Shaders/DXIL/${filename/.hlsl/.dxil}"
+		compile_shader "$filepath" "${filename/.hlsl/}"
     fi
 done
 
 for filepath in "${sourcedir}"/*.comp.hlsl; do
     if [ -f "$filepath" ]; then
 		filename="${filepath##*/}"
-		echo "compiling $filepath"
-        shadercross "$filepath" -o "${assetdir}/Shaders/SPIRV/${filename/.hlsl/.spv}"
-        shadercross "$filepath" -o "${assetdir}/Shaders/MSL/${filename/.hlsl/.msl}"
-        shadercross "$filepath" -o "${assetdir}/Shaders/DXIL/${filename/.hlsl/.dxil}"
+		compile_shader "$filepath" "${filename/.hlsl/}"
     fi
 done
 
+# variants of the shaders above, selected by preprocessor defines
+compile_shader "${sourcedir}/SpriteBatch.vert.hlsl" "SpriteBatchRotated.vert" -DSPRITE_ROTATED
+compile_shader "${sourcedir}/SpriteBatch.vert.hlsl" "SpriteBatchPacked.vert" -DSPRITE_PACKED
+compile_shader "${sourcedir}/SpriteBatch.vert.hlsl" "SpriteBatchPackedRotated.vert" -DSPRITE_PACKED -DSPRITE_ROTATED
+compile_shader "${sourcedir}/SpriteBatch.vert.hlsl" "SpriteBatchInterpolated.vert" -DSPRITE_INTERPOLATED
+compile_shader "${sourcedir}/SpriteBatch.vert.hlsl" "SpriteBatchInterpolatedRotated.vert" -DSPRITE_INTERPOLATED -DSPRITE_ROTATED
+compile_shader "${sourcedir}/TextureXColor.frag.hlsl" "Texture.frag" -DSPRITE_UNTINTED
+
 echo "Done"
 read
\ No newline at end of file
@@ -9,20 +9,28 @@
 #include "OrthographicCamera.h"
 #include "Scene.h"
 #include "Shader.h"
+#include "FrameCapture.h"
+#include "Sprite2DPipeline.h"
 
 #include "TetrisGameScene.h"
 
 Application::~Application()
 {
+    if ( m_renderer )
+        log_backend_stats();
+
     m_scene.reset();
     m_assetManager.reset();
-    m_renderer.reset();
+    m_renderer.reset();    // no readback callbacks may be running when the capture goes away
+    m_capture.reset();
     m_window.reset();
     m_camera.reset();
 }
 
-bool Application::create()
+bool Application::create( const ApplicationCreationParameters& params )
 {
+    m_creationParams = params;
+
     if ( !SDL_Init( SDL_INIT_VIDEO ) ) {
         IE_LOG_CRITICAL( "Failed to initialize SDL" );
         return false;
@@ -33,9 +41,34 @@ bool Application::create()
         auto windowOpt = Window::create( { "Nasty Tetris", 720, 1040, 0 } );
         m_window       = std::move( windowOpt.value() );
 
-        auto renderOpt = GPURenderer::create( m_window.get(), false );
+        auto renderOpt = GPURenderer::create( m_window.get(), false, 2, params.nullGPU ? GPUBackendType::Null : GPUBackendType::SDL );
         m_renderer     = std::move( renderOpt.value() );
-        m_renderer->enable_vsync( true );
+        m_renderer->set_presentmode( params.presentMode );
+        m_renderer->set_gpu_frames_in_flight( params.gpuFrames );
+        IE_LOG_INFO( "Renderer: Presenting with %s, %u frames queued on the gpu%s",
+                     GPURenderer::get_presentmode_name( m_renderer->get_presentmode() ).data(),
+                     m_renderer->get_gpu_frames_in_flight(),
+                     params.justInTimeFrames ? ", frames start just in time" : "" );
+        if ( params.depthBuffer )
+            m_renderer->enable_depthbuffer();
+        m_renderer->enable_frame_elision( params.frameElision );
+
+        if ( params.dynamicResolution ) {
+            // the frame time budget is one refresh of the display the window is on
+            DynamicResolutionSettings resolutionSettings;
+            resolutionSettings.MinScale = params.minResolutionScale;
+
+            const SDL_DisplayMode* displayMode = SDL_GetCurrentDisplayMode( SDL_GetDisplayForWindow( m_window->get_sdlwindow() ) );
+            if ( displayMode != nullptr && displayMode->refresh_rate > 0.0f )
+                resolutionSettings.TargetFrameTime = static_cast<uint64_t>( 1'000'000'000.0 / displayMode->refresh_rate );
+
+            m_renderer->enable_dynamic_resolution( true, resolutionSettings );
+        }
+
+        if ( params.commandCaptureFile.empty() == false && m_renderer->begin_commandcapture( params.commandCaptureFile ) == false ) {
+            IE_LOG_CRITICAL( "Failed to start the command capture" );
+            return false;
+        }
 
         auto assetManagerOpt = AssetManager::create( std::filesystem::current_path().append( "..\\..\\..\\assets\\" ), false );
         m_assetManager       = std::move( assetManagerOpt.value() );
@@ -46,6 +79,16 @@ bool Application::create()
 
         m_camera = OrthographicCamera::create( 0, 720, 1040, 0 );
 
+        if ( params.captureInterval > 0 ) {
+            FrameCaptureParameters captureParams;
+            captureParams.Directory = params.captureDirectory;
+            captureParams.Interval  = params.captureInterval;
+            captureParams.Format    = params.captureRaw ? FrameCaptureFormat::Raw : FrameCaptureFormat::PNG;
+
+            auto captureOpt = FrameCapture::create( m_renderer.get(), captureParams );
+            m_capture       = std::move( captureOpt.value() );
+        }
+
         publish_coreapi();
     } catch ( std::exception e ) {
         IE_LOG_CRITICAL( "Initialization failure %s", e.what() );
@@ -63,6 +106,13 @@ bool Application::generate_frame()
     if ( m_mustQuit.load( std::memory_order_relaxed ) )
         return false;
 
+    if ( m_creationParams.maxFrames != 0 && m_frameCount >= m_creationParams.maxFrames )
+        return false;
+    m_frameCount++;
+
+    if ( m_creationParams.justInTimeFrames && m_renderer->is_multithreaded() == false )
+        pace_frame();
+
     double newTime = static_cast<double>( SDL_GetTicksNS() ) / 1'000'000'000.0;
     m_frameContext.AccumulatedTime += newTime - m_frameContext.CurrentTime;
     m_frameContext.CurrentTime = newTime;
@@ -77,6 +127,9 @@ bool Application::generate_frame()
     m_frameContext.InterpolationFactor = static_cast<float>( m_frameContext.AccumulatedTime / m_frameContext.DeltaTime );
     interpolate_and_collect_rendercommands( m_frameContext, m_camera.get() );
 
+    if ( m_creationParams.frameElision )
+        wait_while_idle();
+
     return true;
 }
 
@@ -85,14 +138,11 @@ void Application::interpolate_and_collect_rendercommands( const FrameContext& ct
     m_renderer->set_viewprojectionmatrix( pCamera->get_viewprojectionmatrix() );
     m_scene->interpolate_and_create_rendercommands( ctx.InterpolationFactor, m_renderer.get() );
 
-    if ( m_renderer->is_multithreaded() ) {
-        {
-            std::unique_lock<std::mutex> ulock = m_renderer->wait_for_rendering_finished_and_hold_lock();
-            m_renderer->submit_pipelines();
-        }
-        m_renderer->notify_renderthread();
-    } else {
-        m_renderer->submit_pipelines();
+    if ( m_capture )
+        m_capture->on_frame( m_frameCount );
+
+    m_renderer->submit_pipelines();
+    if ( m_renderer->is_multithreaded() == false ) {
         m_renderer->process_pipelines();
     }
 }
@@ -101,8 +151,20 @@ bool Application::handle_event( SDL_Event* event )
 {
     if ( event->type == SDL_EVENT_QUIT )
         return false;
-    else
-        return m_scene->handle_event( event );
+
+    m_idleWakeup = true;
+    switch ( event->type ) {
+    case SDL_EVENT_WINDOW_EXPOSED:
+    case SDL_EVENT_WINDOW_PIXEL_SIZE_CHANGED: m_renderer->invalidate_frame(); break;
+    case SDL_EVENT_KEY_DOWN:
+    case SDL_EVENT_KEY_UP:
+    case SDL_EVENT_MOUSE_BUTTON_DOWN:
+    case SDL_EVENT_MOUSE_BUTTON_UP:
+    case SDL_EVENT_GAMEPAD_BUTTON_DOWN:
+    case SDL_EVENT_GAMEPAD_BUTTON_UP: m_renderer->mark_input( event->common.timestamp ); break;
+    default: break;
+    }
+    return m_scene->handle_event( event );
 }
 
 void Application::shutdown() {
@@ -141,6 +203,168 @@ bool Application::fixed_update( const FrameContext& ctx )
     return true;
 }
 
+void Application::pace_frame()
+{
+    // Whatever the last frame still blocked acquiring the swapchain while recording could have been slept before sampling its input.
+    // The delay creeps towards that and keeps a margin, it backs off fast because a missed vblank costs a whole refresh.
+    // With mailbox or immediate nothing blocks and the delay stays at zero.
+    uint64_t blocked = m_renderer->get_render_stats().SwapchainWait;
+    if ( blocked > PacingMargin )
+        m_pacingDelay = std::min( m_pacingDelay + ( blocked - PacingMargin ) / 4, MaxPacingDelay );
+    else
+        m_pacingDelay -= std::min( m_pacingDelay, PacingMargin - blocked );
+
+    // nothing can be presented before the swapchain takes the next frame, input sampled while waiting for it only gets older,
+    // the renderer sleeps the delay afterwards so it does not count as frame time
+    m_renderer->wait_for_swapchain( m_pacingDelay );
+
+    // the main callbacks hand pumped events to handle_event right away, so the frame sees the input of the sleep
+    SDL_PumpEvents();
+}
+
+void Application::wait_while_idle()
+{
+    // stats of the frame that was just processed, or the one before with the render thread
+    if ( m_renderer->get_render_stats().Elided == 0 ) {
+        m_idleWait = 0;
+        return;
+    }
+
+    // The longer nothing changes the longer the wait. It sleeps in slices instead of blocking on the event queue,
+    // the main callbacks hand pumped events to handle_event right away and any of them ends the wait.
+    m_idleWait   = std::min( m_idleWait + IdleWaitStep, MaxIdleWait );
+    m_idleWakeup = false;
+
+    uint64_t waitStart = SDL_GetTicksNS();
+    uint64_t waitEnd   = waitStart + static_cast<uint64_t>( m_idleWait ) * 1'000'000;
+    while ( m_idleWakeup == false && SDL_GetTicksNS() < waitEnd ) {
+        SDL_DelayNS( IdleWaitSlice );
+        SDL_PumpEvents();
+    }
+
+    // the sleep is not frame time, the dynamic resolution would otherwise scale down whenever the game idles
+    m_renderer->add_idle_time( SDL_GetTicksNS() - waitStart );
+}
+
+void Application::log_backend_stats() const
+{
+    GPUBackendStats stats = m_renderer->get_backend()->get_stats();
+    IE_LOG_INFO( "Renderer: %llu frames, %llu commandbuffers, %llu commands, %llu draw calls, %llu vertices, %llu bytes uploaded",
+                 static_cast<unsigned long long>( m_frameCount ),
+                 static_cast<unsigned long long>( stats.CommandBuffers ),
+                 static_cast<unsigned long long>( stats.Commands ),
+                 static_cast<unsigned long long>( stats.DrawCalls ),
+                 static_cast<unsigned long long>( stats.Vertices ),
+                 static_cast<unsigned long long>( stats.UploadedBytes ) );
+
+    FrameUploadCounters uploads = m_renderer->get_upload_counters();
+    IE_LOG_INFO( "Renderer: %llu bytes uploaded last frame, at most %llu per frame, %llu texture regions with %llu bytes, %llu staging ring overflows",
+                 static_cast<unsigned long long>( uploads.LastFrameBytes ),
+                 static_cast<unsigned long long>( uploads.MaxFrameBytes ),
+                 static_cast<unsigned long long>( uploads.TextureRegions ),
+                 static_cast<unsigned long long>( uploads.TextureBytes ),
+                 static_cast<unsigned long long>( uploads.StagingOverflows ) );
+    IE_LOG_INFO( "Renderer: %llu asset uploads with %llu bytes, %llu waiting for upload budget",
+                 static_cast<unsigned long long>( uploads.AssetUploads ),
+                 static_cast<unsigned long long>( uploads.AssetBytes ),
+                 static_cast<unsigned long long>( uploads.PendingUploads ) );
+
+    std::vector<RenderStats> history = m_renderer->get_render_stats_history();
+    if ( history.empty() == false ) {
+        RenderStats sum;
+        for ( const RenderStats& frame : history ) {
+            sum.Sprites += frame.Sprites;
+            sum.Batches += frame.Batches;
+            sum.DrawCalls += frame.DrawCalls;
+            sum.PipelineBinds += frame.PipelineBinds;
+            sum.TextureBinds += frame.TextureBinds;
+            sum.MappedBytes += frame.MappedBytes;
+            sum.UploadedBytes += frame.UploadedBytes;
+            sum.SortTime += frame.SortTime;
+            sum.CopyTime += frame.CopyTime;
+            sum.RenderTime += frame.RenderTime;
+            sum.SwapchainWait += frame.SwapchainWait;
+            sum.FrameTime += frame.FrameTime;
+            sum.SceneWidth += frame.SceneWidth;
+            sum.SceneHeight += frame.SceneHeight;
+            sum.Elided += frame.Elided;
+        }
+
+        double frames = static_cast<double>( history.size() );
+        IE_LOG_INFO( "Renderer: last %zu frames averaged %.1f sprites in %.1f batches, %.1f draw calls, %.1f pipeline and %.1f texture binds, %.0f bytes mapped, %.0f bytes uploaded",
+                     history.size(),
+                     sum.Sprites / frames,
+                     sum.Batches / frames,
+                     sum.DrawCalls / frames,
+                     sum.PipelineBinds / frames,
+                     sum.TextureBinds / frames,
+                     sum.MappedBytes / frames,
+                     sum.UploadedBytes / frames );
+        IE_LOG_INFO( "Renderer: last %zu frames averaged %.3f us sort, %.3f us copy, %.3f us render recording, %.3f us waiting for the swapchain, %llu were elided",
+                     history.size(),
+                     sum.SortTime / frames / 1000.0,
+                     sum.CopyTime / frames / 1000.0,
+                     sum.RenderTime / frames / 1000.0,
+                     sum.SwapchainWait / frames / 1000.0,
+                     static_cast<unsigned long long>( sum.Elided ) );
+        if ( sum.SceneWidth > 0 ) {
+            IE_LOG_INFO( "Renderer: last %zu frames averaged %.3f ms frame time, the scene at %.0fx%.0f (scale %.2f now)",
+                         history.size(),
+                         sum.FrameTime / frames / 1'000'000.0,
+                         sum.SceneWidth / frames,
+                         sum.SceneHeight / frames,
+                         m_renderer->get_resolution_scale() );
+        }
+
+        uint64_t inputFrames = 0;
+        uint64_t maxLatency  = 0;
+        for ( const RenderStats& frame : history ) {
+            if ( frame.InputLatency == 0 )
+                continue;
+            sum.InputLatency += frame.InputLatency;
+            maxLatency = std::max( maxLatency, frame.InputLatency );
+            inputFrames++;
+        }
+        if ( inputFrames > 0 ) {
+            IE_LOG_INFO( "Renderer: input to present %.3f ms on average, at most %.3f ms over %llu frames with input (%s, %u gpu frames, %.3f ms paced)",
+                         static_cast<double>( sum.InputLatency ) / inputFrames / 1'000'000.0,
+                         static_cast<double>( maxLatency ) / 1'000'000.0,
+                         static_cast<unsigned long long>( inputFrames ),
+                         GPURenderer::get_presentmode_name( m_renderer->get_presentmode() ).data(),
+                         m_renderer->get_gpu_frames_in_flight(),
+                         static_cast<double>( m_pacingDelay ) / 1'000'000.0 );
+        }
+    }
+
+    GPUMemoryReport memory = m_renderer->get_memory_report();
+    IE_LOG_INFO( "Renderer: gpu memory %llu bytes (peak %llu), buffers %llu (peak %llu), textures %llu (peak %llu), transfer buffers %llu (peak %llu)",
+                 static_cast<unsigned long long>( memory.Total.Current ),
+                 static_cast<unsigned long long>( memory.Total.Peak ),
+                 static_cast<unsigned long long>( memory.Categories[static_cast<size_t>( GPUMemoryCategory::Buffer )].Current ),
+                 static_cast<unsigned long long>( memory.Categories[static_cast<size_t>( GPUMemoryCategory::Buffer )].Peak ),
+                 static_cast<unsigned long long>( memory.Categories[static_cast<size_t>( GPUMemoryCategory::Texture )].Current ),
+                 static_cast<unsigned long long>( memory.Categories[static_cast<size_t>( GPUMemoryCategory::Texture )].Peak ),
+                 static_cast<unsigned long long>( memory.Categories[static_cast<size_t>( GPUMemoryCategory::TransferBuffer )].Current ),
+                 static_cast<unsigned long long>( memory.Categories[static_cast<size_t>( GPUMemoryCategory::TransferBuffer )].Peak ) );
+    for ( size_t i = 0; i < std::min<size_t>( memory.Owners.size(), 8 ); ++i ) {
+        const GPUMemoryOwnerUsage& owner = memory.Owners[i];
+        IE_LOG_INFO( "Renderer:     %-24s %llu bytes in %llu resources (peak %llu)",
+                     owner.Owner.c_str(),
+                     static_cast<unsigned long long>( owner.Total.Current ),
+                     static_cast<unsigned long long>( owner.Total.Allocations ),
+                     static_cast<unsigned long long>( owner.Total.Peak ) );
+    }
+
+    if ( auto spritePipeline = m_renderer->find_pipeline<Sprite2DPipeline>() ) {
+        auto draws = spritePipeline->get_variant_drawcounts();
+        IE_LOG_INFO( "Renderer: sprite draw calls %llu axis aligned, %llu rotated, %llu tinted, %llu rotated and tinted",
+                     static_cast<unsigned long long>( draws[0] ),
+                     static_cast<unsigned long long>( draws[Sprite2DPipeline::VariantRotated] ),
+                     static_cast<unsigned long long>( draws[Sprite2DPipeline::VariantTinted] ),
+                     static_cast<unsigned long long>( draws[Sprite2DPipeline::VariantRotated | Sprite2DPipeline::VariantTinted] ) );
+    }
+}
+
 void Application::publish_coreapi()
 {
     CoreAPI& coreapi       = CoreAPI::get_instance();
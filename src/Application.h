@@ -1,5 +1,6 @@
 #pragma once
 #include "SDL3/SDL_events.h"
+#include "SDL3/SDL_gpu.h"
 
 #include <memory>
 #include <string>
@@ -10,6 +11,24 @@ class GPURenderer;
 class AssetManager;
 class OrthographicCamera;
 class Scene;
+class FrameCapture;
+
+struct ApplicationCreationParameters
+{
+    bool               nullGPU            = false;                        // run the whole render path without a gpu, only counting what would be submitted
+    uint64_t           maxFrames          = 0;                            // quit after this many frames, 0 runs until the window is closed
+    uint32_t           captureInterval    = 0;                            // write every Nth frame to captureDirectory, 0 disables capturing
+    std::string        captureDirectory   = "capture";
+    bool               captureRaw         = false;                        // raw frames instead of PNG, cheaper to write
+    std::string        commandCaptureFile = "";                           // records the submitted render commands of every frame for ReplayBenchmark
+    bool               depthBuffer        = true;                         // opaque sprites are drawn with depth write, blended ones in layer order
+    SDL_GPUPresentMode presentMode        = SDL_GPU_PRESENTMODE_VSYNC;    // mailbox and immediate fall back to vsync where the window lacks them
+    uint32_t           gpuFrames          = 2;                            // frames the gpu may queue, 1 has the lowest latency
+    bool               justInTimeFrames   = false;                        // sleep before sampling input, so the frame finishes just before the swapchain takes it
+    bool               dynamicResolution  = false;                        // scale the scene resolution down while the frame time is over budget
+    float              minResolutionScale = 0.5f;
+    bool               frameElision       = true;                         // frames identical to the last one are not drawn, the loop then waits for input
+};
 
 class Application
 {
@@ -21,6 +40,12 @@ class Application
         float  InterpolationFactor = 0.0f;
     };
 
+    static constexpr uint64_t PacingMargin   = 1'000'000;     // ns the just in time frames keep in hand before the swapchain takes them
+    static constexpr uint64_t MaxPacingDelay = 50'000'000;
+    static constexpr int32_t  IdleWaitStep   = 1;             // ms the wait grows with every elided frame in a row
+    static constexpr int32_t  MaxIdleWait    = 32;            // ms, until a gravity tick of an idle board shows up
+    static constexpr uint64_t IdleWaitSlice  = 1'000'000;     // ns slept between looking for events while idle
+
     enum class GameState
     {
         Menu = 0,
@@ -30,7 +55,7 @@ class Application
 public:
     virtual ~Application();
 
-    bool create();
+    bool create( const ApplicationCreationParameters& params = {} );
     bool generate_frame();
     void interpolate_and_collect_rendercommands( const FrameContext& ctx, OrthographicCamera* pCamera );
     bool handle_event( SDL_Event* event );
@@ -46,14 +71,23 @@ public:
 
 private:
     bool fixed_update( const FrameContext& ctx );
+    void pace_frame();
+    void wait_while_idle();
     void publish_coreapi();
+    void log_backend_stats() const;
 
 private:
+    ApplicationCreationParameters       m_creationParams;
     FrameContext                        m_frameContext = {};
+    uint64_t                            m_frameCount   = 0;
+    uint64_t                            m_pacingDelay  = 0;        // ns slept before sampling input, see pace_frame()
+    int32_t                             m_idleWait     = 0;        // ms, see wait_while_idle()
+    bool                                m_idleWakeup   = false;    // an event arrived while idle
     std::unique_ptr<Window>             m_window;
     std::unique_ptr<GPURenderer>        m_renderer;
     std::unique_ptr<AssetManager>       m_assetManager;
     std::unique_ptr<OrthographicCamera> m_camera;
+    std::unique_ptr<FrameCapture>       m_capture;
 
     std::condition_variable m_updateCV;
     bool                    m_renderingFinished = true;
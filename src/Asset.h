@@ -81,6 +81,12 @@ public:
         m_uid = 0;
     }
 
+    // assets of a repository are numbered densely, so this can index lookup tables directly
+    InternalAssetUID get_index() const
+    {
+        return m_uid;
+    }
+
 private:
     operator InternalAssetUID() const
     {
@@ -0,0 +1,80 @@
+#pragma once
+#include <type_traits>
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include <new>
+
+// Allocates objects in fixed size chunks that are never relocated, so pointers to entries stay valid until reset().
+// reset() destroys all entries but keeps the chunks, after warming up no further allocations happen.
+template <typename T, size_t ChunkSize = 1024>
+class ChunkedArena
+{
+    static_assert( ChunkSize > 0 );
+
+    struct alignas( T ) Slot
+    {
+        std::byte Data[sizeof( T )];
+    };
+
+public:
+    ChunkedArena() = default;
+
+    ChunkedArena( const ChunkedArena& other )            = delete;
+    ChunkedArena& operator=( const ChunkedArena& other ) = delete;
+    ChunkedArena( ChunkedArena&& other )                 = delete;
+    ChunkedArena& operator=( ChunkedArena&& other )      = delete;
+
+    ~ChunkedArena()
+    {
+        reset();
+    }
+
+    template <typename... Args>
+    T* create( Args&&... args )
+    {
+        size_t chunkIdx = m_size / ChunkSize;
+        if ( chunkIdx == m_chunks.size() ) {
+            // no value initialization, the memory gets constructed on use
+            m_chunks.emplace_back( new Slot[ChunkSize] );
+        }
+
+        void* p = &m_chunks[chunkIdx][m_size % ChunkSize];
+        ++m_size;
+        return new ( p ) T( std::forward<Args>( args )... );
+    }
+
+    void reset()
+    {
+        if constexpr ( std::is_trivially_destructible_v<T> == false ) {
+            for_each( []( T& obj ) { obj.~T(); } );
+        }
+        m_size = 0;
+    }
+
+    template <typename Func>
+    void for_each( Func&& func )
+    {
+        size_t remaining = m_size;
+        for ( size_t chunkIdx = 0; remaining > 0; ++chunkIdx ) {
+            size_t count = ( remaining < ChunkSize ) ? remaining : ChunkSize;
+            for ( size_t i = 0; i < count; ++i )
+                func( *std::launder( reinterpret_cast<T*>( &m_chunks[chunkIdx][i] ) ) );
+            remaining -= count;
+        }
+    }
+
+    size_t size() const
+    {
+        return m_size;
+    }
+
+    size_t capacity() const
+    {
+        return m_chunks.size() * ChunkSize;
+    }
+
+private:
+    std::vector<std::unique_ptr<Slot[]>> m_chunks;
+    size_t                               m_size = 0;
+};
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// Hashes the commands of a frame, so the renderer can tell a frame that is identical to the last drawn one.
+// Eight bytes at a time (FNV-1a on words), the commands are mostly floats and this only has to be fast, not strong.
+// Values are hashed as their bytes, padding has to be initialized.
+class CommandHasher
+{
+public:
+    void add( const void* data, size_t size )
+    {
+        const unsigned char* bytes = static_cast<const unsigned char*>( data );
+        for ( ; size >= sizeof( uint64_t ); size -= sizeof( uint64_t ), bytes += sizeof( uint64_t ) ) {
+            uint64_t word;
+            std::memcpy( &word, bytes, sizeof( uint64_t ) );
+            mix( word );
+        }
+
+        if ( size > 0 ) {
+            uint64_t word = 0;
+            std::memcpy( &word, bytes, size );
+            mix( word ^ ( static_cast<uint64_t>( size ) << 56 ) );
+        }
+    }
+
+    template <typename T>
+    void add( const T& value )
+    {
+        static_assert( std::is_trivially_copyable_v<T> );
+        add( &value, sizeof( T ) );
+    }
+
+    uint64_t get() const
+    {
+        return m_hash;
+    }
+
+private:
+    void mix( uint64_t word )
+    {
+        m_hash = ( m_hash ^ word ) * 0x100000001b3ull;
+        m_hash ^= m_hash >> 29;
+    }
+
+private:
+    uint64_t m_hash = 0xcbf29ce484222325ull;
+};
@@ -0,0 +1,167 @@
+#include "iepch.h"
+#include "CommandStream.h"
+
+CommandStreamWriter::~CommandStreamWriter()
+{
+    if ( m_stream ) {
+        if ( SDL_CloseIO( m_stream ) == false )
+            IE_LOG_ERROR( "CommandStream: Failed to close capture : %s", SDL_GetError() );
+        IE_LOG_INFO( "CommandStream: Captured %llu frames", static_cast<unsigned long long>( m_frameCount ) );
+    }
+}
+
+std::optional<std::unique_ptr<CommandStreamWriter>> CommandStreamWriter::create( const std::filesystem::path& path )
+{
+    std::unique_ptr<CommandStreamWriter> writer( new CommandStreamWriter() );
+
+    writer->m_stream = SDL_IOFromFile( path.string().c_str(), "wb" );
+    if ( writer->m_stream == nullptr ) {
+        IE_LOG_ERROR( "CommandStream: Failed to open %s : %s", path.string().c_str(), SDL_GetError() );
+        return std::nullopt;
+    }
+
+    CommandStreamFileHeader header;
+    if ( SDL_WriteIO( writer->m_stream, &header, sizeof( header ) ) != sizeof( header ) ) {
+        IE_LOG_ERROR( "CommandStream: Failed to write %s : %s", path.string().c_str(), SDL_GetError() );
+        return std::nullopt;
+    }
+
+    writer->m_frameData.reserve( 1024 * 1024 );
+    IE_LOG_INFO( "CommandStream: Capturing into %s", path.string().c_str() );
+    return writer;
+}
+
+void CommandStreamWriter::begin_frame( const DXSM::Matrix& viewProjection )
+{
+    IE_ASSERT( m_inFrame == false );
+    m_frameData.clear();
+    m_frameHeader                = {};
+    m_frameHeader.ViewProjection = viewProjection;
+    m_inFrame                    = true;
+}
+
+void CommandStreamWriter::end_frame()
+{
+    IE_ASSERT( m_inFrame );
+    m_inFrame          = false;
+    m_frameHeader.Size = static_cast<uint32_t>( m_frameData.size() );
+
+    bool success = SDL_WriteIO( m_stream, &m_frameHeader, sizeof( m_frameHeader ) ) == sizeof( m_frameHeader );
+    success      = success && SDL_WriteIO( m_stream, m_frameData.data(), m_frameData.size() ) == m_frameData.size();
+    if ( success == false ) {
+        IE_LOG_ERROR( "CommandStream: Failed to write frame : %s", SDL_GetError() );
+        return;
+    }
+    m_frameCount++;
+}
+
+Uint8* CommandStreamWriter::add_chunk( std::string_view pipeline, uint32_t size )
+{
+    IE_ASSERT( m_inFrame );
+
+    CommandStreamChunkHeader header;
+    header.NameLength = static_cast<uint32_t>( pipeline.size() );
+    header.Size       = size;
+
+    size_t offset = m_frameData.size();
+    m_frameData.resize( offset + sizeof( header ) + pipeline.size() + size );
+    SDL_memcpy( m_frameData.data() + offset, &header, sizeof( header ) );
+    SDL_memcpy( m_frameData.data() + offset + sizeof( header ), pipeline.data(), pipeline.size() );
+
+    m_frameHeader.ChunkCount++;
+    return m_frameData.data() + offset + sizeof( header ) + pipeline.size();
+}
+
+uint64_t CommandStreamWriter::get_frame_count() const
+{
+    return m_frameCount;
+}
+
+CommandStreamReader::~CommandStreamReader()
+{
+    SDL_free( m_data );
+}
+
+std::optional<std::unique_ptr<CommandStreamReader>> CommandStreamReader::create( const std::filesystem::path& path )
+{
+    std::unique_ptr<CommandStreamReader> reader( new CommandStreamReader() );
+
+    reader->m_data = static_cast<Uint8*>( SDL_LoadFile( path.string().c_str(), &reader->m_size ) );
+    if ( reader->m_data == nullptr ) {
+        IE_LOG_ERROR( "CommandStream: Failed to load %s : %s", path.string().c_str(), SDL_GetError() );
+        return std::nullopt;
+    }
+
+    CommandStreamFileHeader expected;
+    CommandStreamFileHeader header;
+    if ( reader->m_size < sizeof( header ) ) {
+        IE_LOG_ERROR( "CommandStream: %s is no command stream capture", path.string().c_str() );
+        return std::nullopt;
+    }
+
+    SDL_memcpy( &header, reader->m_data, sizeof( header ) );
+    if ( SDL_memcmp( header.Magic, expected.Magic, sizeof( header.Magic ) ) != 0 || header.Version != CommandStreamVersion ) {
+        IE_LOG_ERROR( "CommandStream: %s is no command stream capture of version %u", path.string().c_str(), CommandStreamVersion );
+        return std::nullopt;
+    }
+
+    // count the frames once, this also validates the file
+    reader->rewind();
+    CommandStreamFrame frame;
+    uint64_t           frameCount = 0;
+    while ( reader->next_frame( frame ) )
+        frameCount++;
+
+    reader->m_frameCount = frameCount;
+    reader->rewind();
+    return reader;
+}
+
+bool CommandStreamReader::next_frame( CommandStreamFrame& frame )
+{
+    frame.Chunks.clear();
+
+    CommandStreamFrameHeader header;
+    if ( m_size - m_readOffset < sizeof( header ) )
+        return false;
+
+    SDL_memcpy( &header, m_data + m_readOffset, sizeof( header ) );
+    if ( m_size - m_readOffset - sizeof( header ) < header.Size )
+        return false;
+
+    frame.ViewProjection = header.ViewProjection;
+
+    const Uint8* chunkData = m_data + m_readOffset + sizeof( header );
+    size_t       remaining = header.Size;
+    for ( uint32_t i = 0; i < header.ChunkCount; ++i ) {
+        CommandStreamChunkHeader chunkHeader;
+        if ( remaining < sizeof( chunkHeader ) )
+            return false;
+
+        SDL_memcpy( &chunkHeader, chunkData, sizeof( chunkHeader ) );
+        size_t chunkSize = sizeof( chunkHeader ) + static_cast<size_t>( chunkHeader.NameLength ) + chunkHeader.Size;
+        if ( remaining < chunkSize )
+            return false;
+
+        CommandStreamChunk& chunk = frame.Chunks.emplace_back();
+        chunk.Pipeline            = std::string_view( reinterpret_cast<const char*>( chunkData + sizeof( chunkHeader ) ), chunkHeader.NameLength );
+        chunk.Data                = chunkData + sizeof( chunkHeader ) + chunkHeader.NameLength;
+        chunk.Size                = chunkHeader.Size;
+
+        chunkData += chunkSize;
+        remaining -= chunkSize;
+    }
+
+    m_readOffset += sizeof( header ) + header.Size;
+    return true;
+}
+
+void CommandStreamReader::rewind()
+{
+    m_readOffset = sizeof( CommandStreamFileHeader );
+}
+
+uint64_t CommandStreamReader::get_frame_count() const
+{
+    return m_frameCount;
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include "SDL3/SDL_iostream.h"
+
+#include "SimpleMath.h"
+namespace DXSM = DirectX::SimpleMath;
+
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+// Binary capture of everything the pipelines submit per frame.
+// file   : CommandStreamFileHeader, then the frames
+// frame  : CommandStreamFrameHeader, then ChunkCount chunks
+// chunk  : CommandStreamChunkHeader, the pipeline name and Size bytes of pipeline defined data
+// The data is written in the native layout, captures are only meant to be replayed by the same build on the same platform.
+
+static constexpr uint32_t CommandStreamVersion = 2;
+
+struct CommandStreamFileHeader
+{
+    char     Magic[4] = { 'N', 'T', 'C', 'S' };
+    uint32_t Version  = CommandStreamVersion;
+};
+
+struct CommandStreamFrameHeader
+{
+    DXSM::Matrix ViewProjection;
+    uint32_t     ChunkCount = 0;
+    uint32_t     Size       = 0;    // bytes of all chunks of the frame
+};
+
+struct CommandStreamChunkHeader
+{
+    uint32_t NameLength = 0;
+    uint32_t Size       = 0;
+};
+
+// one pipeline's commands of a captured frame, the data points into the loaded file
+struct CommandStreamChunk
+{
+    std::string_view Pipeline;
+    const Uint8*     Data = nullptr;
+    uint32_t         Size = 0;
+};
+
+struct CommandStreamFrame
+{
+    DXSM::Matrix                    ViewProjection;
+    std::vector<CommandStreamChunk> Chunks;
+};
+
+// Appends frames to a capture file, only used by the render thread.
+// Every frame is assembled in memory and written with a single call.
+class CommandStreamWriter
+{
+    CommandStreamWriter() = default;
+
+public:
+    ~CommandStreamWriter();
+
+    CommandStreamWriter( const CommandStreamWriter& other )            = delete;
+    CommandStreamWriter( CommandStreamWriter&& other )                 = delete;
+    CommandStreamWriter& operator=( const CommandStreamWriter& other ) = delete;
+    CommandStreamWriter& operator=( CommandStreamWriter&& other )      = delete;
+
+    [[nodiscard]]
+    static std::optional<std::unique_ptr<CommandStreamWriter>> create( const std::filesystem::path& path );
+
+    void begin_frame( const DXSM::Matrix& viewProjection );
+    void end_frame();
+
+    // reserves size bytes for the chunk of a pipeline, the returned pointer is valid until the next call
+    Uint8* add_chunk( std::string_view pipeline, uint32_t size );
+
+    uint64_t get_frame_count() const;
+
+private:
+    SDL_IOStream*            m_stream = nullptr;
+    std::vector<Uint8>       m_frameData;
+    CommandStreamFrameHeader m_frameHeader;
+    bool                     m_inFrame    = false;
+    uint64_t                 m_frameCount = 0;
+};
+
+// Loads a whole capture file into memory and iterates over its frames.
+class CommandStreamReader
+{
+    CommandStreamReader() = default;
+
+public:
+    ~CommandStreamReader();
+
+    CommandStreamReader( const CommandStreamReader& other )            = delete;
+    CommandStreamReader( CommandStreamReader&& other )                 = delete;
+    CommandStreamReader& operator=( const CommandStreamReader& other ) = delete;
+    CommandStreamReader& operator=( CommandStreamReader&& other )      = delete;
+
+    [[nodiscard]]
+    static std::optional<std::unique_ptr<CommandStreamReader>> create( const std::filesystem::path& path );
+
+    // returns false at the end of the file or when the frame is malformed
+    bool next_frame( CommandStreamFrame& frame );
+    void rewind();
+
+    uint64_t get_frame_count() const;
+
+private:
+    Uint8*   m_data       = nullptr;
+    size_t   m_size       = 0;
+    size_t   m_readOffset = 0;
+    uint64_t m_frameCount = 0;
+};
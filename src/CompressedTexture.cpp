@@ -0,0 +1,316 @@
+#include "iepch.h"
+#include "CompressedTexture.h"
+
+#include <bit>
+
+// DDS file layout, see the DirectX documentation of DDS_HEADER and DDS_HEADER_DXT10
+static constexpr uint32_t DDSMagic = 0x20534444;    // "DDS "
+
+static constexpr uint32_t DDSFlagCaps        = 0x1;
+static constexpr uint32_t DDSFlagHeight      = 0x2;
+static constexpr uint32_t DDSFlagWidth       = 0x4;
+static constexpr uint32_t DDSFlagPixelFormat = 0x1000;
+static constexpr uint32_t DDSFlagMipMapCount = 0x20000;
+static constexpr uint32_t DDSFlagLinearSize  = 0x80000;
+
+static constexpr uint32_t DDSPixelFlagAlphaPixels = 0x1;
+static constexpr uint32_t DDSPixelFlagFourCC      = 0x4;
+
+static constexpr uint32_t DDSCapsComplex = 0x8;
+static constexpr uint32_t DDSCapsTexture = 0x1000;
+static constexpr uint32_t DDSCapsMipMap  = 0x400000;
+
+static constexpr uint32_t DDSDimensionTexture2D = 3;
+
+static constexpr uint32_t make_fourcc( char a, char b, char c, char d )
+{
+    return static_cast<uint32_t>( a ) | ( static_cast<uint32_t>( b ) << 8 ) | ( static_cast<uint32_t>( c ) << 16 ) | ( static_cast<uint32_t>( d ) << 24 );
+}
+
+struct DDSPixelFormat
+{
+    uint32_t Size        = 32;
+    uint32_t Flags       = 0;
+    uint32_t FourCC      = 0;
+    uint32_t RGBBitCount = 0;
+    uint32_t RBitMask    = 0;
+    uint32_t GBitMask    = 0;
+    uint32_t BBitMask    = 0;
+    uint32_t ABitMask    = 0;
+};
+
+struct DDSHeader
+{
+    uint32_t       Size              = 124;
+    uint32_t       Flags             = 0;
+    uint32_t       Height            = 0;
+    uint32_t       Width             = 0;
+    uint32_t       PitchOrLinearSize = 0;
+    uint32_t       Depth             = 0;
+    uint32_t       MipMapCount       = 0;
+    uint32_t       Reserved1[11]     = {};
+    DDSPixelFormat PixelFormat;
+    uint32_t       Caps      = 0;
+    uint32_t       Caps2     = 0;
+    uint32_t       Caps3     = 0;
+    uint32_t       Caps4     = 0;
+    uint32_t       Reserved2 = 0;
+};
+static_assert( sizeof( DDSHeader ) == 124 );
+
+struct DDSHeaderDX10
+{
+    uint32_t DXGIFormat        = 0;
+    uint32_t ResourceDimension = DDSDimensionTexture2D;
+    uint32_t MiscFlag          = 0;
+    uint32_t ArraySize         = 1;
+    uint32_t MiscFlags2        = 0;
+};
+static_assert( sizeof( DDSHeaderDX10 ) == 20 );
+
+struct DXGIFormatMapping
+{
+    uint32_t             DXGIFormat;
+    SDL_GPUTextureFormat Format;
+};
+
+// DXGI_FORMAT values of the block compressed formats SDL can sample
+static constexpr DXGIFormatMapping DXGIFormats[] = {
+    { 71, SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM },    // BC1_UNORM
+    { 72, SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM },    // BC1_UNORM_SRGB
+    { 74, SDL_GPU_TEXTUREFORMAT_BC2_RGBA_UNORM },    // BC2_UNORM
+    { 75, SDL_GPU_TEXTUREFORMAT_BC2_RGBA_UNORM },    // BC2_UNORM_SRGB
+    { 77, SDL_GPU_TEXTUREFORMAT_BC3_RGBA_UNORM },    // BC3_UNORM
+    { 78, SDL_GPU_TEXTUREFORMAT_BC3_RGBA_UNORM },    // BC3_UNORM_SRGB
+    { 98, SDL_GPU_TEXTUREFORMAT_BC7_RGBA_UNORM },    // BC7_UNORM
+    { 99, SDL_GPU_TEXTUREFORMAT_BC7_RGBA_UNORM },    // BC7_UNORM_SRGB
+};
+
+CompressedTexture::CompressedTexture( SDL_GPUTextureFormat format, uint32_t width, uint32_t height ) :
+    m_format( format ),
+    m_width( width ),
+    m_height( height )
+{
+    IE_ASSERT( get_blocksize( format ) != 0 && width > 0 && height > 0 );
+}
+
+std::optional<std::unique_ptr<CompressedTexture>> CompressedTexture::load_dds( const std::filesystem::path& path )
+{
+    size_t size = 0;
+    Uint8* file = static_cast<Uint8*>( SDL_LoadFile( path.string().c_str(), &size ) );
+    if ( file == nullptr ) {
+        IE_LOG_ERROR( "Could not open %s : %s", path.string().c_str(), SDL_GetError() );
+        return std::nullopt;
+    }
+
+    // the file is only needed until the levels are copied out
+    std::unique_ptr<Uint8, decltype( &SDL_free )> fileGuard( file, &SDL_free );
+
+    uint32_t  magic  = 0;
+    DDSHeader header = {};
+    if ( size < sizeof( uint32_t ) + sizeof( DDSHeader ) ) {
+        IE_LOG_ERROR( "%s is not a DDS file", path.string().c_str() );
+        return std::nullopt;
+    }
+    SDL_memcpy( &magic, file, sizeof( uint32_t ) );
+    SDL_memcpy( &header, file + sizeof( uint32_t ), sizeof( DDSHeader ) );
+    size_t offset = sizeof( uint32_t ) + sizeof( DDSHeader );
+
+    if ( magic != DDSMagic || header.Size != sizeof( DDSHeader ) || header.PixelFormat.Size != sizeof( DDSPixelFormat ) ) {
+        IE_LOG_ERROR( "%s is not a DDS file", path.string().c_str() );
+        return std::nullopt;
+    }
+
+    if ( ( header.PixelFormat.Flags & DDSPixelFlagFourCC ) == 0 ) {
+        IE_LOG_ERROR( "%s is not block compressed", path.string().c_str() );
+        return std::nullopt;
+    }
+
+    SDL_GPUTextureFormat format = SDL_GPU_TEXTUREFORMAT_INVALID;
+    uint32_t             fourCC = header.PixelFormat.FourCC;
+    if ( fourCC == make_fourcc( 'D', 'X', 'T', '1' ) ) {
+        format = SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM;
+    }
+    else if ( fourCC == make_fourcc( 'D', 'X', 'T', '3' ) ) {
+        format = SDL_GPU_TEXTUREFORMAT_BC2_RGBA_UNORM;
+    }
+    else if ( fourCC == make_fourcc( 'D', 'X', 'T', '5' ) ) {
+        format = SDL_GPU_TEXTUREFORMAT_BC3_RGBA_UNORM;
+    }
+    else if ( fourCC == make_fourcc( 'D', 'X', '1', '0' ) ) {
+        DDSHeaderDX10 headerDX10 = {};
+        if ( size < offset + sizeof( DDSHeaderDX10 ) ) {
+            IE_LOG_ERROR( "%s is truncated", path.string().c_str() );
+            return std::nullopt;
+        }
+        SDL_memcpy( &headerDX10, file + offset, sizeof( DDSHeaderDX10 ) );
+        offset += sizeof( DDSHeaderDX10 );
+
+        if ( headerDX10.ResourceDimension != DDSDimensionTexture2D || headerDX10.ArraySize != 1 ) {
+            IE_LOG_ERROR( "%s is not a single 2D texture", path.string().c_str() );
+            return std::nullopt;
+        }
+
+        for ( const DXGIFormatMapping& mapping : DXGIFormats ) {
+            if ( mapping.DXGIFormat == headerDX10.DXGIFormat )
+                format = mapping.Format;
+        }
+    }
+
+    if ( format == SDL_GPU_TEXTUREFORMAT_INVALID ) {
+        IE_LOG_ERROR( "%s has an unsupported format", path.string().c_str() );
+        return std::nullopt;
+    }
+
+    if ( header.Width == 0 || header.Height == 0 ) {
+        IE_LOG_ERROR( "%s is empty", path.string().c_str() );
+        return std::nullopt;
+    }
+
+    auto texture      = std::make_unique<CompressedTexture>( format, header.Width, header.Height );
+    texture->m_opaque = format == SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM && ( header.PixelFormat.Flags & DDSPixelFlagAlphaPixels ) == 0;
+
+    // a chain is cut off where it would get smaller than 1x1
+    uint32_t levelCount = ( ( header.Flags & DDSFlagMipMapCount ) != 0 ) ? std::max<uint32_t>( header.MipMapCount, 1 ) : 1;
+    levelCount          = std::min<uint32_t>( levelCount, std::bit_width( std::max( header.Width, header.Height ) ) );
+
+    for ( uint32_t level = 0; level < levelCount; ++level ) {
+        uint32_t levelSize = get_levelsize( format, std::max( header.Width >> level, 1u ), std::max( header.Height >> level, 1u ) );
+        if ( size < offset + levelSize ) {
+            IE_LOG_ERROR( "%s is truncated", path.string().c_str() );
+            return std::nullopt;
+        }
+
+        texture->add_level( file + offset, levelSize );
+        offset += levelSize;
+    }
+    return texture;
+}
+
+bool CompressedTexture::save_dds( const std::filesystem::path& path ) const
+{
+    IE_ASSERT( m_levels.empty() == false );
+
+    DDSHeader header         = {};
+    header.Flags             = DDSFlagCaps | DDSFlagHeight | DDSFlagWidth | DDSFlagPixelFormat | DDSFlagLinearSize | DDSFlagMipMapCount;
+    header.Height            = m_height;
+    header.Width             = m_width;
+    header.PitchOrLinearSize = m_levels[0].Size;
+    header.MipMapCount       = static_cast<uint32_t>( m_levels.size() );
+    header.PixelFormat.Flags = DDSPixelFlagFourCC;
+    header.Caps              = DDSCapsTexture | ( ( m_levels.size() > 1 ) ? DDSCapsComplex | DDSCapsMipMap : 0 );
+
+    // the legacy headers are understood by more tools, everything else needs the DX10 extension
+    DDSHeaderDX10 headerDX10 = {};
+    bool          writeDX10  = false;
+    if ( m_format == SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM ) {
+        header.PixelFormat.FourCC = make_fourcc( 'D', 'X', 'T', '1' );
+        if ( m_opaque == false )
+            header.PixelFormat.Flags |= DDSPixelFlagAlphaPixels;
+    }
+    else if ( m_format == SDL_GPU_TEXTUREFORMAT_BC2_RGBA_UNORM ) {
+        header.PixelFormat.FourCC = make_fourcc( 'D', 'X', 'T', '3' );
+    }
+    else if ( m_format == SDL_GPU_TEXTUREFORMAT_BC3_RGBA_UNORM ) {
+        header.PixelFormat.FourCC = make_fourcc( 'D', 'X', 'T', '5' );
+    }
+    else {
+        header.PixelFormat.FourCC = make_fourcc( 'D', 'X', '1', '0' );
+        writeDX10                 = true;
+        for ( const DXGIFormatMapping& mapping : DXGIFormats ) {
+            if ( mapping.Format == m_format && headerDX10.DXGIFormat == 0 )
+                headerDX10.DXGIFormat = mapping.DXGIFormat;
+        }
+    }
+
+    SDL_IOStream* stream = SDL_IOFromFile( path.string().c_str(), "wb" );
+    if ( stream == nullptr ) {
+        IE_LOG_ERROR( "Could not create %s : %s", path.string().c_str(), SDL_GetError() );
+        return false;
+    }
+
+    bool written = SDL_WriteIO( stream, &DDSMagic, sizeof( uint32_t ) ) == sizeof( uint32_t );
+    written      = written && SDL_WriteIO( stream, &header, sizeof( DDSHeader ) ) == sizeof( DDSHeader );
+    if ( writeDX10 )
+        written = written && SDL_WriteIO( stream, &headerDX10, sizeof( DDSHeaderDX10 ) ) == sizeof( DDSHeaderDX10 );
+    written = written && SDL_WriteIO( stream, m_data.data(), m_data.size() ) == m_data.size();
+    written = SDL_CloseIO( stream ) && written;
+
+    if ( written == false )
+        IE_LOG_ERROR( "Could not write %s : %s", path.string().c_str(), SDL_GetError() );
+    return written;
+}
+
+uint32_t CompressedTexture::get_blocksize( SDL_GPUTextureFormat format )
+{
+    switch ( format ) {
+        case SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM:
+            return 8;
+        case SDL_GPU_TEXTUREFORMAT_BC2_RGBA_UNORM:
+        case SDL_GPU_TEXTUREFORMAT_BC3_RGBA_UNORM:
+        case SDL_GPU_TEXTUREFORMAT_BC7_RGBA_UNORM:
+            return 16;
+        default:
+            return 0;
+    }
+}
+
+uint32_t CompressedTexture::get_levelsize( SDL_GPUTextureFormat format, uint32_t width, uint32_t height )
+{
+    return ( ( width + 3 ) / 4 ) * ( ( height + 3 ) / 4 ) * get_blocksize( format );
+}
+
+void CompressedTexture::add_level( const Uint8* data, uint32_t size )
+{
+    uint32_t level  = static_cast<uint32_t>( m_levels.size() );
+    uint32_t width  = std::max( m_width >> level, 1u );
+    uint32_t height = std::max( m_height >> level, 1u );
+    IE_ASSERT( size == get_levelsize( m_format, width, height ) );
+
+    MipLevel& mip = m_levels.emplace_back();
+    mip.Offset    = static_cast<uint32_t>( m_data.size() );
+    mip.Size      = size;
+    mip.Width     = width;
+    mip.Height    = height;
+    m_data.insert( m_data.end(), data, data + size );
+}
+
+SDL_GPUTextureFormat CompressedTexture::get_format() const
+{
+    return m_format;
+}
+
+uint32_t CompressedTexture::get_width() const
+{
+    return m_width;
+}
+
+uint32_t CompressedTexture::get_height() const
+{
+    return m_height;
+}
+
+bool CompressedTexture::is_opaque() const
+{
+    return m_opaque;
+}
+
+void CompressedTexture::set_opaque( bool opaque )
+{
+    m_opaque = opaque;
+}
+
+const std::vector<CompressedTexture::MipLevel>& CompressedTexture::get_levels() const
+{
+    return m_levels;
+}
+
+const std::vector<Uint8>& CompressedTexture::get_data() const
+{
+    return m_data;
+}
+
+std::vector<Uint8> CompressedTexture::take_data()
+{
+    return std::move( m_data );
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include "SDL3/SDL_gpu.h"
+
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <vector>
+
+// Block compressed texture with all of its mip levels, as stored in a DDS file.
+// BC1 and BC3 are read from the legacy DXT1/DXT5 headers, BC7 (and the others) from the DX10 header extension.
+// sRGB formats are loaded as their UNORM counterpart, the sprites sample the png textures without conversion as well.
+// The levels are stored tightly packed one after another, largest first, like they are in the file and uploaded.
+class CompressedTexture
+{
+public:
+    struct MipLevel
+    {
+        uint32_t Offset = 0;    // into the data
+        uint32_t Size   = 0;
+        uint32_t Width  = 0;
+        uint32_t Height = 0;
+    };
+
+    CompressedTexture( SDL_GPUTextureFormat format, uint32_t width, uint32_t height );
+
+    [[nodiscard]]
+    static std::optional<std::unique_ptr<CompressedTexture>> load_dds( const std::filesystem::path& path );
+    bool                                                      save_dds( const std::filesystem::path& path ) const;
+
+    // bytes of one 4x4 block, 0 for formats that are not supported
+    static uint32_t get_blocksize( SDL_GPUTextureFormat format );
+    static uint32_t get_levelsize( SDL_GPUTextureFormat format, uint32_t width, uint32_t height );
+
+    // levels have to be added largest first, each half the size of the previous one
+    void add_level( const Uint8* data, uint32_t size );
+
+    SDL_GPUTextureFormat         get_format() const;
+    uint32_t                     get_width() const;
+    uint32_t                     get_height() const;
+    bool                         is_opaque() const;    // BC1 without the alpha flag
+    void                         set_opaque( bool opaque );
+    const std::vector<MipLevel>& get_levels() const;
+    const std::vector<Uint8>&    get_data() const;
+    std::vector<Uint8>           take_data();
+
+private:
+    SDL_GPUTextureFormat  m_format = SDL_GPU_TEXTUREFORMAT_INVALID;
+    uint32_t              m_width  = 0;
+    uint32_t              m_height = 0;
+    bool                  m_opaque = false;
+    std::vector<MipLevel> m_levels;
+    std::vector<Uint8>    m_data;
+};
@@ -0,0 +1,137 @@
+#include "iepch.h"
+
+#include "SDL3_image/SDL_image.h"
+
+#include "PixelConverter.h"
+
+// Compares the sprite upload conversion of PixelConverter with SDL_ConvertSurface, for an image converted into the formats IMG_Load returns.
+// Every kernel the cpu supports is timed and checked against the scalar one, the SDL path includes the copy into the staging memory it needs.
+// usage: ConversionBenchmark <image> [--iterations N] [--premultiply]
+
+static constexpr SDL_PixelFormat SourceFormats[] = { SDL_PIXELFORMAT_RGBA32, SDL_PIXELFORMAT_BGRA32, SDL_PIXELFORMAT_XRGB8888,
+                                                     SDL_PIXELFORMAT_RGB24,  SDL_PIXELFORMAT_BGR24,  SDL_PIXELFORMAT_RGB565 };
+
+static double to_megabytes_per_second( uint64_t bytes, uint64_t nanoseconds )
+{
+    return ( nanoseconds > 0 ) ? static_cast<double>( bytes ) / static_cast<double>( nanoseconds ) * 1000.0 : 0.0;
+}
+
+// the old upload path: convert into a new surface, then copy its rows into the staging memory
+static bool convert_with_sdl( SDL_Surface* source, Uint8* dst, bool premultiply )
+{
+    SDL_Surface* converted = SDL_ConvertSurface( source, SDL_PIXELFORMAT_RGBA32 );
+    if ( converted == nullptr )
+        return false;
+    if ( premultiply )
+        SDL_PremultiplySurfaceAlpha( converted, false );
+
+    uint32_t rowSize = static_cast<uint32_t>( converted->w ) * 4;
+    for ( int y = 0; y < converted->h; ++y )
+        SDL_memcpy( dst + y * rowSize, static_cast<const Uint8*>( converted->pixels ) + y * converted->pitch, rowSize );
+
+    SDL_DestroySurface( converted );
+    return true;
+}
+
+static void run_format( SDL_Surface* image, SDL_PixelFormat format, uint32_t iterations, bool premultiply )
+{
+    SDL_Surface* source = SDL_ConvertSurface( image, format );
+    if ( source == nullptr ) {
+        IE_LOG_WARNING( "ConversionBenchmark: Can not create a %s surface: %s", SDL_GetPixelFormatName( format ), SDL_GetError() );
+        return;
+    }
+
+    uint64_t           bytes = static_cast<uint64_t>( source->w ) * source->h * 4;
+    std::vector<Uint8> reference( bytes );
+    std::vector<Uint8> output( bytes );
+    PixelConverter::convert_to_rgba8( source, reference.data(), source->w * 4, premultiply, PixelConverter::SimdLevel::Scalar );
+
+    IE_LOG_INFO( "ConversionBenchmark %s%s:", SDL_GetPixelFormatName( format ), PixelConverter::has_fast_path( format ) ? "" : " (through SDL_ConvertSurface)" );
+
+    for ( PixelConverter::SimdLevel level :
+          { PixelConverter::SimdLevel::Scalar, PixelConverter::SimdLevel::SSSE3, PixelConverter::SimdLevel::AVX2, PixelConverter::SimdLevel::NEON } ) {
+        if ( PixelConverter::is_supported( level ) == false )
+            continue;
+
+        uint64_t start = SDL_GetTicksNS();
+        for ( uint32_t i = 0; i < iterations; ++i )
+            PixelConverter::convert_to_rgba8( source, output.data(), source->w * 4, premultiply, level );
+        uint64_t duration = SDL_GetTicksNS() - start;
+
+        bool matches = SDL_memcmp( output.data(), reference.data(), bytes ) == 0;
+        IE_LOG_INFO( "    %-8s %9.3f us, %8.1f MB/s%s",
+                     PixelConverter::get_level_name( level ),
+                     static_cast<double>( duration ) / iterations / 1000.0,
+                     to_megabytes_per_second( bytes * iterations, duration ),
+                     matches ? "" : ", DIFFERS FROM SCALAR" );
+    }
+
+    uint64_t start = SDL_GetTicksNS();
+    for ( uint32_t i = 0; i < iterations; ++i )
+        convert_with_sdl( source, output.data(), premultiply );
+    uint64_t duration = SDL_GetTicksNS() - start;
+
+    // SDL rounds the premultiplication differently, only the plain conversion has to match exactly
+    bool matches = premultiply || SDL_memcmp( output.data(), reference.data(), bytes ) == 0;
+    IE_LOG_INFO( "    %-8s %9.3f us, %8.1f MB/s%s",
+                 "SDL",
+                 static_cast<double>( duration ) / iterations / 1000.0,
+                 to_megabytes_per_second( bytes * iterations, duration ),
+                 matches ? "" : ", DIFFERS FROM SCALAR" );
+
+    SDL_DestroySurface( source );
+}
+
+int main( int argc, char** argv )
+{
+    std::filesystem::path imagePath;
+    uint32_t              iterations  = 100;
+    bool                  premultiply = false;
+
+    for ( int i = 1; i < argc; ++i ) {
+        std::string_view arg = argv[i];
+        if ( arg == "--iterations" && i + 1 < argc ) {
+            iterations = std::max( static_cast<uint32_t>( SDL_strtoul( argv[++i], nullptr, 10 ) ), 1u );
+        }
+        else if ( arg == "--premultiply" ) {
+            premultiply = true;
+        }
+        else if ( imagePath.empty() ) {
+            imagePath = argv[i];
+        }
+        else {
+            IE_LOG_WARNING( "Unknown commandline argument %s", argv[i] );
+        }
+    }
+
+    if ( imagePath.empty() ) {
+        IE_LOG_CRITICAL( "usage: ConversionBenchmark <image> [--iterations N] [--premultiply]" );
+        return 1;
+    }
+
+    if ( !SDL_Init( 0 ) ) {
+        IE_LOG_CRITICAL( "Failed to initialize SDL" );
+        return 1;
+    }
+
+    SDL_Surface* image = IMG_Load( imagePath.string().c_str() );
+    if ( image == nullptr ) {
+        IE_LOG_CRITICAL( "Could not load %s : %s", imagePath.string().c_str(), SDL_GetError() );
+        SDL_Quit();
+        return 1;
+    }
+
+    IE_LOG_INFO( "ConversionBenchmark: %dx%d, %u iterations, best kernel %s%s",
+                 image->w,
+                 image->h,
+                 iterations,
+                 PixelConverter::get_level_name( PixelConverter::get_best_level() ),
+                 premultiply ? ", premultiplied" : "" );
+
+    for ( SDL_PixelFormat format : SourceFormats )
+        run_format( image, format, iterations, premultiply );
+
+    SDL_DestroySurface( image );
+    SDL_Quit();
+    return 0;
+}
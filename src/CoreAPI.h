@@ -8,6 +8,7 @@ class OrthographicCamera;
 class CoreAPI
 {
     friend class Application;
+    friend class ReplayBenchmark;
 
 private:
     CoreAPI()  = default;
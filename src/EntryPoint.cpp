@@ -10,17 +10,77 @@
 #include "Window.h"
 #include "AssetManager.h"
 #include "OrthographicCamera.h"
+#include "FrameCapture.h"
 
 struct AppState
 {
     Application gameMain;
 };
 
-SDL_AppResult SDL_AppInit( void** appstate, int argc [[maybe_unused]], char** argv [[maybe_unused]] )
+static ApplicationCreationParameters parse_commandline( int argc, char** argv )
+{
+    ApplicationCreationParameters params;
+    for ( int i = 1; i < argc; ++i ) {
+        std::string_view arg = argv[i];
+        if ( arg == "--null-gpu" ) {
+            params.nullGPU = true;
+        }
+        else if ( arg == "--frames" && i + 1 < argc ) {
+            params.maxFrames = SDL_strtoull( argv[++i], nullptr, 10 );
+        }
+        else if ( arg == "--capture" && i + 1 < argc ) {
+            params.captureInterval = static_cast<uint32_t>( SDL_strtoul( argv[++i], nullptr, 10 ) );
+        }
+        else if ( arg == "--capture-dir" && i + 1 < argc ) {
+            params.captureDirectory = argv[++i];
+        }
+        else if ( arg == "--capture-raw" ) {
+            params.captureRaw = true;
+        }
+        else if ( arg == "--capture-commands" && i + 1 < argc ) {
+            params.commandCaptureFile = argv[++i];
+        }
+        else if ( arg == "--no-depth" ) {
+            params.depthBuffer = false;
+        }
+        else if ( arg == "--present" && i + 1 < argc ) {
+            std::string_view mode = argv[++i];
+            if ( mode == "vsync" )
+                params.presentMode = SDL_GPU_PRESENTMODE_VSYNC;
+            else if ( mode == "mailbox" )
+                params.presentMode = SDL_GPU_PRESENTMODE_MAILBOX;
+            else if ( mode == "immediate" )
+                params.presentMode = SDL_GPU_PRESENTMODE_IMMEDIATE;
+            else
+                IE_LOG_WARNING( "Unknown present mode %s, use vsync, mailbox or immediate", argv[i] );
+        }
+        else if ( arg == "--gpu-frames" && i + 1 < argc ) {
+            params.gpuFrames = std::clamp( static_cast<uint32_t>( SDL_strtoul( argv[++i], nullptr, 10 ) ), 1u, GPURenderer::MaxGPUFrames );
+        }
+        else if ( arg == "--jit-frames" ) {
+            params.justInTimeFrames = true;
+        }
+        else if ( arg == "--no-elision" ) {
+            params.frameElision = false;
+        }
+        else if ( arg == "--dynamic-resolution" ) {
+            params.dynamicResolution = true;
+        }
+        else if ( arg == "--min-resolution-scale" && i + 1 < argc ) {
+            params.minResolutionScale = std::clamp( static_cast<float>( SDL_strtod( argv[++i], nullptr ) ), 0.1f, 1.0f );
+        }
+        else {
+            IE_LOG_WARNING( "Unknown commandline argument %s", argv[i] );
+        }
+    }
+    return params;
+}
+
+SDL_AppResult SDL_AppInit( void** appstate, int argc, char** argv )
 {
     *appstate          = new AppState;
     AppState* appState = ( (AppState*)*appstate );
-    if ( appState->gameMain.create() )
+    if ( appState->gameMain.create( parse_commandline( argc, argv ) ) )
         return SDL_AppResult::SDL_APP_CONTINUE;
 
     return SDL_AppResult::SDL_APP_FAILURE;
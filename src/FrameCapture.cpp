@@ -0,0 +1,211 @@
+#include "iepch.h"
+#include "FrameCapture.h"
+
+#include "Renderer.h"
+
+#include "SDL3_image/SDL_image.h"
+
+// header of the raw frame files, followed by Width * Height texels in the gpu format
+struct RawFrameHeader
+{
+    char     Magic[4]    = { 'N', 'T', 'F', 'R' };
+    uint32_t Width       = 0;
+    uint32_t Height      = 0;
+    uint32_t Format      = 0;    // SDL_GPUTextureFormat
+    uint64_t FrameNumber = 0;
+};
+
+static SDL_PixelFormat get_pixelformat( SDL_GPUTextureFormat format )
+{
+    switch ( format ) {
+    case SDL_GPU_TEXTUREFORMAT_B8G8R8A8_UNORM:
+        return SDL_PIXELFORMAT_ARGB8888;
+    case SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM:
+        return SDL_PIXELFORMAT_ABGR8888;
+    default:
+        return SDL_PIXELFORMAT_UNKNOWN;
+    }
+}
+
+FrameCapture::FrameCapture( const FrameCaptureParameters& params )
+    : m_params( params ), m_encodeQueue( params.QueueCapacity ), m_freeFrames( params.QueueCapacity )
+{
+}
+
+FrameCapture::~FrameCapture()
+{
+    if ( m_encoderThread.joinable() ) {
+        // the encoder writes everything that is still queued before it stops
+        m_stopEncoder.store( true, std::memory_order_release );
+        m_framesReady.release();
+        m_encoderThread.join();
+    }
+
+    FrameCaptureStats stats = get_stats();
+    IE_LOG_INFO( "FrameCapture: %llu frames requested, %llu written, %llu dropped, %llu failed",
+                 static_cast<unsigned long long>( stats.Requested ),
+                 static_cast<unsigned long long>( stats.Written ),
+                 static_cast<unsigned long long>( stats.Dropped ),
+                 static_cast<unsigned long long>( stats.Failed ) );
+}
+
+std::optional<std::unique_ptr<FrameCapture>> FrameCapture::create( GPURenderer* renderer, const FrameCaptureParameters& params )
+{
+    IE_ASSERT( renderer != nullptr && params.Interval > 0 && params.QueueCapacity > 0 );
+
+    // the swapchain can not be read back, the frame has to be rendered into the scene target
+    if ( renderer->enable_scene_rendertarget( true ) == false ) {
+        IE_LOG_ERROR( "FrameCapture: Failed to enable the scene rendertarget!" );
+        return std::nullopt;
+    }
+
+    std::unique_ptr<FrameCapture> capture( new FrameCapture( params ) );
+    capture->m_renderer = renderer;
+    capture->m_target   = *renderer->get_rendertarget( renderer->get_scene_rendertarget() );
+
+    if ( capture->m_params.Format == FrameCaptureFormat::PNG && get_pixelformat( capture->m_target.Format ) == SDL_PIXELFORMAT_UNKNOWN ) {
+        IE_LOG_WARNING( "FrameCapture: Rendertarget format can not be written as PNG, writing raw frames instead" );
+        capture->m_params.Format = FrameCaptureFormat::Raw;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories( capture->m_params.Directory, error );
+    if ( error ) {
+        IE_LOG_ERROR( "FrameCapture: Failed to create directory %s : %s", capture->m_params.Directory.string().c_str(), error.message().c_str() );
+        return std::nullopt;
+    }
+
+    // all buffers are allocated up front, capturing never allocates afterwards
+    uint32_t frameSize = SDL_CalculateGPUTextureFormatSize( capture->m_target.Format, capture->m_target.Width, capture->m_target.Height, 1 );
+    for ( size_t i = 0; i < capture->m_freeFrames.capacity(); ++i ) {
+        auto frame = std::make_unique<Frame>();
+        frame->Pixels.resize( frameSize );
+        capture->m_freeFrames.try_push( std::move( frame ) );
+    }
+
+    capture->m_encoderThread = std::thread( &FrameCapture::encoderthread_run, capture.get() );
+    IE_LOG_INFO( "FrameCapture: Capturing every %u frames into %s", params.Interval, capture->m_params.Directory.string().c_str() );
+    return capture;
+}
+
+void FrameCapture::on_frame( uint64_t frameNumber )
+{
+    if ( frameNumber % m_params.Interval != 0 )
+        return;
+
+    m_requested.fetch_add( 1, std::memory_order_relaxed );
+    m_renderer->request_readback( m_target.Resource, [this]( const ReadbackResult& result ) {
+        on_readback( result );
+    } );
+}
+
+FrameCaptureStats FrameCapture::get_stats() const
+{
+    FrameCaptureStats stats;
+    stats.Requested = m_requested.load( std::memory_order_relaxed );
+    stats.Written   = m_written.load( std::memory_order_relaxed );
+    stats.Dropped   = m_dropped.load( std::memory_order_relaxed );
+    stats.Failed    = m_failed.load( std::memory_order_relaxed );
+    return stats;
+}
+
+void FrameCapture::on_readback( const ReadbackResult& result )
+{
+    if ( result.Pixels == nullptr ) {
+        m_failed.fetch_add( 1, std::memory_order_relaxed );
+        return;
+    }
+
+    std::optional<std::unique_ptr<Frame>> frameOpt = m_freeFrames.try_pop();
+    if ( frameOpt.has_value() == false ) {
+        // every buffer is waiting for the encoder
+        if ( m_dropped.fetch_add( 1, std::memory_order_relaxed ) == 0 )
+            IE_LOG_WARNING( "FrameCapture: Encoder falls behind, dropping frames" );
+        return;
+    }
+
+    std::unique_ptr<Frame>& frame = frameOpt.value();
+    frame->Pixels.assign( result.Pixels, result.Pixels + result.Size );
+    frame->Width       = result.Width;
+    frame->Height      = result.Height;
+    frame->Format      = result.Format;
+    frame->FrameNumber = result.FrameNumber;
+
+    // there are never more frames than the queue can hold
+    bool pushed = m_encodeQueue.try_push( std::move( frame ) );
+    IE_ASSERT( pushed );
+    m_framesReady.release();
+}
+
+void FrameCapture::encoderthread_run()
+{
+    while ( true ) {
+        m_framesReady.acquire();
+
+        std::optional<std::unique_ptr<Frame>> frameOpt = m_encodeQueue.try_pop();
+        if ( frameOpt.has_value() == false ) {
+            // only the stop signal releases without a frame
+            if ( m_stopEncoder.load( std::memory_order_acquire ) )
+                break;
+            continue;
+        }
+
+        if ( write_frame( *frameOpt.value() ) )
+            m_written.fetch_add( 1, std::memory_order_relaxed );
+        else
+            m_failed.fetch_add( 1, std::memory_order_relaxed );
+
+        m_freeFrames.try_push( std::move( frameOpt.value() ) );
+    }
+}
+
+bool FrameCapture::write_frame( const Frame& frame )
+{
+    char fileName[64];
+    SDL_snprintf( fileName, sizeof( fileName ), "frame_%08llu.%s", static_cast<unsigned long long>( frame.FrameNumber ),
+                  m_params.Format == FrameCaptureFormat::PNG ? "png" : "raw" );
+
+    std::filesystem::path path = m_params.Directory / fileName;
+    if ( m_params.Format == FrameCaptureFormat::PNG )
+        return write_png( frame, path );
+    else
+        return write_raw( frame, path );
+}
+
+bool FrameCapture::write_raw( const Frame& frame, const std::filesystem::path& path )
+{
+    SDL_IOStream* stream = SDL_IOFromFile( path.string().c_str(), "wb" );
+    if ( stream == nullptr ) {
+        IE_LOG_ERROR( "FrameCapture: Failed to open %s : %s", path.string().c_str(), SDL_GetError() );
+        return false;
+    }
+
+    RawFrameHeader header;
+    header.Width       = frame.Width;
+    header.Height      = frame.Height;
+    header.Format      = static_cast<uint32_t>( frame.Format );
+    header.FrameNumber = frame.FrameNumber;
+
+    bool success = SDL_WriteIO( stream, &header, sizeof( header ) ) == sizeof( header ) && SDL_WriteIO( stream, frame.Pixels.data(), frame.Pixels.size() ) == frame.Pixels.size();
+    success      = SDL_CloseIO( stream ) && success;
+    if ( success == false )
+        IE_LOG_ERROR( "FrameCapture: Failed to write %s : %s", path.string().c_str(), SDL_GetError() );
+    return success;
+}
+
+bool FrameCapture::write_png( const Frame& frame, const std::filesystem::path& path )
+{
+    // wraps the pixels, nothing is copied
+    SDL_Surface* surface = SDL_CreateSurfaceFrom( frame.Width, frame.Height, get_pixelformat( frame.Format ), const_cast<Uint8*>( frame.Pixels.data() ), frame.Width * 4 );
+    if ( surface == nullptr ) {
+        IE_LOG_ERROR( "FrameCapture: SDL_CreateSurfaceFrom failed : %s", SDL_GetError() );
+        return false;
+    }
+
+    bool success = IMG_SavePNG( surface, path.string().c_str() );
+    if ( success == false )
+        IE_LOG_ERROR( "FrameCapture: Failed to write %s : %s", path.string().c_str(), SDL_GetError() );
+
+    SDL_DestroySurface( surface );
+    return success;
+}
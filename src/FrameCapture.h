@@ -0,0 +1,99 @@
+#pragma once
+#include "SDL3/SDL_gpu.h"
+
+#include "RenderTarget.h"
+#include "SPSCQueue.h"
+
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <semaphore>
+#include <thread>
+#include <vector>
+
+class GPURenderer;
+
+enum class FrameCaptureFormat
+{
+    Raw = 0,    // small header followed by the pixels as they came from the gpu, cheapest to write
+    PNG
+};
+
+struct FrameCaptureParameters
+{
+    std::filesystem::path Directory;
+    uint32_t              Interval      = 1;    // capture every Nth frame
+    FrameCaptureFormat    Format        = FrameCaptureFormat::PNG;
+    uint32_t              QueueCapacity = 8;    // frames that can wait for the encoder, the memory is allocated up front
+};
+
+struct FrameCaptureStats
+{
+    uint64_t Requested = 0;
+    uint64_t Written   = 0;
+    uint64_t Dropped   = 0;    // the encoder fell behind and all buffers were in use
+    uint64_t Failed    = 0;    // could not be read back or written to disk
+};
+
+// Records every Nth frame of the scene render target to disk.
+// The frames are read back asynchronously by the renderer, handed to an encoder thread through a lock-free queue
+// and written there, so neither the game thread nor the render thread ever waits on the disk.
+// When the encoder falls behind, frames are dropped instead of blocking.
+class FrameCapture
+{
+    struct Frame
+    {
+        std::vector<Uint8>   Pixels;
+        uint32_t             Width       = 0;
+        uint32_t             Height      = 0;
+        SDL_GPUTextureFormat Format      = SDL_GPU_TEXTUREFORMAT_INVALID;
+        uint64_t             FrameNumber = 0;
+    };
+
+    FrameCapture( const FrameCaptureParameters& params );
+
+public:
+    ~FrameCapture();
+
+    FrameCapture( const FrameCapture& other )            = delete;
+    FrameCapture( FrameCapture&& other )                 = delete;
+    FrameCapture& operator=( const FrameCapture& other ) = delete;
+    FrameCapture& operator=( FrameCapture&& other )      = delete;
+
+    // enables the scene render target of the renderer, the renderer has to outlive the capture
+    [[nodiscard]]
+    static std::optional<std::unique_ptr<FrameCapture>> create( GPURenderer* renderer, const FrameCaptureParameters& params );
+
+    // call once per collected frame from the thread that submits the frames
+    void on_frame( uint64_t frameNumber );
+
+    FrameCaptureStats get_stats() const;
+
+private:
+    // render thread, the pixels are only valid during the call
+    void on_readback( const ReadbackResult& result );
+
+    void encoderthread_run();
+    bool write_frame( const Frame& frame );
+    bool write_raw( const Frame& frame, const std::filesystem::path& path );
+    bool write_png( const Frame& frame, const std::filesystem::path& path );
+
+private:
+    GPURenderer*           m_renderer = nullptr;
+    FrameCaptureParameters m_params;
+    RenderTarget           m_target;
+
+    // buffers go round from the render thread to the encoder and back, each queue has one producer and one consumer
+    SPSCQueue<std::unique_ptr<Frame>> m_encodeQueue;
+    SPSCQueue<std::unique_ptr<Frame>> m_freeFrames;
+
+    std::counting_semaphore<> m_framesReady { 0 };
+    std::thread               m_encoderThread;
+    std::atomic_bool          m_stopEncoder = false;
+
+    std::atomic<uint64_t> m_requested = 0;
+    std::atomic<uint64_t> m_written   = 0;
+    std::atomic<uint64_t> m_dropped   = 0;
+    std::atomic<uint64_t> m_failed    = 0;
+};
@@ -0,0 +1,234 @@
+#include "iepch.h"
+#include "GPUBackend.h"
+
+#include "SDLGPUBackend.h"
+#include "NullGPUBackend.h"
+
+std::optional<std::unique_ptr<GPUBackend>> GPUBackend::create( GPUBackendType type, bool debugMode )
+{
+    switch ( type ) {
+    case GPUBackendType::SDL: {
+        auto backendOpt = SDLGPUBackend::create( debugMode );
+        if ( backendOpt.has_value() == false )
+            return std::nullopt;
+        return std::move( backendOpt.value() );
+    }
+    case GPUBackendType::Null:
+        IE_LOG_INFO( "Renderer: Using the null gpu backend, nothing will be rendered" );
+        return std::make_unique<NullGPUBackend>();
+    }
+    return std::nullopt;
+}
+
+SDL_GPUDevice* GPUBackend::get_sdldevice() const
+{
+    return nullptr;
+}
+
+GPUBackendStats GPUBackend::get_stats() const
+{
+    GPUBackendStats stats;
+    stats.Commands        = m_commands.load( std::memory_order_relaxed );
+    stats.CommandBuffers  = m_commandBuffers.load( std::memory_order_relaxed );
+    stats.CopyPasses      = m_copyPasses.load( std::memory_order_relaxed );
+    stats.RenderPasses    = m_renderPasses.load( std::memory_order_relaxed );
+    stats.DrawCalls       = m_drawCalls.load( std::memory_order_relaxed );
+    stats.Vertices        = m_vertices.load( std::memory_order_relaxed );
+    stats.UploadedBytes   = m_uploadedBytes.load( std::memory_order_relaxed );
+    stats.DownloadedBytes = m_downloadedBytes.load( std::memory_order_relaxed );
+    stats.UniformBytes    = m_uniformBytes.load( std::memory_order_relaxed );
+    stats.PipelineBinds   = m_pipelineBinds.load( std::memory_order_relaxed );
+    stats.TextureBinds    = m_textureBinds.load( std::memory_order_relaxed );
+    return stats;
+}
+
+void GPUBackend::count_command()
+{
+    m_commands.fetch_add( 1, std::memory_order_relaxed );
+}
+
+void GPUBackend::count_commandbuffer()
+{
+    m_commandBuffers.fetch_add( 1, std::memory_order_relaxed );
+}
+
+void GPUBackend::count_copypass()
+{
+    count_command();
+    m_copyPasses.fetch_add( 1, std::memory_order_relaxed );
+}
+
+void GPUBackend::count_renderpass()
+{
+    count_command();
+    m_renderPasses.fetch_add( 1, std::memory_order_relaxed );
+}
+
+void GPUBackend::count_draw( uint64_t vertices )
+{
+    count_command();
+    m_drawCalls.fetch_add( 1, std::memory_order_relaxed );
+    m_vertices.fetch_add( vertices, std::memory_order_relaxed );
+}
+
+void GPUBackend::count_upload( uint64_t bytes )
+{
+    count_command();
+    m_uploadedBytes.fetch_add( bytes, std::memory_order_relaxed );
+}
+
+void GPUBackend::count_download( uint64_t bytes )
+{
+    count_command();
+    m_downloadedBytes.fetch_add( bytes, std::memory_order_relaxed );
+}
+
+void GPUBackend::count_uniforms( uint64_t bytes )
+{
+    count_command();
+    m_uniformBytes.fetch_add( bytes, std::memory_order_relaxed );
+}
+
+void GPUBackend::count_pipelinebind()
+{
+    count_command();
+    m_pipelineBinds.fetch_add( 1, std::memory_order_relaxed );
+}
+
+void GPUBackend::count_texturebinds( uint64_t count )
+{
+    count_command();
+    m_textureBinds.fetch_add( count, std::memory_order_relaxed );
+}
+
+GPUMemoryReport GPUBackend::get_memory_report() const
+{
+    std::lock_guard<std::mutex> lock( m_memoryMutex );
+
+    GPUMemoryReport report;
+    report.Categories = m_memoryCategories;
+    report.Total      = m_memoryTotal;
+    for ( const auto& [name, owner] : m_memoryOwners )
+        report.Owners.push_back( { name, owner.Categories, owner.Total } );
+
+    std::sort( report.Owners.begin(), report.Owners.end(), []( const GPUMemoryOwnerUsage& a, const GPUMemoryOwnerUsage& b ) {
+        return a.Total.Current > b.Total.Current;
+    } );
+    return report;
+}
+
+GPUMemoryUsage GPUBackend::get_memory_usage( GPUMemoryCategory category ) const
+{
+    std::lock_guard<std::mutex> lock( m_memoryMutex );
+    return m_memoryCategories[static_cast<size_t>( category )];
+}
+
+GPUMemoryOwnerUsage GPUBackend::get_memory_usage( std::string_view owner ) const
+{
+    GPUMemoryOwnerUsage usage;
+    usage.Owner = owner;
+
+    std::lock_guard<std::mutex> lock( m_memoryMutex );
+    auto                        it = m_memoryOwners.find( usage.Owner );
+    if ( it != m_memoryOwners.end() ) {
+        usage.Categories = it->second.Categories;
+        usage.Total      = it->second.Total;
+    }
+    return usage;
+}
+
+GPUFrameAllocations GPUBackend::take_frame_allocations()
+{
+    std::lock_guard<std::mutex> lock( m_memoryMutex );
+
+    GPUFrameAllocations allocations;
+    allocations.Bytes = m_frameAllocatedBytes;
+    allocations.Count = m_frameAllocations;
+    for ( auto& [name, owner] : m_memoryOwners ) {
+        if ( owner.FrameBytes > allocations.LargestOwnerBytes ) {
+            allocations.LargestOwnerBytes = owner.FrameBytes;
+            allocations.LargestOwner      = name;
+        }
+        owner.FrameBytes = 0;
+    }
+
+    m_frameAllocatedBytes = 0;
+    m_frameAllocations    = 0;
+    return allocations;
+}
+
+uint64_t GPUBackend::get_texture_size( const SDL_GPUTextureCreateInfo* createInfo )
+{
+    // 3d textures halve their depth with every level, the others keep their layers
+    bool     volume = createInfo->type == SDL_GPU_TEXTURETYPE_3D;
+    uint64_t size   = 0;
+    for ( Uint32 level = 0; level < std::max( createInfo->num_levels, 1u ); ++level ) {
+        Uint32 width  = std::max( createInfo->width >> level, 1u );
+        Uint32 height = std::max( createInfo->height >> level, 1u );
+        Uint32 depth  = volume ? std::max( createInfo->layer_count_or_depth >> level, 1u ) : 1;
+        size += SDL_CalculateGPUTextureFormatSize( createInfo->format, width, height, depth );
+    }
+
+    if ( volume == false )
+        size *= std::max( createInfo->layer_count_or_depth, 1u );
+    return size << static_cast<uint32_t>( createInfo->sample_count );    // SDL_GPU_SAMPLECOUNT_1 is 0
+}
+
+void GPUBackend::track_allocation( const void* resource, GPUMemoryCategory category, uint64_t size, std::string_view owner, SDL_GPUTextureFormat format )
+{
+    if ( resource == nullptr )
+        return;
+
+    auto add = [size]( GPUMemoryUsage& usage ) {
+        usage.Current += size;
+        usage.Peak = std::max( usage.Peak, usage.Current );
+        usage.Allocations++;
+    };
+
+    std::lock_guard<std::mutex> lock( m_memoryMutex );
+    TrackedOwner&               trackedOwner = m_memoryOwners[std::string( owner )];
+    add( trackedOwner.Categories[static_cast<size_t>( category )] );
+    add( trackedOwner.Total );
+    add( m_memoryCategories[static_cast<size_t>( category )] );
+    add( m_memoryTotal );
+
+    trackedOwner.FrameBytes += size;
+    m_frameAllocatedBytes += size;
+    m_frameAllocations++;
+    m_allocations[resource] = { category, size, &trackedOwner, format };
+}
+
+void GPUBackend::untrack_allocation( const void* resource )
+{
+    std::lock_guard<std::mutex> lock( m_memoryMutex );
+    auto                        it = m_allocations.find( resource );
+    if ( it == m_allocations.end() )
+        return;
+
+    const TrackedAllocation& allocation = it->second;
+    auto                     remove     = [&allocation]( GPUMemoryUsage& usage ) {
+        usage.Current -= allocation.Size;
+        usage.Allocations--;
+    };
+
+    remove( allocation.Owner->Categories[static_cast<size_t>( allocation.Category )] );
+    remove( allocation.Owner->Total );
+    remove( m_memoryCategories[static_cast<size_t>( allocation.Category )] );
+    remove( m_memoryTotal );
+    m_allocations.erase( it );
+}
+
+uint64_t GPUBackend::get_region_size( const SDL_GPUTextureRegion* region )
+{
+    SDL_GPUTextureFormat format = SDL_GPU_TEXTUREFORMAT_INVALID;
+    {
+        std::lock_guard<std::mutex> lock( m_memoryMutex );
+        auto                        it = m_allocations.find( region->texture );
+        if ( it != m_allocations.end() )
+            format = it->second.Format;
+    }
+
+    if ( format == SDL_GPU_TEXTUREFORMAT_INVALID )
+        return static_cast<uint64_t>( region->w ) * region->h * region->d * 4;
+    return SDL_CalculateGPUTextureFormatSize( format, region->w, region->h, region->d );
+}
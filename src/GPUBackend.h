@@ -0,0 +1,215 @@
+#pragma once
+#include "SDL3/SDL_video.h"
+#include "SDL3/SDL_gpu.h"
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+enum class GPUBackendType
+{
+    SDL = 0,
+    Null    // records and counts everything, nothing gets executed (no gpu needed)
+};
+
+// everything a backend received since it was created
+struct GPUBackendStats
+{
+    uint64_t Commands        = 0;    // every call that records into a commandbuffer
+    uint64_t CommandBuffers  = 0;
+    uint64_t CopyPasses      = 0;
+    uint64_t RenderPasses    = 0;
+    uint64_t DrawCalls       = 0;
+    uint64_t Vertices        = 0;
+    uint64_t UploadedBytes   = 0;    // bytes copied from transfer buffers into buffers and textures
+    uint64_t DownloadedBytes = 0;
+    uint64_t UniformBytes    = 0;
+    uint64_t PipelineBinds   = 0;
+    uint64_t TextureBinds    = 0;    // texture and sampler pairs
+};
+
+enum class GPUMemoryCategory : uint8_t
+{
+    Buffer = 0,
+    Texture,
+    TransferBuffer    // host visible memory for uploads and downloads
+};
+static constexpr size_t GPUMemoryCategoryCount = 3;
+
+struct GPUMemoryUsage
+{
+    uint64_t Current     = 0;    // bytes
+    uint64_t Peak        = 0;
+    uint64_t Allocations = 0;    // alive
+};
+
+struct GPUMemoryOwnerUsage
+{
+    std::string                                        Owner;
+    std::array<GPUMemoryUsage, GPUMemoryCategoryCount> Categories;
+    GPUMemoryUsage                                     Total;
+};
+
+// memory of the buffers, textures and transfer buffers created through the backend
+struct GPUMemoryReport
+{
+    std::array<GPUMemoryUsage, GPUMemoryCategoryCount> Categories;
+    GPUMemoryUsage                                     Total;
+    std::vector<GPUMemoryOwnerUsage>                   Owners;    // largest current usage first
+};
+
+// everything allocated since the previous take_frame_allocations()
+struct GPUFrameAllocations
+{
+    uint64_t    Bytes             = 0;
+    uint64_t    Count             = 0;
+    uint64_t    LargestOwnerBytes = 0;
+    std::string LargestOwner;    // allocated the most bytes of them
+};
+
+// Thin layer over the SDL_GPU calls the engine uses, so the whole render path can run without a gpu.
+// The methods map 1:1 onto their SDL_GPU counterparts, the device is implicit.
+// Buffers, textures and transfer buffers are created for an owner (the asset or pipeline using them), the backend accounts their memory.
+class GPUBackend
+{
+public:
+    virtual ~GPUBackend() = default;
+
+    [[nodiscard]]
+    static std::optional<std::unique_ptr<GPUBackend>> create( GPUBackendType type, bool debugMode );
+
+    virtual GPUBackendType get_type() const = 0;
+    virtual SDL_GPUDevice* get_sdldevice() const;    // nullptr when there is no real device
+    GPUBackendStats        get_stats() const;
+
+    // memory accounting, threadsafe
+    GPUMemoryReport     get_memory_report() const;
+    GPUMemoryUsage      get_memory_usage( GPUMemoryCategory category ) const;
+    GPUMemoryOwnerUsage get_memory_usage( std::string_view owner ) const;
+    GPUFrameAllocations take_frame_allocations();
+
+    // bytes of all levels and layers, as the backends account it
+    static uint64_t get_texture_size( const SDL_GPUTextureCreateInfo* createInfo );
+
+    // device
+    virtual SDL_GPUShaderFormat  get_shaderformats()                                                                                              = 0;
+    virtual bool                 claim_window( SDL_Window* window )                                                                               = 0;
+    virtual void                 release_window( SDL_Window* window )                                                                             = 0;
+    virtual bool                 window_supports_presentmode( SDL_Window* window, SDL_GPUPresentMode presentMode )                                = 0;
+    virtual bool                 set_swapchain_parameters( SDL_Window* window, SDL_GPUSwapchainComposition composition, SDL_GPUPresentMode mode ) = 0;
+    virtual bool                 set_allowed_frames_in_flight( Uint32 count )                                                                     = 0;
+    virtual bool                 wait_for_swapchain( SDL_Window* window )                                                                         = 0;
+    virtual SDL_GPUTextureFormat get_swapchain_textureformat( SDL_Window* window )                                                                = 0;
+    virtual bool                 texture_supports_format( SDL_GPUTextureFormat format, SDL_GPUTextureType type, SDL_GPUTextureUsageFlags usage )  = 0;
+    virtual void                 wait_for_idle()                                                                                                  = 0;
+
+    // resources
+    virtual SDL_GPUBuffer*           create_buffer( const SDL_GPUBufferCreateInfo* createInfo, std::string_view owner )                 = 0;
+    virtual void                     release_buffer( SDL_GPUBuffer* buffer )                                                            = 0;
+    virtual SDL_GPUTransferBuffer*   create_transferbuffer( const SDL_GPUTransferBufferCreateInfo* createInfo, std::string_view owner ) = 0;
+    virtual void                     release_transferbuffer( SDL_GPUTransferBuffer* transferBuffer )                                    = 0;
+    virtual void*                    map_transferbuffer( SDL_GPUTransferBuffer* transferBuffer, bool cycle )                            = 0;
+    virtual void                     unmap_transferbuffer( SDL_GPUTransferBuffer* transferBuffer )                                      = 0;
+    virtual SDL_GPUTexture*          create_texture( const SDL_GPUTextureCreateInfo* createInfo, std::string_view owner )               = 0;
+    virtual void                     release_texture( SDL_GPUTexture* texture )                                                         = 0;
+    virtual SDL_GPUSampler*          create_sampler( const SDL_GPUSamplerCreateInfo* createInfo )                                       = 0;
+    virtual void                     release_sampler( SDL_GPUSampler* sampler )                                                         = 0;
+    virtual SDL_GPUShader*           create_shader( const SDL_GPUShaderCreateInfo* createInfo )                                         = 0;
+    virtual void                     release_shader( SDL_GPUShader* shader )                                                            = 0;
+    virtual SDL_GPUGraphicsPipeline* create_graphicspipeline( const SDL_GPUGraphicsPipelineCreateInfo* createInfo )                     = 0;
+    virtual void                     release_graphicspipeline( SDL_GPUGraphicsPipeline* pipeline )                                      = 0;
+
+    // submission
+    virtual SDL_GPUCommandBuffer* acquire_commandbuffer()                                                    = 0;
+    virtual bool                  submit_commandbuffer( SDL_GPUCommandBuffer* cmdbuf )                       = 0;
+    virtual SDL_GPUFence*         submit_commandbuffer_and_acquire_fence( SDL_GPUCommandBuffer* cmdbuf )     = 0;
+    virtual bool                  wait_for_fences( bool waitAll, SDL_GPUFence* const* fences, Uint32 count ) = 0;
+    virtual void                  release_fence( SDL_GPUFence* fence )                                       = 0;
+
+    // returns nullptr when there is no swapchain texture this frame (no window, minimized, ...)
+    virtual SDL_GPUTexture* acquire_swapchain_texture( SDL_GPUCommandBuffer* cmdbuf, SDL_Window* window ) = 0;
+
+    // copy pass
+    virtual SDL_GPUCopyPass* begin_copypass( SDL_GPUCommandBuffer* cmdbuf )                                                                                          = 0;
+    virtual void             end_copypass( SDL_GPUCopyPass* copyPass )                                                                                               = 0;
+    virtual void             upload_to_buffer( SDL_GPUCopyPass* copyPass, const SDL_GPUTransferBufferLocation* source, const SDL_GPUBufferRegion* dest, bool cycle ) = 0;
+    virtual void             upload_to_texture( SDL_GPUCopyPass* copyPass, const SDL_GPUTextureTransferInfo* source, const SDL_GPUTextureRegion* dest, bool cycle )  = 0;
+    virtual void             download_from_texture( SDL_GPUCopyPass* copyPass, const SDL_GPUTextureRegion* source, const SDL_GPUTextureTransferInfo* dest )          = 0;
+
+    // recorded outside of any pass
+    virtual void blit_texture( SDL_GPUCommandBuffer* cmdbuf, const SDL_GPUBlitInfo* blitInfo ) = 0;
+
+    // render pass
+    virtual SDL_GPURenderPass* begin_renderpass( SDL_GPUCommandBuffer* cmdbuf, const SDL_GPUColorTargetInfo* colorTargets, Uint32 colorTargetCount, const SDL_GPUDepthStencilTargetInfo* depthTarget ) = 0;
+    virtual void               end_renderpass( SDL_GPURenderPass* renderPass )                                                                                                                         = 0;
+    virtual void               set_viewport( SDL_GPURenderPass* renderPass, const SDL_GPUViewport* viewport )                                                                                          = 0;
+    virtual void               bind_graphicspipeline( SDL_GPURenderPass* renderPass, SDL_GPUGraphicsPipeline* pipeline )                                                                               = 0;
+    virtual void               push_vertex_uniformdata( SDL_GPUCommandBuffer* cmdbuf, Uint32 slot, const void* data, Uint32 length )                                                                   = 0;
+    virtual void               bind_vertex_storagebuffers( SDL_GPURenderPass* renderPass, Uint32 firstSlot, SDL_GPUBuffer* const* buffers, Uint32 count )                                              = 0;
+    virtual void               bind_fragment_samplers( SDL_GPURenderPass* renderPass, Uint32 firstSlot, const SDL_GPUTextureSamplerBinding* bindings, Uint32 count )                                   = 0;
+    virtual void               draw_primitives( SDL_GPURenderPass* renderPass, Uint32 vertexCount, Uint32 instanceCount, Uint32 firstVertex, Uint32 firstInstance )                                    = 0;
+
+protected:
+    // both implementations count the same way, so the numbers of a null run are comparable to a real one
+    void count_command();
+    void count_commandbuffer();
+    void count_copypass();
+    void count_renderpass();
+    void count_draw( uint64_t vertices );
+    void count_upload( uint64_t bytes );
+    void count_download( uint64_t bytes );
+    void count_uniforms( uint64_t bytes );
+    void count_pipelinebind();
+    void count_texturebinds( uint64_t count );
+
+    // called by the implementations for every created and released buffer, texture and transfer buffer
+    // textures pass their format, the transfers into and out of them are sized with it
+    void track_allocation( const void* resource, GPUMemoryCategory category, uint64_t size, std::string_view owner, SDL_GPUTextureFormat format = SDL_GPU_TEXTUREFORMAT_INVALID );
+    void untrack_allocation( const void* resource );
+
+    // bytes of the region in the format of its texture, block compressed formats are counted per block
+    // untracked textures like the swapchain count 4 bytes per texel
+    uint64_t get_region_size( const SDL_GPUTextureRegion* region );
+
+private:
+    struct TrackedOwner
+    {
+        std::array<GPUMemoryUsage, GPUMemoryCategoryCount> Categories;
+        GPUMemoryUsage                                     Total;
+        uint64_t                                           FrameBytes = 0;
+    };
+
+    struct TrackedAllocation
+    {
+        GPUMemoryCategory    Category = GPUMemoryCategory::Buffer;
+        uint64_t             Size     = 0;
+        TrackedOwner*        Owner    = nullptr;
+        SDL_GPUTextureFormat Format   = SDL_GPU_TEXTUREFORMAT_INVALID;    // only textures
+    };
+
+    std::atomic<uint64_t> m_commands        = 0;
+    std::atomic<uint64_t> m_commandBuffers  = 0;
+    std::atomic<uint64_t> m_copyPasses      = 0;
+    std::atomic<uint64_t> m_renderPasses    = 0;
+    std::atomic<uint64_t> m_drawCalls       = 0;
+    std::atomic<uint64_t> m_vertices        = 0;
+    std::atomic<uint64_t> m_uploadedBytes   = 0;
+    std::atomic<uint64_t> m_downloadedBytes = 0;
+    std::atomic<uint64_t> m_uniformBytes    = 0;
+    std::atomic<uint64_t> m_pipelineBinds   = 0;
+    std::atomic<uint64_t> m_textureBinds    = 0;
+
+    mutable std::mutex                                 m_memoryMutex;
+    std::array<GPUMemoryUsage, GPUMemoryCategoryCount> m_memoryCategories;
+    GPUMemoryUsage                                     m_memoryTotal;
+    std::unordered_map<std::string, TrackedOwner>      m_memoryOwners;    // never removed, they keep their peak
+    std::unordered_map<const void*, TrackedAllocation> m_allocations;
+    uint64_t                                           m_frameAllocatedBytes = 0;
+    uint64_t                                           m_frameAllocations    = 0;
+};
@@ -3,6 +3,7 @@
 
 #include "Renderer.h"
 #include "RenderCommandBuffer.h"
+#include "RenderGraph.h"
 
 GPUPipeline::~GPUPipeline()
 {
@@ -12,13 +13,90 @@ GPUPipeline::~GPUPipeline()
 void GPUPipeline::release()
 {
     if ( m_pipeline ) {
-        SDL_ReleaseGPUGraphicsPipeline( m_renderer->get_gpudevice(), m_pipeline );
+        m_renderer->get_backend()->release_graphicspipeline( m_pipeline );
         m_pipeline = nullptr;
     }
     m_initialized = false;
 }
 
-void GPUPipeline::submit()
+void GPUPipeline::submit( uint32_t nextFrameSlot )
 {
-    m_renderCmd->on_submit();
+    m_renderCmd->on_submit( nextFrameSlot );
+}
+
+void GPUPipeline::begin_dispatch( uint32_t frameSlot )
+{
+    m_dispatchSlot = frameSlot;
+    m_renderCmd->on_dispatch( frameSlot );
+}
+
+void GPUPipeline::end_dispatch()
+{
+    m_renderCmd->on_dispatch_finished();
+}
+
+void GPUPipeline::declare_passes( RenderGraph& graph )
+{
+    uint32_t         processing = needs_processing();
+    RenderResourceID instances  = graph.declare_resource( get_name() );
+    RenderResourceID target     = ( m_renderTarget != InvalidRenderResource ) ? m_renderTarget : m_renderer->get_default_rendertarget();
+
+    if ( processing & PipelineCommand::Copy ) {
+        graph.add_copypass( get_name(), {}, { instances }, [this]( RenderPassContext& context ) {
+            dispatch_copycommands( context.CommandBuffer, context.CopyPass );
+        } );
+    }
+
+    if ( processing & PipelineCommand::Render ) {
+        graph.add_renderpass( get_name(), { instances }, target, [this]( RenderPassContext& context ) {
+            dispatch_rendercommands( *context.ViewProjection, context.CommandBuffer, context.RenderPass );
+        } );
+    }
+}
+
+void GPUPipeline::set_depthstate( SDL_GPUGraphicsPipelineCreateInfo& createInfo, bool depthWrite ) const
+{
+    if ( m_renderer->has_depthbuffer() == false )
+        return;
+
+    // equal depths pass, sprites of the same layer are drawn over each other in order
+    createInfo.target_info.has_depth_stencil_target   = true;
+    createInfo.target_info.depth_stencil_format       = GPURenderer::DepthFormat;
+    createInfo.depth_stencil_state.enable_depth_test  = true;
+    createInfo.depth_stencil_state.enable_depth_write = depthWrite;
+    createInfo.depth_stencil_state.compare_op         = SDL_GPU_COMPAREOP_LESS_OR_EQUAL;
+}
+
+int32_t GPUPipeline::get_renderorder() const
+{
+    return m_renderOrder;
+}
+
+void GPUPipeline::set_renderorder( int32_t renderOrder )
+{
+    m_renderOrder = renderOrder;
+}
+
+RenderResourceID GPUPipeline::get_rendertarget() const
+{
+    return m_renderTarget;
+}
+
+void GPUPipeline::set_rendertarget( RenderResourceID renderTarget )
+{
+    m_renderTarget = renderTarget;
+}
+
+void GPUPipeline::capture_commands( CommandStreamWriter& writer [[maybe_unused]] )
+{
+}
+
+bool GPUPipeline::replay_commands( const CommandStreamChunk& chunk [[maybe_unused]] )
+{
+    return false;
+}
+
+bool GPUPipeline::hash_commands( CommandHasher& hasher [[maybe_unused]] ) const
+{
+    return false;
 }
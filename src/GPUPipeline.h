@@ -4,12 +4,19 @@
 #include "SimpleMath.h"
 namespace DXSM = DirectX::SimpleMath;
 
+#include <limits>
 #include <memory>
 #include <string>
 #include <vector>
 
 class GPURenderer;
 class RenderCommandQueue;
+class RenderGraph;
+class CommandStreamWriter;
+class CommandHasher;
+struct CommandStreamChunk;
+
+using RenderResourceID = uint32_t;
 
 enum PipelineCommand
 {
@@ -32,16 +39,46 @@ public:
 
     virtual bool                   init( GPURenderer* pRenderer ) = 0;
     virtual void                   release();
-    virtual void                   submit();
+    virtual void                   submit( uint32_t nextFrameSlot );
+    virtual void                   begin_dispatch( uint32_t frameSlot );
+    virtual void                   end_dispatch();
     virtual const std::string_view get_name() const         = 0;
     virtual uint32_t               needs_processing() const = 0;
     virtual void                   sort_commands() { };
+
+    // declares the passes of the frame that is currently dispatched
+    // the default uploads in a copy pass and renders into the render target, based on needs_processing()
+    virtual void declare_passes( RenderGraph& graph );
+
+    // pipelines with a lower render order declare their passes first
+    int32_t get_renderorder() const;
+    void    set_renderorder( int32_t renderOrder );
+
+    // render target resource of the graph, the renderers default target is used when none is set
+    RenderResourceID get_rendertarget() const;
+    void             set_rendertarget( RenderResourceID renderTarget );
+
+    // writes the commands of the dispatched frame as they were collected, unsorted
+    virtual void capture_commands( CommandStreamWriter& writer );
+    // collects captured commands into the frame that is currently collected, returns false when the data can not be replayed
+    virtual bool replay_commands( const CommandStreamChunk& chunk );
+    // adds everything that decides what the dispatched frame draws, after begin_dispatch
+    // returns false when the pipeline can not tell, the frame is never elided then
+    virtual bool hash_commands( CommandHasher& hasher ) const;
+
     virtual void                   dispatch_copycommands( SDL_GPUCommandBuffer* cmdbuf, SDL_GPUCopyPass* renderPass )                                         = 0;
     virtual void                   dispatch_rendercommands( const DXSM::Matrix& viewProjection, SDL_GPUCommandBuffer* cmdbuf, SDL_GPURenderPass* renderPass ) = 0;
 
+protected:
+    // sets up the depth target and test when the renderer has a depthbuffer, nearer layers have a smaller depth
+    void set_depthstate( SDL_GPUGraphicsPipelineCreateInfo& createInfo, bool depthWrite ) const;
+
 protected:
     bool                                m_initialized = false;
     GPURenderer*                        m_renderer    = nullptr;
     SDL_GPUGraphicsPipeline*            m_pipeline    = nullptr;
     std::shared_ptr<RenderCommandQueue> m_renderCmd;
+    uint32_t                            m_dispatchSlot = 0;    // frame slot the render thread is currently dispatching
+    int32_t                             m_renderOrder  = 0;
+    RenderResourceID                    m_renderTarget = std::numeric_limits<RenderResourceID>::max();
 };
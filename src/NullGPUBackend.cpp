@@ -0,0 +1,255 @@
+#include "iepch.h"
+#include "NullGPUBackend.h"
+
+// transfer buffers are real host memory, the handle points to it
+static std::vector<Uint8>* to_hostmemory( SDL_GPUTransferBuffer* transferBuffer )
+{
+    return reinterpret_cast<std::vector<Uint8>*>( transferBuffer );
+}
+
+template <typename T>
+T* NullGPUBackend::make_handle()
+{
+    // never dereferenced, only has to be unique and not null
+    return reinterpret_cast<T*>( m_nextHandle.fetch_add( 1, std::memory_order_relaxed ) * alignof( std::max_align_t ) );
+}
+
+GPUBackendType NullGPUBackend::get_type() const
+{
+    return GPUBackendType::Null;
+}
+
+SDL_GPUShaderFormat NullGPUBackend::get_shaderformats()
+{
+    return SDL_GPU_SHADERFORMAT_SPIRV;
+}
+
+bool NullGPUBackend::claim_window( SDL_Window* window [[maybe_unused]] )
+{
+    return true;
+}
+
+void NullGPUBackend::release_window( SDL_Window* window [[maybe_unused]] )
+{ }
+
+bool NullGPUBackend::window_supports_presentmode( SDL_Window* window [[maybe_unused]], SDL_GPUPresentMode presentMode [[maybe_unused]] )
+{
+    return true;
+}
+
+bool NullGPUBackend::set_swapchain_parameters( SDL_Window*                 window [[maybe_unused]],
+                                               SDL_GPUSwapchainComposition composition [[maybe_unused]],
+                                               SDL_GPUPresentMode          mode [[maybe_unused]] )
+{
+    return true;
+}
+
+bool NullGPUBackend::set_allowed_frames_in_flight( Uint32 count [[maybe_unused]] )
+{
+    return true;
+}
+
+bool NullGPUBackend::wait_for_swapchain( SDL_Window* window [[maybe_unused]] )
+{
+    return true;
+}
+
+SDL_GPUTextureFormat NullGPUBackend::get_swapchain_textureformat( SDL_Window* window [[maybe_unused]] )
+{
+    return SDL_GPU_TEXTUREFORMAT_B8G8R8A8_UNORM;
+}
+
+bool NullGPUBackend::texture_supports_format( SDL_GPUTextureFormat format [[maybe_unused]], SDL_GPUTextureType type [[maybe_unused]], SDL_GPUTextureUsageFlags usage [[maybe_unused]] )
+{
+    return true;
+}
+
+void NullGPUBackend::wait_for_idle()
+{ }
+
+SDL_GPUBuffer* NullGPUBackend::create_buffer( const SDL_GPUBufferCreateInfo* createInfo, std::string_view owner )
+{
+    SDL_GPUBuffer* buffer = make_handle<SDL_GPUBuffer>();
+    track_allocation( buffer, GPUMemoryCategory::Buffer, createInfo->size, owner );
+    return buffer;
+}
+
+void NullGPUBackend::release_buffer( SDL_GPUBuffer* buffer )
+{
+    untrack_allocation( buffer );
+}
+
+SDL_GPUTransferBuffer* NullGPUBackend::create_transferbuffer( const SDL_GPUTransferBufferCreateInfo* createInfo, std::string_view owner )
+{
+    SDL_GPUTransferBuffer* transferBuffer = reinterpret_cast<SDL_GPUTransferBuffer*>( new std::vector<Uint8>( createInfo->size ) );
+    track_allocation( transferBuffer, GPUMemoryCategory::TransferBuffer, createInfo->size, owner );
+    return transferBuffer;
+}
+
+void NullGPUBackend::release_transferbuffer( SDL_GPUTransferBuffer* transferBuffer )
+{
+    untrack_allocation( transferBuffer );
+    delete to_hostmemory( transferBuffer );
+}
+
+void* NullGPUBackend::map_transferbuffer( SDL_GPUTransferBuffer* transferBuffer, bool cycle [[maybe_unused]] )
+{
+    return to_hostmemory( transferBuffer )->data();
+}
+
+void NullGPUBackend::unmap_transferbuffer( SDL_GPUTransferBuffer* transferBuffer [[maybe_unused]] )
+{ }
+
+SDL_GPUTexture* NullGPUBackend::create_texture( const SDL_GPUTextureCreateInfo* createInfo, std::string_view owner )
+{
+    SDL_GPUTexture* texture = make_handle<SDL_GPUTexture>();
+    track_allocation( texture, GPUMemoryCategory::Texture, get_texture_size( createInfo ), owner, createInfo->format );
+    return texture;
+}
+
+void NullGPUBackend::release_texture( SDL_GPUTexture* texture )
+{
+    untrack_allocation( texture );
+}
+
+SDL_GPUSampler* NullGPUBackend::create_sampler( const SDL_GPUSamplerCreateInfo* createInfo [[maybe_unused]] )
+{
+    return make_handle<SDL_GPUSampler>();
+}
+
+void NullGPUBackend::release_sampler( SDL_GPUSampler* sampler [[maybe_unused]] )
+{ }
+
+SDL_GPUShader* NullGPUBackend::create_shader( const SDL_GPUShaderCreateInfo* createInfo [[maybe_unused]] )
+{
+    return make_handle<SDL_GPUShader>();
+}
+
+void NullGPUBackend::release_shader( SDL_GPUShader* shader [[maybe_unused]] )
+{ }
+
+SDL_GPUGraphicsPipeline* NullGPUBackend::create_graphicspipeline( const SDL_GPUGraphicsPipelineCreateInfo* createInfo [[maybe_unused]] )
+{
+    return make_handle<SDL_GPUGraphicsPipeline>();
+}
+
+void NullGPUBackend::release_graphicspipeline( SDL_GPUGraphicsPipeline* pipeline [[maybe_unused]] )
+{ }
+
+SDL_GPUCommandBuffer* NullGPUBackend::acquire_commandbuffer()
+{
+    count_commandbuffer();
+    return make_handle<SDL_GPUCommandBuffer>();
+}
+
+bool NullGPUBackend::submit_commandbuffer( SDL_GPUCommandBuffer* cmdbuf [[maybe_unused]] )
+{
+    return true;
+}
+
+SDL_GPUFence* NullGPUBackend::submit_commandbuffer_and_acquire_fence( SDL_GPUCommandBuffer* cmdbuf [[maybe_unused]] )
+{
+    // nothing is executed, so the fence is signaled right away
+    return make_handle<SDL_GPUFence>();
+}
+
+bool NullGPUBackend::wait_for_fences( bool waitAll [[maybe_unused]], SDL_GPUFence* const* fences [[maybe_unused]], Uint32 count [[maybe_unused]] )
+{
+    return true;
+}
+
+void NullGPUBackend::release_fence( SDL_GPUFence* fence [[maybe_unused]] )
+{ }
+
+SDL_GPUTexture* NullGPUBackend::acquire_swapchain_texture( SDL_GPUCommandBuffer* cmdbuf [[maybe_unused]], SDL_Window* window [[maybe_unused]] )
+{
+    // also without a window, so the render passes into the swapchain are recorded as well
+    return make_handle<SDL_GPUTexture>();
+}
+
+SDL_GPUCopyPass* NullGPUBackend::begin_copypass( SDL_GPUCommandBuffer* cmdbuf [[maybe_unused]] )
+{
+    count_copypass();
+    return make_handle<SDL_GPUCopyPass>();
+}
+
+void NullGPUBackend::end_copypass( SDL_GPUCopyPass* copyPass [[maybe_unused]] )
+{ }
+
+void NullGPUBackend::upload_to_buffer( SDL_GPUCopyPass*                     copyPass [[maybe_unused]],
+                                       const SDL_GPUTransferBufferLocation* source [[maybe_unused]],
+                                       const SDL_GPUBufferRegion*           dest,
+                                       bool                                 cycle [[maybe_unused]] )
+{
+    count_upload( dest->size );
+}
+
+void NullGPUBackend::upload_to_texture( SDL_GPUCopyPass*                  copyPass [[maybe_unused]],
+                                        const SDL_GPUTextureTransferInfo* source [[maybe_unused]],
+                                        const SDL_GPUTextureRegion*       dest,
+                                        bool                              cycle [[maybe_unused]] )
+{
+    count_upload( get_region_size( dest ) );
+}
+
+void NullGPUBackend::download_from_texture( SDL_GPUCopyPass* copyPass [[maybe_unused]], const SDL_GPUTextureRegion* source, const SDL_GPUTextureTransferInfo* dest [[maybe_unused]] )
+{
+    count_download( get_region_size( source ) );
+}
+
+void NullGPUBackend::blit_texture( SDL_GPUCommandBuffer* cmdbuf [[maybe_unused]], const SDL_GPUBlitInfo* blitInfo [[maybe_unused]] )
+{
+    count_command();
+}
+
+SDL_GPURenderPass* NullGPUBackend::begin_renderpass( SDL_GPUCommandBuffer*                cmdbuf [[maybe_unused]],
+                                                     const SDL_GPUColorTargetInfo*        colorTargets [[maybe_unused]],
+                                                     Uint32                               colorTargetCount [[maybe_unused]],
+                                                     const SDL_GPUDepthStencilTargetInfo* depthTarget [[maybe_unused]] )
+{
+    count_renderpass();
+    return make_handle<SDL_GPURenderPass>();
+}
+
+void NullGPUBackend::end_renderpass( SDL_GPURenderPass* renderPass [[maybe_unused]] )
+{ }
+
+void NullGPUBackend::set_viewport( SDL_GPURenderPass* renderPass [[maybe_unused]], const SDL_GPUViewport* viewport [[maybe_unused]] )
+{
+    count_command();
+}
+
+void NullGPUBackend::bind_graphicspipeline( SDL_GPURenderPass* renderPass [[maybe_unused]], SDL_GPUGraphicsPipeline* pipeline [[maybe_unused]] )
+{
+    count_pipelinebind();
+}
+
+void NullGPUBackend::push_vertex_uniformdata( SDL_GPUCommandBuffer* cmdbuf [[maybe_unused]], Uint32 slot [[maybe_unused]], const void* data [[maybe_unused]], Uint32 length )
+{
+    count_uniforms( length );
+}
+
+void NullGPUBackend::bind_vertex_storagebuffers( SDL_GPURenderPass*    renderPass [[maybe_unused]],
+                                                 Uint32                firstSlot [[maybe_unused]],
+                                                 SDL_GPUBuffer* const* buffers [[maybe_unused]],
+                                                 Uint32                count [[maybe_unused]] )
+{
+    count_command();
+}
+
+void NullGPUBackend::bind_fragment_samplers( SDL_GPURenderPass*                  renderPass [[maybe_unused]],
+                                             Uint32                              firstSlot [[maybe_unused]],
+                                             const SDL_GPUTextureSamplerBinding* bindings [[maybe_unused]],
+                                             Uint32                              count )
+{
+    count_texturebinds( count );
+}
+
+void NullGPUBackend::draw_primitives( SDL_GPURenderPass* renderPass [[maybe_unused]],
+                                      Uint32             vertexCount,
+                                      Uint32             instanceCount,
+                                      Uint32             firstVertex [[maybe_unused]],
+                                      Uint32             firstInstance [[maybe_unused]] )
+{
+    count_draw( static_cast<uint64_t>( vertexCount ) * instanceCount );
+}
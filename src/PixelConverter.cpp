@@ -0,0 +1,318 @@
+#include "iepch.h"
+#include "PixelConverter.h"
+
+#if defined( _M_X64 ) || defined( _M_IX86 ) || defined( __x86_64__ ) || defined( __i386__ )
+    #define IE_PIXELS_X86 1
+    #include <immintrin.h>
+#elif defined( _M_ARM64 ) || defined( __ARM_NEON )
+    #define IE_PIXELS_NEON 1
+    #include <arm_neon.h>
+#endif
+
+// msvc compiles intrinsics of every instruction set, gcc and clang only inside functions targeting it
+#if defined( __GNUC__ ) || defined( __clang__ )
+    #define IE_TARGET( isa ) __attribute__( ( target( isa ) ) )
+#else
+    #define IE_TARGET( isa )
+#endif
+
+// where the channels are inside one source pixel
+struct PixelLayout
+{
+    uint32_t BytesPerPixel = 0;
+    int8_t   Channel[4]    = { -1, -1, -1, -1 };    // byte of r, g, b and a, -1 for a missing alpha
+    Uint8    Shuffle[16]   = {};                    // the same for 4 pixels as pshufb mask, 0x80 clears the byte
+
+    bool has_alpha() const { return Channel[3] >= 0; }
+};
+
+static bool get_layout( SDL_PixelFormat format, PixelLayout& layout )
+{
+    if ( format == SDL_PIXELFORMAT_RGB24 ) {
+        layout = { 3, { 0, 1, 2, -1 } };
+    }
+    else if ( format == SDL_PIXELFORMAT_BGR24 ) {
+        layout = { 3, { 2, 1, 0, -1 } };
+    }
+    else {
+        // packed 32 bit formats with 8 bit channels, the shift is the byte on little endian machines
+        const SDL_PixelFormatDetails* details = SDL_GetPixelFormatDetails( format );
+        if ( SDL_BYTEORDER != SDL_LIL_ENDIAN || details == nullptr || SDL_ISPIXELFORMAT_PACKED( format ) == false || details->bytes_per_pixel != 4 )
+            return false;
+        if ( details->Rbits != 8 || details->Gbits != 8 || details->Bbits != 8 || ( details->Abits != 8 && details->Abits != 0 ) )
+            return false;
+
+        layout = { 4,
+                   { static_cast<int8_t>( details->Rshift / 8 ),
+                     static_cast<int8_t>( details->Gshift / 8 ),
+                     static_cast<int8_t>( details->Bshift / 8 ),
+                     static_cast<int8_t>( details->Abits ? details->Ashift / 8 : -1 ) } };
+    }
+
+    for ( uint32_t pixel = 0; pixel < 4; ++pixel ) {
+        for ( uint32_t channel = 0; channel < 4; ++channel ) {
+            int8_t source = layout.Channel[channel];
+            layout.Shuffle[pixel * 4 + channel] = ( source < 0 ) ? 0x80 : static_cast<Uint8>( pixel * layout.BytesPerPixel + source );
+        }
+    }
+    return true;
+}
+
+// round( color * alpha / 255 ), exact for all 8 bit inputs
+static inline Uint8 multiply_alpha( uint32_t color, uint32_t alpha )
+{
+    uint32_t value = color * alpha + 128;
+    return static_cast<Uint8>( ( value + ( value >> 8 ) ) >> 8 );
+}
+
+static void convert_row_scalar( const Uint8* src, Uint8* dst, uint32_t count, const PixelLayout& layout, bool premultiply )
+{
+    for ( uint32_t i = 0; i < count; ++i, src += layout.BytesPerPixel, dst += 4 ) {
+        Uint8 r = src[layout.Channel[0]];
+        Uint8 g = src[layout.Channel[1]];
+        Uint8 b = src[layout.Channel[2]];
+        Uint8 a = layout.has_alpha() ? src[layout.Channel[3]] : 255;
+        if ( premultiply && a != 255 ) {
+            r = multiply_alpha( r, a );
+            g = multiply_alpha( g, a );
+            b = multiply_alpha( b, a );
+        }
+        dst[0] = r;
+        dst[1] = g;
+        dst[2] = b;
+        dst[3] = a;
+    }
+}
+
+#ifdef IE_PIXELS_X86
+// 16 bit lanes, round( x / 255 ) like multiply_alpha
+static inline __m128i divide_255( __m128i value )
+{
+    value = _mm_add_epi16( value, _mm_set1_epi16( 128 ) );
+    return _mm_srli_epi16( _mm_add_epi16( value, _mm_srli_epi16( value, 8 ) ), 8 );
+}
+
+static inline __m128i premultiply_sse2( __m128i rgba )
+{
+    __m128i zero  = _mm_setzero_si128();
+    __m128i low   = _mm_unpacklo_epi8( rgba, zero );
+    __m128i high  = _mm_unpackhi_epi8( rgba, zero );
+    __m128i alpha = _mm_set1_epi32( static_cast<int>( 0xFF000000 ) );
+
+    // the alpha of each pixel is the last of its four 16 bit lanes
+    low  = divide_255( _mm_mullo_epi16( low, _mm_shufflehi_epi16( _mm_shufflelo_epi16( low, 0xFF ), 0xFF ) ) );
+    high = divide_255( _mm_mullo_epi16( high, _mm_shufflehi_epi16( _mm_shufflelo_epi16( high, 0xFF ), 0xFF ) ) );
+    return _mm_or_si128( _mm_andnot_si128( alpha, _mm_packus_epi16( low, high ) ), _mm_and_si128( alpha, rgba ) );
+}
+
+// returns the number of pixels converted, the rest is left to the scalar kernel
+static IE_TARGET( "ssse3" ) uint32_t convert_row_ssse3( const Uint8* src, Uint8* dst, uint32_t count, const PixelLayout& layout, bool premultiply )
+{
+    __m128i shuffle = _mm_loadu_si128( reinterpret_cast<const __m128i*>( layout.Shuffle ) );
+    __m128i fill    = layout.has_alpha() ? _mm_setzero_si128() : _mm_set1_epi32( static_cast<int>( 0xFF000000 ) );
+    premultiply     = premultiply && layout.has_alpha();
+
+    // every load reads 16 bytes, 24 bit pixels only use 12 of them
+    uint32_t loadPixels = ( 16 + layout.BytesPerPixel - 1 ) / layout.BytesPerPixel;
+    uint32_t i          = 0;
+    for ( ; i + loadPixels <= count; i += 4 ) {
+        __m128i pixels = _mm_loadu_si128( reinterpret_cast<const __m128i*>( src + i * layout.BytesPerPixel ) );
+        pixels         = _mm_or_si128( _mm_shuffle_epi8( pixels, shuffle ), fill );
+        if ( premultiply )
+            pixels = premultiply_sse2( pixels );
+        _mm_storeu_si128( reinterpret_cast<__m128i*>( dst + i * 4 ), pixels );
+    }
+    return i;
+}
+
+static IE_TARGET( "avx2" ) inline __m256i divide_255_avx2( __m256i value )
+{
+    value = _mm256_add_epi16( value, _mm256_set1_epi16( 128 ) );
+    return _mm256_srli_epi16( _mm256_add_epi16( value, _mm256_srli_epi16( value, 8 ) ), 8 );
+}
+
+// 32 bit pixels never cross the 128 bit lanes the avx2 shuffles work in
+static IE_TARGET( "avx2" ) uint32_t convert_row_avx2( const Uint8* src, Uint8* dst, uint32_t count, const PixelLayout& layout, bool premultiply )
+{
+    if ( layout.BytesPerPixel != 4 )
+        return convert_row_ssse3( src, dst, count, layout, premultiply );
+
+    __m256i shuffle = _mm256_broadcastsi128_si256( _mm_loadu_si128( reinterpret_cast<const __m128i*>( layout.Shuffle ) ) );
+    __m256i alpha   = _mm256_set1_epi32( static_cast<int>( 0xFF000000 ) );
+    __m256i fill    = layout.has_alpha() ? _mm256_setzero_si256() : alpha;
+    __m256i zero    = _mm256_setzero_si256();
+    premultiply     = premultiply && layout.has_alpha();
+
+    uint32_t i = 0;
+    for ( ; i + 8 <= count; i += 8 ) {
+        __m256i pixels = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( src + i * 4 ) );
+        pixels         = _mm256_or_si256( _mm256_shuffle_epi8( pixels, shuffle ), fill );
+        if ( premultiply ) {
+            __m256i low  = _mm256_unpacklo_epi8( pixels, zero );
+            __m256i high = _mm256_unpackhi_epi8( pixels, zero );
+            low          = divide_255_avx2( _mm256_mullo_epi16( low, _mm256_shufflehi_epi16( _mm256_shufflelo_epi16( low, 0xFF ), 0xFF ) ) );
+            high         = divide_255_avx2( _mm256_mullo_epi16( high, _mm256_shufflehi_epi16( _mm256_shufflelo_epi16( high, 0xFF ), 0xFF ) ) );
+            pixels       = _mm256_or_si256( _mm256_andnot_si256( alpha, _mm256_packus_epi16( low, high ) ), _mm256_and_si256( alpha, pixels ) );
+        }
+        _mm256_storeu_si256( reinterpret_cast<__m256i*>( dst + i * 4 ), pixels );
+    }
+    return i + convert_row_ssse3( src + i * 4, dst + i * 4, count - i, layout, premultiply );
+}
+#endif
+
+#ifdef IE_PIXELS_NEON
+// round( color * alpha / 255 ) like multiply_alpha
+static inline uint8x16_t premultiply_neon( uint8x16_t color, uint8x16_t alpha )
+{
+    uint16x8_t low  = vmull_u8( vget_low_u8( color ), vget_low_u8( alpha ) );
+    uint16x8_t high = vmull_u8( vget_high_u8( color ), vget_high_u8( alpha ) );
+    return vcombine_u8( vraddhn_u16( low, vrshrq_n_u16( low, 8 ) ), vraddhn_u16( high, vrshrq_n_u16( high, 8 ) ) );
+}
+
+// the structured loads split the channels, so no shuffle mask is needed
+static uint32_t convert_row_neon( const Uint8* src, Uint8* dst, uint32_t count, const PixelLayout& layout, bool premultiply )
+{
+    premultiply = premultiply && layout.has_alpha();
+
+    uint32_t i = 0;
+    for ( ; i + 16 <= count; i += 16 ) {
+        uint8x16_t channels[4];
+        if ( layout.BytesPerPixel == 4 ) {
+            uint8x16x4_t pixels = vld4q_u8( src + i * 4 );
+            for ( uint32_t c = 0; c < 4; ++c )
+                channels[c] = pixels.val[c];
+        }
+        else {
+            uint8x16x3_t pixels = vld3q_u8( src + i * 3 );
+            for ( uint32_t c = 0; c < 3; ++c )
+                channels[c] = pixels.val[c];
+        }
+
+        uint8x16x4_t rgba;
+        rgba.val[0] = channels[layout.Channel[0]];
+        rgba.val[1] = channels[layout.Channel[1]];
+        rgba.val[2] = channels[layout.Channel[2]];
+        rgba.val[3] = layout.has_alpha() ? channels[layout.Channel[3]] : vdupq_n_u8( 255 );
+        if ( premultiply ) {
+            rgba.val[0] = premultiply_neon( rgba.val[0], rgba.val[3] );
+            rgba.val[1] = premultiply_neon( rgba.val[1], rgba.val[3] );
+            rgba.val[2] = premultiply_neon( rgba.val[2], rgba.val[3] );
+        }
+        vst4q_u8( dst + i * 4, rgba );
+    }
+    return i;
+}
+#endif
+
+static void convert_row( const Uint8* src, Uint8* dst, uint32_t count, const PixelLayout& layout, bool premultiply, PixelConverter::SimdLevel level )
+{
+    uint32_t done = 0;
+    switch ( level ) {
+#ifdef IE_PIXELS_X86
+        case PixelConverter::SimdLevel::SSSE3:
+            done = convert_row_ssse3( src, dst, count, layout, premultiply );
+            break;
+        case PixelConverter::SimdLevel::AVX2:
+            done = convert_row_avx2( src, dst, count, layout, premultiply );
+            break;
+#endif
+#ifdef IE_PIXELS_NEON
+        case PixelConverter::SimdLevel::NEON:
+            done = convert_row_neon( src, dst, count, layout, premultiply );
+            break;
+#endif
+        default:
+            break;
+    }
+    convert_row_scalar( src + done * layout.BytesPerPixel, dst + done * 4, count - done, layout, premultiply );
+}
+
+PixelConverter::SimdLevel PixelConverter::get_best_level()
+{
+    static const SimdLevel bestLevel = []() {
+        for ( SimdLevel level : { SimdLevel::AVX2, SimdLevel::SSSE3, SimdLevel::NEON } ) {
+            if ( is_supported( level ) )
+                return level;
+        }
+        return SimdLevel::Scalar;
+    }();
+    return bestLevel;
+}
+
+bool PixelConverter::is_supported( SimdLevel level )
+{
+    switch ( level ) {
+        case SimdLevel::Scalar:
+            return true;
+#ifdef IE_PIXELS_X86
+        case SimdLevel::SSSE3:
+            return SDL_HasSSE41();    // SDL does not report SSSE3 on its own, every cpu with SSE4.1 has it
+        case SimdLevel::AVX2:
+            return SDL_HasAVX2();
+#endif
+#ifdef IE_PIXELS_NEON
+        case SimdLevel::NEON:
+            return SDL_HasNEON();
+#endif
+        default:
+            return false;
+    }
+}
+
+const char* PixelConverter::get_level_name( SimdLevel level )
+{
+    switch ( level ) {
+        case SimdLevel::Scalar:
+            return "Scalar";
+        case SimdLevel::SSSE3:
+            return "SSSE3";
+        case SimdLevel::AVX2:
+            return "AVX2";
+        case SimdLevel::NEON:
+            return "NEON";
+    }
+    return "Unknown";
+}
+
+bool PixelConverter::has_fast_path( SDL_PixelFormat format )
+{
+    PixelLayout layout;
+    return get_layout( format, layout );
+}
+
+bool PixelConverter::convert_to_rgba8( SDL_Surface* surface, Uint8* dst, uint32_t dstPitch, bool premultiply )
+{
+    return convert_to_rgba8( surface, dst, dstPitch, premultiply, get_best_level() );
+}
+
+bool PixelConverter::convert_to_rgba8( SDL_Surface* surface, Uint8* dst, uint32_t dstPitch, bool premultiply, SimdLevel level )
+{
+    IE_ASSERT( surface != nullptr && dst != nullptr && dstPitch >= static_cast<uint32_t>( surface->w ) * 4 );
+    IE_ASSERT( is_supported( level ) );
+
+    // rare formats are converted by SDL into a temporary surface, the shuffle is then only a copy (and the premultiply)
+    SDL_Surface* converted = nullptr;
+    PixelLayout  layout;
+    if ( get_layout( surface->format, layout ) == false ) {
+        converted = SDL_ConvertSurface( surface, SDL_PIXELFORMAT_RGBA32 );
+        if ( converted == nullptr ) {
+            IE_LOG_ERROR( "Could not convert a %s surface: %s", SDL_GetPixelFormatName( surface->format ), SDL_GetError() );
+            return false;
+        }
+        get_layout( converted->format, layout );
+    }
+
+    SDL_Surface* source = converted ? converted : surface;
+    if ( SDL_MUSTLOCK( source ) )
+        SDL_LockSurface( source );
+
+    const Uint8* srcRow = static_cast<const Uint8*>( source->pixels );
+    for ( int y = 0; y < source->h; ++y, srcRow += source->pitch, dst += dstPitch )
+        convert_row( srcRow, dst, static_cast<uint32_t>( source->w ), layout, premultiply, level );
+
+    if ( SDL_MUSTLOCK( source ) )
+        SDL_UnlockSurface( source );
+    if ( converted )
+        SDL_DestroySurface( converted );
+    return true;
+}
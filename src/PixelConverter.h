@@ -0,0 +1,29 @@
+#pragma once
+#include "SDL3/SDL_surface.h"
+
+// Converts loaded images into the RGBA8 texel layout of the sprite textures, optionally with premultiplied alpha.
+// 24 and 32 bit formats with 8 bit channels are shuffled by vectorised kernels, the best one the cpu supports is picked at runtime.
+// Everything else (palettes, 16 bit, 10 bit) goes through SDL_ConvertSurface first.
+class PixelConverter
+{
+public:
+    enum class SimdLevel : uint8_t
+    {
+        Scalar = 0,
+        SSSE3,
+        AVX2,    // 32 bit formats only, 24 bit ones use the SSSE3 kernel
+        NEON
+    };
+
+    static SimdLevel   get_best_level();
+    static bool        is_supported( SimdLevel level );
+    static const char* get_level_name( SimdLevel level );
+
+    // true if the surface is shuffled directly, without a conversion through SDL
+    static bool has_fast_path( SDL_PixelFormat format );
+
+    // writes width * height RGBA8 texels into dst, rows are dstPitch bytes apart (at least width * 4)
+    // dst can be mapped transfer buffer memory, it is only written to
+    static bool convert_to_rgba8( SDL_Surface* surface, Uint8* dst, uint32_t dstPitch, bool premultiply );
+    static bool convert_to_rgba8( SDL_Surface* surface, Uint8* dst, uint32_t dstPitch, bool premultiply, SimdLevel level );
+};
@@ -0,0 +1,189 @@
+#include "iepch.h"
+#include "ReadbackQueue.h"
+
+#include "GPUBackend.h"
+#include "RenderGraph.h"
+
+static ReadbackResult make_failed_result( SDL_GPUTextureFormat format, uint64_t frameNumber )
+{
+    ReadbackResult result;
+    result.Format      = format;
+    result.FrameNumber = frameNumber;
+    return result;
+}
+
+ReadbackQueue::~ReadbackQueue()
+{
+    release();
+}
+
+void ReadbackQueue::init( GPUBackend* backend, uint32_t frameSlots )
+{
+    IE_ASSERT( backend != nullptr && frameSlots > 0 );
+    m_backend = backend;
+    m_frameDownloads.resize( frameSlots );
+}
+
+void ReadbackQueue::release()
+{
+    // whatever never got delivered fails, so no caller waits on a callback that never comes
+    for ( auto& downloads : m_frameDownloads ) {
+        for ( Download& download : downloads ) {
+            if ( download.Pending )
+                download.Callback( make_failed_result( download.Target.Format, download.FrameNumber ) );
+
+            if ( download.TransferBuffer )
+                m_backend->release_transferbuffer( download.TransferBuffer );
+        }
+    }
+    m_frameDownloads.clear();
+
+    std::vector<Request> requests;
+    {
+        std::lock_guard<std::mutex> lock( m_requestMutex );
+        requests.swap( m_requests );
+    }
+
+    // the callbacks are called without holding the lock, they may request again
+    for ( Request& request : requests )
+        request.Callback( make_failed_result( request.Target.Format, 0 ) );
+}
+
+void ReadbackQueue::request( const RenderTarget& target, ReadbackCallback callback )
+{
+    IE_ASSERT( target.Resource != InvalidRenderResource );
+    std::lock_guard<std::mutex> lock( m_requestMutex );
+    m_requests.push_back( { target, std::move( callback ) } );
+}
+
+void ReadbackQueue::declare_passes( RenderGraph& graph, uint32_t frameSlot, uint64_t frameNumber )
+{
+    IE_ASSERT( frameSlot < m_frameDownloads.size() );
+    {
+        std::lock_guard<std::mutex> lock( m_requestMutex );
+        m_processingRequests.swap( m_requests );
+    }
+
+    if ( m_processingRequests.empty() )
+        return;
+
+    // nothing reads the downloads inside the graph, they must not be culled
+    RenderResourceID readback = graph.declare_resource( "Readback" );
+    graph.mark_output( readback );
+
+    for ( Request& request : m_processingRequests ) {
+        // with dynamic resolution the frame only covers the viewport of the target
+        const RenderTarget& target   = request.Target;
+        SDL_GPUViewport     viewport = graph.get_viewport( target.Resource );
+        SDL_Rect            region   = { 0, 0, static_cast<int>( target.Width ), static_cast<int>( target.Height ) };
+        if ( viewport.w > 0.0f && viewport.h > 0.0f )
+            region = { static_cast<int>( viewport.x ), static_cast<int>( viewport.y ), static_cast<int>( viewport.w ), static_cast<int>( viewport.h ) };
+
+        uint32_t size = SDL_CalculateGPUTextureFormatSize( target.Format, static_cast<Uint32>( region.w ), static_cast<Uint32>( region.h ), 1 );
+
+        size_t    downloadIdx = acquire_download( frameSlot, size );
+        Download& download    = m_frameDownloads[frameSlot][downloadIdx];
+        if ( download.TransferBuffer == nullptr ) {
+            request.Callback( make_failed_result( target.Format, frameNumber ) );
+            continue;
+        }
+
+        download.Pending     = true;
+        download.Recorded    = false;
+        download.Target      = target;
+        download.Region      = region;
+        download.Callback    = std::move( request.Callback );
+        download.FrameNumber = frameNumber;
+
+        graph.add_copypass( "Readback", { target.Resource }, { readback }, [this, frameSlot, downloadIdx]( RenderPassContext& context ) {
+            Download&       download = m_frameDownloads[frameSlot][downloadIdx];
+            SDL_GPUTexture* texture  = context.Graph->get_texture( download.Target.Resource );
+            if ( texture == nullptr )
+                return;
+
+            SDL_GPUTextureRegion source = {};
+            source.texture              = texture;
+            source.x                    = static_cast<Uint32>( download.Region.x );
+            source.y                    = static_cast<Uint32>( download.Region.y );
+            source.w                    = static_cast<Uint32>( download.Region.w );
+            source.h                    = static_cast<Uint32>( download.Region.h );
+            source.d                    = 1;
+
+            SDL_GPUTextureTransferInfo dest = {};
+            dest.transfer_buffer            = download.TransferBuffer;
+            dest.offset                     = 0;    // tightly packed
+
+            context.Backend->download_from_texture( context.CopyPass, &source, &dest );
+            download.Recorded = true;
+        } );
+    }
+    m_processingRequests.clear();
+}
+
+void ReadbackQueue::deliver( uint32_t frameSlot )
+{
+    IE_ASSERT( frameSlot < m_frameDownloads.size() );
+    for ( Download& download : m_frameDownloads[frameSlot] ) {
+        if ( download.Pending == false )
+            continue;
+
+        // downloads of frames that were never submitted fail
+        void* data = download.Recorded ? m_backend->map_transferbuffer( download.TransferBuffer, false ) : nullptr;
+        if ( data == nullptr ) {
+            if ( download.Recorded )
+                IE_LOG_ERROR( "SDL_MapGPUTransferBuffer failed : %s", SDL_GetError() );
+            download.Callback( make_failed_result( download.Target.Format, download.FrameNumber ) );
+        }
+        else {
+            ReadbackResult result;
+            result.Pixels      = static_cast<const Uint8*>( data );
+            result.Size        = SDL_CalculateGPUTextureFormatSize( download.Target.Format, static_cast<Uint32>( download.Region.w ), static_cast<Uint32>( download.Region.h ), 1 );
+            result.Width       = static_cast<uint32_t>( download.Region.w );
+            result.Height      = static_cast<uint32_t>( download.Region.h );
+            result.Format      = download.Target.Format;
+            result.FrameNumber = download.FrameNumber;
+            download.Callback( result );
+            m_backend->unmap_transferbuffer( download.TransferBuffer );
+        }
+
+        download.Pending  = false;
+        download.Recorded = false;
+        download.Callback = nullptr;
+    }
+}
+
+uint32_t ReadbackQueue::get_pending_count() const
+{
+    std::lock_guard<std::mutex> lock( m_requestMutex );
+    return static_cast<uint32_t>( m_requests.size() );
+}
+
+size_t ReadbackQueue::acquire_download( uint32_t frameSlot, uint32_t size )
+{
+    std::vector<Download>& downloads = m_frameDownloads[frameSlot];
+
+    size_t downloadIdx = 0;
+    while ( downloadIdx < downloads.size() && downloads[downloadIdx].Pending )
+        ++downloadIdx;
+
+    if ( downloadIdx == downloads.size() )
+        downloads.emplace_back();
+
+    Download& download = downloads[downloadIdx];
+    if ( download.TransferBuffer != nullptr && download.TransferBufferSize >= size )
+        return downloadIdx;
+
+    if ( download.TransferBuffer != nullptr )
+        m_backend->release_transferbuffer( download.TransferBuffer );
+
+    SDL_GPUTransferBufferCreateInfo createInfo = {};
+    createInfo.usage                           = SDL_GPU_TRANSFERBUFFERUSAGE_DOWNLOAD;
+    createInfo.size                            = size;
+
+    download.TransferBuffer     = m_backend->create_transferbuffer( &createInfo, "ReadbackQueue" );
+    download.TransferBufferSize = ( download.TransferBuffer != nullptr ) ? size : 0;
+    if ( download.TransferBuffer == nullptr ) {
+        IE_LOG_ERROR( "Failed to create readback GPUTransferBuffer!" );
+    }
+    return downloadIdx;
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include "SDL3/SDL_gpu.h"
+
+#include "RenderTarget.h"
+
+#include <mutex>
+#include <vector>
+
+class GPUBackend;
+class RenderGraph;
+
+// Asynchronous downloads of render targets.
+// Every frame slot owns a ring of download transfer buffers. The download is recorded into the frame
+// and only mapped after the fence of that frame slot signaled, which the renderer waits on anyway
+// before reusing the slot, so reading back never stalls the gpu or the render thread.
+class ReadbackQueue
+{
+public:
+    ReadbackQueue() = default;
+    ~ReadbackQueue();
+
+    ReadbackQueue( const ReadbackQueue& other )            = delete;
+    ReadbackQueue( ReadbackQueue&& other )                 = delete;
+    ReadbackQueue& operator=( const ReadbackQueue& other ) = delete;
+    ReadbackQueue& operator=( ReadbackQueue&& other )      = delete;
+
+    void init( GPUBackend* backend, uint32_t frameSlots );
+    void release();
+
+    // threadsafe, the download is recorded into the next processed frame
+    // the callback is invoked on the render thread once the gpu finished that frame
+    // only the viewport the frame was rendered into is read back, the result has its size
+    // every request gets its callback, with a failed result if the download could not be recorded or mapped,
+    // or if the queue gets released before it was delivered
+    void request( const RenderTarget& target, ReadbackCallback callback );
+
+    // render thread only
+    void declare_passes( RenderGraph& graph, uint32_t frameSlot, uint64_t frameNumber );
+
+    // render thread only, the fence of the frame slot has to be signaled
+    void deliver( uint32_t frameSlot );
+
+    uint32_t get_pending_count() const;
+
+private:
+    struct Request
+    {
+        RenderTarget     Target;
+        ReadbackCallback Callback;
+    };
+
+    struct Download
+    {
+        SDL_GPUTransferBuffer* TransferBuffer     = nullptr;
+        uint32_t               TransferBufferSize = 0;
+        bool                   Pending            = false;    // requested for the frame in this slot
+        bool                   Recorded           = false;    // the download made it into the commandbuffer
+        RenderTarget           Target;
+        SDL_Rect               Region = {};    // viewport of the frame in the target
+        ReadbackCallback       Callback;
+        uint64_t               FrameNumber = 0;
+    };
+
+    // returns the index of a free download in the frame slot that can hold size bytes
+    size_t acquire_download( uint32_t frameSlot, uint32_t size );
+
+private:
+    GPUBackend*                        m_backend = nullptr;
+    std::vector<std::vector<Download>> m_frameDownloads;
+
+    mutable std::mutex   m_requestMutex;
+    std::vector<Request> m_requests;
+    std::vector<Request> m_processingRequests;
+};
@@ -1,15 +1,19 @@
 #pragma once
+#include "Assert.h"
+#include "Log.h"
+#include "ChunkedArena.h"
 
 #include <utility>
 #include <vector>
 #include <array>
 #include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdlib>
+#include <memory>
 
-enum class RenderBufferQueue
-{
-    First,
-    Second
-};
+// maximum number of threads that can collect render commands at the same time
+static constexpr uint32_t MaxCollectingThreads = 16;
 
 class RenderCommandQueue
 {
@@ -18,134 +22,392 @@ class RenderCommandQueue
 public:
     virtual ~RenderCommandQueue() = default;
 
+    // every thread gets its own collecting slot on first use, so collecting needs no synchronisation
+    // the slot is given back when the thread exits, so recreated worker threads reuse the slots of the old ones.
+    // More than MaxCollectingThreads threads collecting at the same time aborts, also without asserts.
+    static uint32_t get_thread_slot();
+
+    // gives the slot of the calling thread back before it exits, the thread must not collect into the current frame afterwards
+    static void release_thread_slot();
+
 protected:
-    virtual void on_submit() = 0;
+    // finishes collecting into the current frame slot and continues collecting into nextSlot
+    virtual void on_submit( uint32_t nextSlot ) = 0;
+    // selects the frame slot that gets dispatched by the render thread
+    virtual void on_dispatch( uint32_t slot ) = 0;
+    // the dispatched frame slot is done and can be collected into again
+    virtual void on_dispatch_finished() = 0;
+
+private:
+    static constexpr uint32_t NoThreadSlot = ~0u;
+    static_assert( MaxCollectingThreads <= 32 );
+
+    // releases the slot when the thread exits
+    struct ThreadSlot
+    {
+        uint32_t Index = NoThreadSlot;
+
+        ~ThreadSlot() { release(); }
+        void release();
+    };
+
+    static std::atomic<uint32_t>& get_used_slots();    // one bit per taken slot
+    static ThreadSlot&            get_thread_slot_holder();
 };
 
+inline std::atomic<uint32_t>& RenderCommandQueue::get_used_slots()
+{
+    static std::atomic<uint32_t> usedSlots = 0;
+    return usedSlots;
+}
+
+inline RenderCommandQueue::ThreadSlot& RenderCommandQueue::get_thread_slot_holder()
+{
+    thread_local ThreadSlot slot;
+    return slot;
+}
+
+inline uint32_t RenderCommandQueue::get_thread_slot()
+{
+    ThreadSlot& slot = get_thread_slot_holder();
+    if ( slot.Index != NoThreadSlot )
+        return slot.Index;
+
+    // takes the lowest free bit, the queues are indexed by it without any further check
+    std::atomic<uint32_t>& usedSlots = get_used_slots();
+    uint32_t               used      = usedSlots.load( std::memory_order_relaxed );
+    while ( true ) {
+        uint32_t index = static_cast<uint32_t>( std::countr_one( used ) );
+        if ( index >= MaxCollectingThreads ) {
+            IE_LOG_CRITICAL( "More than %u threads collect render commands at the same time!", MaxCollectingThreads );
+            std::abort();
+        }
+
+        if ( usedSlots.compare_exchange_weak( used, used | ( 1u << index ), std::memory_order_acquire, std::memory_order_relaxed ) ) {
+            slot.Index = index;
+            return index;
+        }
+    }
+}
+
+inline void RenderCommandQueue::release_thread_slot()
+{
+    get_thread_slot_holder().release();
+}
+
+inline void RenderCommandQueue::ThreadSlot::release()
+{
+    if ( Index == NoThreadSlot )
+        return;
+
+    // what the thread collected has to be visible to the next thread taking the slot
+    get_used_slots().fetch_and( ~( 1u << Index ), std::memory_order_release );
+    Index = NoThreadSlot;
+}
+
+// Keeps one command storage per frame in flight, the GPURenderer decides which slot gets collected and dispatched.
+// Every slot collects into one queue per thread.
+// The queues are chunked arenas, so entries never move while collecting and no allocations happen in the steady state.
+// create_entry() may be called concurrently from different threads,
+// on_submit() must only be called once all collecting threads are done with the frame.
+// It concatenates the per thread queues into the pointer list that gets sorted and dispatched.
 template <typename T>
-class DoubleBufferedCommandQueue : public RenderCommandQueue
+class MultiBufferedCommandQueue : public RenderCommandQueue
 {
 public:
-    DoubleBufferedCommandQueue( size_t expectedQueueSize = 1000 );
-    virtual ~DoubleBufferedCommandQueue() = default;
+    MultiBufferedCommandQueue( uint32_t frameSlots, uint32_t collectingSlot, size_t expectedQueueSize = 1000 );
+    virtual ~MultiBufferedCommandQueue() = default;
 
     const std::vector<T*>& get_rendercommands();
 
     [[nodiscard]]
     T*   create_entry();
-    void grow_if_needed();
     void sort( bool ( *compare )( const T*, const T* ) );
 
 private:
-    // Geerbt ber RenderCommandQueue
-    void on_submit() override;
-    void switch_buffers();
+    using ThreadQueues = std::array<ChunkedArena<T>, MaxCollectingThreads>;
+
+    struct FrameSlot
+    {
+        ThreadQueues    Queues;
+        std::vector<T*> Commands;
+    };
 
-    std::vector<T>&  get_collecting_queue();
-    std::vector<T*>& get_collecting_ptrqueue();
+    // Geerbt ber RenderCommandQueue
+    void on_submit( uint32_t nextSlot ) override;
+    void on_dispatch( uint32_t slot ) override;
+    void on_dispatch_finished() override;
 
-    const std::vector<T>& get_dispatching_queue();
-    std::vector<T*>&      get_dispatching_ptrqueue();
+    ChunkedArena<T>& get_collecting_queue();
 
 private:
-    RenderBufferQueue m_collectingQueue = RenderBufferQueue::First;
-    std::vector<T>    m_firstQueue;
-    std::vector<T>    m_secondQueue;
-
-    std::vector<T*> m_firstQueueSorted;
-    std::vector<T*> m_secondQueueSorted;
+    std::vector<std::unique_ptr<FrameSlot>> m_slots;
+    uint32_t                                m_collectingSlot  = 0;    // only used by the collecting threads
+    uint32_t                                m_dispatchingSlot = 0;    // only used by the render thread
 };
 
 template <typename T>
-inline DoubleBufferedCommandQueue<T>::DoubleBufferedCommandQueue( size_t expectedQueueSize )
+inline MultiBufferedCommandQueue<T>::MultiBufferedCommandQueue( uint32_t frameSlots, uint32_t collectingSlot, size_t expectedQueueSize ) :
+    m_collectingSlot( collectingSlot )
 {
-    m_firstQueue.reserve( expectedQueueSize );
-    m_secondQueue.reserve( expectedQueueSize );
+    IE_ASSERT( collectingSlot < frameSlots );
 
-    m_firstQueueSorted.reserve( expectedQueueSize );
-    m_secondQueueSorted.reserve( expectedQueueSize );
+    // the per thread queues allocate their chunks on first use
+    for ( uint32_t i = 0; i < frameSlots; ++i ) {
+        auto& slot = m_slots.emplace_back( std::make_unique<FrameSlot>() );
+        slot->Commands.reserve( expectedQueueSize );
+    }
 }
 
 template <typename T>
-inline std::vector<T>& DoubleBufferedCommandQueue<T>::get_collecting_queue()
+inline ChunkedArena<T>& MultiBufferedCommandQueue<T>::get_collecting_queue()
 {
-    return ( m_collectingQueue == RenderBufferQueue::First ) ? m_firstQueue : m_secondQueue;
+    return m_slots[m_collectingSlot]->Queues[get_thread_slot()];
 }
 
 template <typename T>
-inline void DoubleBufferedCommandQueue<T>::on_submit()
+inline void MultiBufferedCommandQueue<T>::on_submit( uint32_t nextSlot )
 {
-    size_t items = get_collecting_queue().size();
-    if ( items != 0 ) {
-        switch_buffers();
+    IE_ASSERT( nextSlot < m_slots.size() );
+    FrameSlot& slot = *m_slots[m_collectingSlot];
 
-        // clear to get ready for collecting next frames commands
-        auto& collectQueue = get_collecting_queue();
-        collectQueue.clear();
-        collectQueue.reserve( items );
+    size_t items = 0;
+    for ( const auto& queue : slot.Queues )
+        items += queue.size();
 
-        auto& collectQueueSorted = get_collecting_ptrqueue();
-        collectQueueSorted.clear();
-        collectQueueSorted.reserve( items );
-    }
+    // the pointers are only taken here, after collecting is done, so they stay valid until the slot gets dispatched
+    slot.Commands.clear();
+    slot.Commands.reserve( items );
+    for ( auto& queue : slot.Queues )
+        queue.for_each( [&slot]( T& cmd ) { slot.Commands.push_back( &cmd ); } );
+
+    m_collectingSlot = nextSlot;
+}
+
+template <typename T>
+inline void MultiBufferedCommandQueue<T>::on_dispatch( uint32_t slot )
+{
+    IE_ASSERT( slot < m_slots.size() );
+    m_dispatchingSlot = slot;
+}
+
+template <typename T>
+inline void MultiBufferedCommandQueue<T>::on_dispatch_finished()
+{
+    // clear to get ready for collecting commands into this slot again
+    FrameSlot& slot = *m_slots[m_dispatchingSlot];
+    for ( auto& queue : slot.Queues )
+        queue.reset();
+    slot.Commands.clear();
+}
+
+template <typename T>
+const inline std::vector<T*>& MultiBufferedCommandQueue<T>::get_rendercommands()
+{
+    return m_slots[m_dispatchingSlot]->Commands;
 }
 
 template <typename T>
-inline void DoubleBufferedCommandQueue<T>::switch_buffers()
+inline T* MultiBufferedCommandQueue<T>::create_entry()
 {
-    m_collectingQueue = ( m_collectingQueue == RenderBufferQueue::First ) ? RenderBufferQueue::Second : RenderBufferQueue::First;
+    return get_collecting_queue().create();
 }
 
 template <typename T>
-const inline std::vector<T>& DoubleBufferedCommandQueue<T>::get_dispatching_queue()
+inline void MultiBufferedCommandQueue<T>::sort( bool ( *compare )( const T*, const T* ) )
 {
-    return ( m_collectingQueue == RenderBufferQueue::First ) ? m_secondQueue : m_firstQueue;
+    std::vector<T*>& dispatchqueue = m_slots[m_dispatchingSlot]->Commands;
+    std::sort( dispatchqueue.begin(), dispatchqueue.end(), compare );
 }
 
+// Like MultiBufferedCommandQueue, but every entry is collected into a bucket of ( layer, key ), the key is a small dense
+// integer like the uid of a texture. on_submit() concatenates the buckets ordered by layer and then key,
+// so the dispatched commands come out in drawing order and only the few buckets of a frame get sorted, never the entries.
+template <typename T>
+class BucketedCommandQueue : public RenderCommandQueue
+{
+public:
+    struct BucketRange
+    {
+        uint16_t Layer = 0;
+        uint32_t Key   = 0;
+        uint32_t First = 0;    // index into get_rendercommands()
+        uint32_t Count = 0;
+    };
+
+    BucketedCommandQueue( uint32_t frameSlots, uint32_t collectingSlot, size_t expectedQueueSize = 1000 );
+    virtual ~BucketedCommandQueue() = default;
+
+    const std::vector<T*>&          get_rendercommands();
+    const std::vector<BucketRange>& get_buckets();
+
+    [[nodiscard]]
+    T* create_entry( uint16_t layer, uint32_t key );
+    // general path for commands that can not be ordered by their bucket, get_buckets() is empty afterwards
+    void sort( bool ( *compare )( const T*, const T* ) );
+
+private:
+    struct Bucket
+    {
+        uint16_t        Layer = 0;
+        uint32_t        Key   = 0;
+        std::vector<T*> Entries;
+    };
+
+    // buckets of one collecting thread, they are kept over the frames so the steady state does not allocate
+    struct ThreadBuckets
+    {
+        ChunkedArena<T>                   Storage;
+        std::vector<Bucket>               Buckets;
+        std::vector<uint16_t>             Layers;         // layers seen so far, there are only a few
+        std::vector<std::vector<int32_t>> BucketIndex;    // per entry of Layers the bucket of every key, -1 if there is none
+    };
+
+    struct FrameSlot
+    {
+        std::array<ThreadBuckets, MaxCollectingThreads> Threads;
+        std::vector<T*>                                 Commands;
+        std::vector<BucketRange>                        Buckets;
+        std::vector<Bucket*>                            Order;    // scratch for on_submit()
+    };
+
+    // Geerbt ber RenderCommandQueue
+    void on_submit( uint32_t nextSlot ) override;
+    void on_dispatch( uint32_t slot ) override;
+    void on_dispatch_finished() override;
+
+    Bucket& find_bucket( ThreadBuckets& thread, uint16_t layer, uint32_t key );
+
+private:
+    std::vector<std::unique_ptr<FrameSlot>> m_slots;
+    uint32_t                                m_collectingSlot  = 0;    // only used by the collecting threads
+    uint32_t                                m_dispatchingSlot = 0;    // only used by the render thread
+};
+
 template <typename T>
-std::vector<T*>& DoubleBufferedCommandQueue<T>::get_collecting_ptrqueue()
+inline BucketedCommandQueue<T>::BucketedCommandQueue( uint32_t frameSlots, uint32_t collectingSlot, size_t expectedQueueSize ) :
+    m_collectingSlot( collectingSlot )
 {
-    return ( m_collectingQueue == RenderBufferQueue::First ) ? m_firstQueueSorted : m_secondQueueSorted;
+    IE_ASSERT( collectingSlot < frameSlots );
+
+    for ( uint32_t i = 0; i < frameSlots; ++i ) {
+        auto& slot = m_slots.emplace_back( std::make_unique<FrameSlot>() );
+        slot->Commands.reserve( expectedQueueSize );
+    }
 }
 
 template <typename T>
-inline std::vector<T*>& DoubleBufferedCommandQueue<T>::get_dispatching_ptrqueue()
+inline typename BucketedCommandQueue<T>::Bucket& BucketedCommandQueue<T>::find_bucket( ThreadBuckets& thread, uint16_t layer, uint32_t key )
 {
-    return ( m_collectingQueue == RenderBufferQueue::First ) ? m_secondQueueSorted : m_firstQueueSorted;
+    size_t layerIdx = std::find( thread.Layers.begin(), thread.Layers.end(), layer ) - thread.Layers.begin();
+    if ( layerIdx == thread.Layers.size() ) {
+        thread.Layers.push_back( layer );
+        thread.BucketIndex.emplace_back();
+    }
+
+    std::vector<int32_t>& index = thread.BucketIndex[layerIdx];
+    if ( key >= index.size() )
+        index.resize( key + 1, -1 );
+
+    if ( index[key] < 0 ) {
+        index[key]     = static_cast<int32_t>( thread.Buckets.size() );
+        Bucket& bucket = thread.Buckets.emplace_back();
+        bucket.Layer   = layer;
+        bucket.Key     = key;
+    }
+    return thread.Buckets[index[key]];
 }
 
 template <typename T>
-const inline std::vector<T*>& DoubleBufferedCommandQueue<T>::get_rendercommands()
+inline T* BucketedCommandQueue<T>::create_entry( uint16_t layer, uint32_t key )
 {
-    return get_dispatching_ptrqueue();
+    ThreadBuckets& thread = m_slots[m_collectingSlot]->Threads[get_thread_slot()];
+    T*             entry  = thread.Storage.create();
+    find_bucket( thread, layer, key ).Entries.push_back( entry );
+    return entry;
 }
 
 template <typename T>
-inline T* DoubleBufferedCommandQueue<T>::create_entry()
+inline void BucketedCommandQueue<T>::on_submit( uint32_t nextSlot )
 {
-    auto&  ccmd   = get_collecting_queue();
-    size_t newIdx = ccmd.size();
-    ccmd.emplace_back( T {} );
+    IE_ASSERT( nextSlot < m_slots.size() );
+    FrameSlot& slot = *m_slots[m_collectingSlot];
+
+    size_t items = 0;
+    slot.Order.clear();
+    for ( auto& thread : slot.Threads ) {
+        for ( Bucket& bucket : thread.Buckets ) {
+            if ( bucket.Entries.empty() )
+                continue;
+
+            items += bucket.Entries.size();
+            slot.Order.push_back( &bucket );
+        }
+    }
+
+    // the threads are visited in order, a stable sort keeps their entries of the same bucket in that order
+    std::stable_sort( slot.Order.begin(), slot.Order.end(), []( const Bucket* a, const Bucket* b ) {
+        if ( a->Layer != b->Layer )
+            return a->Layer < b->Layer;
 
-    auto& ccmds  = get_collecting_ptrqueue();
-    auto  cmdPtr = &ccmd[newIdx];
-    ccmds.emplace_back( cmdPtr );
-    return cmdPtr;
+        return a->Key < b->Key;
+    } );
+
+    slot.Commands.clear();
+    slot.Commands.reserve( items );
+    slot.Buckets.clear();
+    for ( const Bucket* bucket : slot.Order ) {
+        if ( slot.Buckets.empty() || slot.Buckets.back().Layer != bucket->Layer || slot.Buckets.back().Key != bucket->Key ) {
+            BucketRange& range = slot.Buckets.emplace_back();
+            range.Layer        = bucket->Layer;
+            range.Key          = bucket->Key;
+            range.First        = static_cast<uint32_t>( slot.Commands.size() );
+        }
+
+        slot.Buckets.back().Count += static_cast<uint32_t>( bucket->Entries.size() );
+        slot.Commands.insert( slot.Commands.end(), bucket->Entries.begin(), bucket->Entries.end() );
+    }
+
+    m_collectingSlot = nextSlot;
 }
 
 template <typename T>
-inline void DoubleBufferedCommandQueue<T>::grow_if_needed()
+inline void BucketedCommandQueue<T>::on_dispatch( uint32_t slot )
 {
-    auto& ccmd = get_collecting_queue();
-    if ( ccmd.size() == ccmd.capacity() ) {
-        // Grow by a factor of 2.
-        ccmd.reserve( ccmd.capacity() * 2 );
+    IE_ASSERT( slot < m_slots.size() );
+    m_dispatchingSlot = slot;
+}
+
+template <typename T>
+inline void BucketedCommandQueue<T>::on_dispatch_finished()
+{
+    // the buckets stay, only their entries are cleared
+    FrameSlot& slot = *m_slots[m_dispatchingSlot];
+    for ( auto& thread : slot.Threads ) {
+        thread.Storage.reset();
+        for ( Bucket& bucket : thread.Buckets )
+            bucket.Entries.clear();
     }
+    slot.Commands.clear();
+    slot.Buckets.clear();
 }
 
 template <typename T>
-inline void DoubleBufferedCommandQueue<T>::sort( bool ( *compare )( const T*, const T* ) )
+const inline std::vector<T*>& BucketedCommandQueue<T>::get_rendercommands()
 {
-    std::vector<T*>& dispatchqueue = get_dispatching_ptrqueue();
-    std::sort( dispatchqueue.begin(), dispatchqueue.end(), compare );
+    return m_slots[m_dispatchingSlot]->Commands;
+}
+
+template <typename T>
+const inline std::vector<typename BucketedCommandQueue<T>::BucketRange>& BucketedCommandQueue<T>::get_buckets()
+{
+    return m_slots[m_dispatchingSlot]->Buckets;
+}
+
+template <typename T>
+inline void BucketedCommandQueue<T>::sort( bool ( *compare )( const T*, const T* ) )
+{
+    FrameSlot& slot = *m_slots[m_dispatchingSlot];
+    std::sort( slot.Commands.begin(), slot.Commands.end(), compare );
+    slot.Buckets.clear();
 }
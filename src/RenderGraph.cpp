@@ -0,0 +1,348 @@
+#include "iepch.h"
+#include "RenderGraph.h"
+
+#include "GPUBackend.h"
+
+RenderGraph::RenderGraph()
+{
+    RenderResourceID swapchain = declare_resource( "Swapchain", RenderResourceType::Texture );
+    IE_ASSERT( swapchain == Swapchain );
+    mark_output( swapchain );
+}
+
+RenderResourceID RenderGraph::declare_resource( std::string_view name, RenderResourceType type )
+{
+    auto it = m_resourceLookup.find( std::string( name ) );
+    if ( it != m_resourceLookup.end() ) {
+        IE_ASSERT( m_resources[it->second].Type == type );
+        return it->second;
+    }
+
+    RenderResourceID id = static_cast<RenderResourceID>( m_resources.size() );
+    Resource&        res = m_resources.emplace_back();
+    res.Name             = name;
+    res.Type             = type;
+    m_resourceLookup.emplace( res.Name, id );
+    return id;
+}
+
+void RenderGraph::import_texture( RenderResourceID id, TextureAcquireFunc acquire, SDL_FColor clearColor )
+{
+    IE_ASSERT( id < m_resources.size() && m_resources[id].Type == RenderResourceType::Texture );
+    m_resources[id].Acquire    = std::move( acquire );
+    m_resources[id].ClearColor = clearColor;
+}
+
+void RenderGraph::attach_depth( RenderResourceID id, TextureAcquireFunc acquire )
+{
+    IE_ASSERT( id < m_resources.size() && m_resources[id].Type == RenderResourceType::Texture );
+    m_resources[id].DepthAcquire = std::move( acquire );
+}
+
+void RenderGraph::set_viewport( RenderResourceID id, const SDL_GPUViewport& viewport )
+{
+    IE_ASSERT( id < m_resources.size() && m_resources[id].Type == RenderResourceType::Texture );
+    m_resources[id].Viewport = viewport;
+}
+
+SDL_GPUViewport RenderGraph::get_viewport( RenderResourceID id ) const
+{
+    IE_ASSERT( id < m_resources.size() && m_resources[id].Type == RenderResourceType::Texture );
+    return m_resources[id].Viewport;
+}
+
+void RenderGraph::mark_output( RenderResourceID id )
+{
+    IE_ASSERT( id < m_resources.size() );
+    m_resources[id].Output = true;
+}
+
+void RenderGraph::add_pass( RenderPassType type, std::string_view name, std::initializer_list<RenderResourceID> reads, std::initializer_list<RenderResourceID> writes, RenderPassFunc execute )
+{
+    Pass& pass   = m_passes.emplace_back();
+    pass.Type    = type;
+    pass.Name    = name;
+    pass.Reads   = reads;
+    pass.Writes  = writes;
+    pass.Execute = std::move( execute );
+
+    if ( type == RenderPassType::Render ) {
+        for ( RenderResourceID id : pass.Writes ) {
+            IE_ASSERT( id < m_resources.size() );
+            if ( m_resources[id].Type == RenderResourceType::Texture ) {
+                pass.Target = id;
+                break;
+            }
+        }
+        IE_ASSERT( pass.Target != InvalidRenderResource );
+    }
+}
+
+void RenderGraph::add_copypass( std::string_view name, std::initializer_list<RenderResourceID> reads, std::initializer_list<RenderResourceID> writes, RenderPassFunc execute )
+{
+    add_pass( RenderPassType::Copy, name, reads, writes, std::move( execute ) );
+}
+
+void RenderGraph::add_renderpass( std::string_view name, std::initializer_list<RenderResourceID> reads, RenderResourceID target, RenderPassFunc execute )
+{
+    add_pass( RenderPassType::Render, name, reads, { target }, std::move( execute ) );
+}
+
+bool RenderGraph::empty() const
+{
+    return m_passes.empty();
+}
+
+void RenderGraph::execute( GPUBackend& backend, SDL_GPUCommandBuffer* cmdbuf, const DXSM::Matrix& viewProjection )
+{
+    IE_ASSERT( cmdbuf != nullptr );
+
+    m_stats                = {};
+    m_stats.DeclaredPasses = static_cast<uint32_t>( m_passes.size() );
+
+    build_dependencies();
+    sort_passes();
+    cull_passes();
+    record_passes( backend, cmdbuf, viewProjection );
+    clear();
+}
+
+void RenderGraph::clear()
+{
+    m_passes.clear();
+    m_order.clear();
+
+    for ( Resource& res : m_resources ) {
+        if ( res.Acquire )
+            res.Texture = nullptr;
+        res.DepthTexture = nullptr;
+        res.Acquired     = false;
+        res.Cleared      = false;
+        res.DepthCleared = false;
+    }
+}
+
+const RenderGraphStats& RenderGraph::get_stats() const
+{
+    return m_stats;
+}
+
+void RenderGraph::build_dependencies()
+{
+    // declaration order decides the order of accesses to the same resource
+    std::vector<uint32_t>              lastWriter( m_resources.size(), std::numeric_limits<uint32_t>::max() );
+    std::vector<std::vector<uint32_t>> readersSinceWrite( m_resources.size() );
+
+    for ( uint32_t passIdx = 0; passIdx < m_passes.size(); ++passIdx ) {
+        Pass& pass = m_passes[passIdx];
+
+        // read after write
+        for ( RenderResourceID id : pass.Reads ) {
+            IE_ASSERT( id < m_resources.size() );
+            if ( lastWriter[id] != std::numeric_limits<uint32_t>::max() )
+                add_dependency( lastWriter[id], passIdx );
+            readersSinceWrite[id].push_back( passIdx );
+        }
+
+        // write after write and write after read
+        for ( RenderResourceID id : pass.Writes ) {
+            IE_ASSERT( id < m_resources.size() );
+            if ( lastWriter[id] != std::numeric_limits<uint32_t>::max() )
+                add_dependency( lastWriter[id], passIdx );
+            for ( uint32_t reader : readersSinceWrite[id] )
+                add_dependency( reader, passIdx );
+
+            lastWriter[id] = passIdx;
+            readersSinceWrite[id].clear();
+        }
+    }
+}
+
+void RenderGraph::add_dependency( uint32_t from, uint32_t to )
+{
+    if ( from == to )
+        return;
+
+    std::vector<uint32_t>& successors = m_passes[from].Successors;
+    if ( std::find( successors.begin(), successors.end(), to ) != successors.end() )
+        return;
+
+    successors.push_back( to );
+    m_passes[to].Dependencies++;
+}
+
+void RenderGraph::sort_passes()
+{
+    // Kahn's algorithm, among the ready passes the one that continues the current SDL pass is preferred
+    // so copy passes get grouped together and render passes into the same target stay together
+    std::vector<uint32_t> ready;
+    for ( uint32_t passIdx = 0; passIdx < m_passes.size(); ++passIdx ) {
+        if ( m_passes[passIdx].Dependencies == 0 )
+            ready.push_back( passIdx );
+    }
+
+    m_order.reserve( m_passes.size() );
+    const Pass* previous = nullptr;
+    while ( ready.empty() == false ) {
+        size_t best      = 0;
+        bool   bestMerge = false;
+        for ( size_t i = 0; i < ready.size(); ++i ) {
+            const Pass& candidate = m_passes[ready[i]];
+            bool        merges    = previous && previous->Type == candidate.Type && previous->Target == candidate.Target;
+
+            // ready holds the declaration order, so the first match wins
+            if ( merges && bestMerge == false ) {
+                best      = i;
+                bestMerge = true;
+            }
+        }
+
+        uint32_t passIdx = ready[best];
+        ready.erase( ready.begin() + best );
+        m_order.push_back( passIdx );
+        previous = &m_passes[passIdx];
+
+        for ( uint32_t successor : m_passes[passIdx].Successors ) {
+            if ( --m_passes[successor].Dependencies == 0 )
+                ready.insert( std::upper_bound( ready.begin(), ready.end(), successor ), successor );
+        }
+    }
+
+    IE_ASSERT( m_order.size() == m_passes.size() );    // the dependencies are built from the declaration order, there can be no cycle
+}
+
+void RenderGraph::cull_passes()
+{
+    // walk backwards from the outputs, a pass stays alive when something alive reads what it writes
+    std::vector<bool> needed( m_resources.size(), false );
+    for ( RenderResourceID id = 0; id < m_resources.size(); ++id )
+        needed[id] = m_resources[id].Output;
+
+    for ( auto it = m_order.rbegin(); it != m_order.rend(); ++it ) {
+        Pass& pass = m_passes[*it];
+        for ( RenderResourceID id : pass.Writes ) {
+            if ( needed[id] ) {
+                pass.Alive = true;
+                break;
+            }
+        }
+
+        if ( pass.Alive == false ) {
+            m_stats.CulledPasses++;
+            continue;
+        }
+
+        for ( RenderResourceID id : pass.Reads )
+            needed[id] = true;
+    }
+}
+
+void RenderGraph::record_passes( GPUBackend& backend, SDL_GPUCommandBuffer* cmdbuf, const DXSM::Matrix& viewProjection )
+{
+    RenderPassContext context;
+    context.Graph          = this;
+    context.Backend        = &backend;
+    context.CommandBuffer  = cmdbuf;
+    context.ViewProjection = &viewProjection;
+
+    m_recordingCmdbuf = cmdbuf;
+
+    const Pass* openPass = nullptr;
+    auto        end_open = [&]() {
+        if ( context.CopyPass ) {
+            backend.end_copypass( context.CopyPass );
+            context.CopyPass = nullptr;
+        }
+        if ( context.RenderPass ) {
+            backend.end_renderpass( context.RenderPass );
+            context.RenderPass = nullptr;
+        }
+        openPass = nullptr;
+    };
+
+    for ( uint32_t passIdx : m_order ) {
+        const Pass& pass = m_passes[passIdx];
+        if ( pass.Alive == false )
+            continue;
+
+        bool merges = openPass && openPass->Type == pass.Type && openPass->Target == pass.Target;
+        if ( merges == false ) {
+            end_open();
+
+            switch ( pass.Type ) {
+            case RenderPassType::Copy:
+                context.CopyPass = backend.begin_copypass( cmdbuf );
+                m_stats.GPUPasses++;
+                break;
+            case RenderPassType::Compute:
+            case RenderPassType::Blit:
+                break;
+            case RenderPassType::Render: {
+                Resource&       target  = m_resources[pass.Target];
+                SDL_GPUTexture* texture = resolve_texture( target, cmdbuf );
+                if ( texture == nullptr )
+                    continue;    // e.g. no swapchain texture while the window is minimized
+
+                SDL_GPUColorTargetInfo colorTargetInfo = {};
+                colorTargetInfo.texture                = texture;
+                colorTargetInfo.clear_color            = target.ClearColor;
+                colorTargetInfo.load_op                = target.Cleared ? SDL_GPU_LOADOP_LOAD : SDL_GPU_LOADOP_CLEAR;
+                colorTargetInfo.store_op               = SDL_GPU_STOREOP_STORE;
+                target.Cleared                         = true;
+
+                // the depth only orders the passes of one frame, it does not need to survive it
+                SDL_GPUDepthStencilTargetInfo depthTargetInfo = {};
+                if ( target.DepthAcquire && target.DepthTexture == nullptr )
+                    target.DepthTexture = target.DepthAcquire( cmdbuf );
+                if ( target.DepthTexture ) {
+                    depthTargetInfo.texture          = target.DepthTexture;
+                    depthTargetInfo.clear_depth      = 1.0f;
+                    depthTargetInfo.load_op          = target.DepthCleared ? SDL_GPU_LOADOP_LOAD : SDL_GPU_LOADOP_CLEAR;
+                    depthTargetInfo.store_op         = SDL_GPU_STOREOP_STORE;
+                    depthTargetInfo.stencil_load_op  = SDL_GPU_LOADOP_DONT_CARE;
+                    depthTargetInfo.stencil_store_op = SDL_GPU_STOREOP_DONT_CARE;
+                    target.DepthCleared              = true;
+                }
+
+                context.RenderPass = backend.begin_renderpass( cmdbuf, &colorTargetInfo, 1, target.DepthTexture ? &depthTargetInfo : nullptr );
+                if ( context.RenderPass && target.Viewport.w > 0.0f && target.Viewport.h > 0.0f )
+                    backend.set_viewport( context.RenderPass, &target.Viewport );
+                m_stats.GPUPasses++;
+                break;
+            }
+            }
+            openPass = &pass;
+        }
+
+        uint64_t executeStart = SDL_GetTicksNS();
+        pass.Execute( context );
+        if ( pass.Type == RenderPassType::Copy )
+            m_stats.CopyTime += SDL_GetTicksNS() - executeStart;
+        else if ( pass.Type == RenderPassType::Render )
+            m_stats.RenderTime += SDL_GetTicksNS() - executeStart;
+
+        // blits and compute passes write whole textures, later render passes have to keep that content
+        if ( pass.Type != RenderPassType::Render ) {
+            for ( RenderResourceID id : pass.Writes )
+                m_resources[id].Cleared = true;
+        }
+    }
+    end_open();
+    m_recordingCmdbuf = nullptr;
+}
+
+SDL_GPUTexture* RenderGraph::get_texture( RenderResourceID id )
+{
+    IE_ASSERT( m_recordingCmdbuf != nullptr );
+    IE_ASSERT( id < m_resources.size() && m_resources[id].Type == RenderResourceType::Texture );
+    return resolve_texture( m_resources[id], m_recordingCmdbuf );
+}
+
+SDL_GPUTexture* RenderGraph::resolve_texture( Resource& resource, SDL_GPUCommandBuffer* cmdbuf )
+{
+    if ( resource.Acquire && resource.Acquired == false ) {
+        resource.Texture  = resource.Acquire( cmdbuf );
+        resource.Acquired = true;
+    }
+    return resource.Texture;
+}
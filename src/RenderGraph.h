@@ -0,0 +1,158 @@
+#pragma once
+#include "SDL3/SDL_gpu.h"
+
+#include "SimpleMath.h"
+namespace DXSM = DirectX::SimpleMath;
+
+#include <functional>
+#include <initializer_list>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+class GPUBackend;
+class RenderGraph;
+
+using RenderResourceID = uint32_t;
+
+static constexpr RenderResourceID InvalidRenderResource = std::numeric_limits<RenderResourceID>::max();
+
+enum class RenderPassType
+{
+    Copy = 0,
+    Compute,
+    Render,
+    Blit    // SDL_BlitGPUTexture, recorded outside of any pass
+};
+
+enum class RenderResourceType
+{
+    Buffer = 0,
+    Texture
+};
+
+// everything a pass callback needs to record its commands
+// only the gpu pass matching the pass type is set, compute passes have to begin their own SDL compute pass
+// because the storage bindings are part of SDL_BeginGPUComputePass
+struct RenderPassContext
+{
+    RenderGraph*          Graph          = nullptr;
+    GPUBackend*           Backend        = nullptr;
+    SDL_GPUCommandBuffer* CommandBuffer  = nullptr;
+    SDL_GPUCopyPass*      CopyPass       = nullptr;
+    SDL_GPURenderPass*    RenderPass     = nullptr;
+    const DXSM::Matrix*   ViewProjection = nullptr;
+};
+
+struct RenderGraphStats
+{
+    uint32_t DeclaredPasses = 0;
+    uint32_t CulledPasses   = 0;
+    uint32_t GPUPasses      = 0;    // SDL copy/render passes that were actually begun after merging
+    uint64_t CopyTime       = 0;    // ns spent in the callbacks of the copy passes
+    uint64_t RenderTime     = 0;    // ns spent in the callbacks of the render passes
+};
+
+using RenderPassFunc     = std::function<void( RenderPassContext& context )>;
+using TextureAcquireFunc = std::function<SDL_GPUTexture*( SDL_GPUCommandBuffer* cmdbuf )>;
+
+// Small per frame render graph, only used by the render thread.
+// Resources are registered once and stay valid, passes are declared again every frame.
+// On execute the passes get ordered by their resource dependencies, passes whose results nobody reads are culled
+// and consecutive passes of the same type (and the same color target) are merged into a single SDL pass.
+// Everything is recorded into the one commandbuffer that is passed in.
+class RenderGraph
+{
+public:
+    // the swapchain is always resource 0, it is an output of the graph
+    static constexpr RenderResourceID Swapchain = 0;
+
+    RenderGraph();
+
+    // returns the existing resource when the name is already known
+    RenderResourceID declare_resource( std::string_view name, RenderResourceType type = RenderResourceType::Buffer );
+
+    // texture that is not owned by the graph, acquire is called once per frame when the first pass renders into it
+    void import_texture( RenderResourceID id, TextureAcquireFunc acquire, SDL_FColor clearColor );
+
+    // render passes into the texture get a depth attachment, it is cleared to 1 by the first pass of the frame
+    // acquire has to return a depth texture of the same size as the color texture
+    void attach_depth( RenderResourceID id, TextureAcquireFunc acquire );
+
+    // render passes into the texture only draw into the viewport, an empty one covers the whole texture
+    void            set_viewport( RenderResourceID id, const SDL_GPUViewport& viewport );
+    SDL_GPUViewport get_viewport( RenderResourceID id ) const;
+
+    // passes writing into an output resource are never culled
+    void mark_output( RenderResourceID id );
+
+    // render passes render into the first texture resource in writes
+    void add_pass( RenderPassType type, std::string_view name, std::initializer_list<RenderResourceID> reads, std::initializer_list<RenderResourceID> writes, RenderPassFunc execute );
+    void add_copypass( std::string_view name, std::initializer_list<RenderResourceID> reads, std::initializer_list<RenderResourceID> writes, RenderPassFunc execute );
+    void add_renderpass( std::string_view name, std::initializer_list<RenderResourceID> reads, RenderResourceID target, RenderPassFunc execute );
+
+    bool empty() const;
+
+    // orders, culls and records all declared passes, the passes are cleared afterwards
+    void execute( GPUBackend& backend, SDL_GPUCommandBuffer* cmdbuf, const DXSM::Matrix& viewProjection );
+
+    // drops the declared passes without recording them
+    void clear();
+
+    // only valid inside a pass callback, acquires imported textures on first use
+    SDL_GPUTexture* get_texture( RenderResourceID id );
+
+    const RenderGraphStats& get_stats() const;
+
+private:
+    struct Resource
+    {
+        std::string        Name;
+        RenderResourceType Type   = RenderResourceType::Buffer;
+        bool               Output = false;
+        TextureAcquireFunc Acquire;
+        TextureAcquireFunc DepthAcquire;
+        SDL_FColor         ClearColor = { 0.0f, 0.0f, 0.0f, 1.0f };
+        SDL_GPUViewport    Viewport   = {};
+
+        // per frame state
+        SDL_GPUTexture* Texture      = nullptr;
+        SDL_GPUTexture* DepthTexture = nullptr;
+        bool            Acquired     = false;
+        bool            Cleared      = false;
+        bool            DepthCleared = false;
+    };
+
+    struct Pass
+    {
+        RenderPassType                Type = RenderPassType::Copy;
+        std::string                   Name;    // owned, names built at runtime would dangle until execute()
+        std::vector<RenderResourceID> Reads;
+        std::vector<RenderResourceID> Writes;
+        RenderResourceID              Target = InvalidRenderResource;
+        RenderPassFunc                Execute;
+
+        std::vector<uint32_t> Successors;
+        uint32_t              Dependencies = 0;
+        bool                  Alive        = false;
+    };
+
+    void build_dependencies();
+    void sort_passes();
+    void cull_passes();
+    void record_passes( GPUBackend& backend, SDL_GPUCommandBuffer* cmdbuf, const DXSM::Matrix& viewProjection );
+
+    SDL_GPUTexture* resolve_texture( Resource& resource, SDL_GPUCommandBuffer* cmdbuf );
+    void            add_dependency( uint32_t from, uint32_t to );
+
+private:
+    std::vector<Resource>                     m_resources;
+    std::unordered_map<std::string, uint32_t> m_resourceLookup;
+
+    std::vector<Pass>     m_passes;
+    std::vector<uint32_t> m_order;
+    RenderGraphStats      m_stats;
+    SDL_GPUCommandBuffer* m_recordingCmdbuf = nullptr;
+};
@@ -0,0 +1,30 @@
+#pragma once
+#include "SDL3/SDL_gpu.h"
+
+#include "RenderGraph.h"
+
+#include <functional>
+
+// offscreen color target owned by the renderer, pipelines render into it through its graph resource
+struct RenderTarget
+{
+    RenderResourceID     Resource = InvalidRenderResource;
+    SDL_GPUTexture*      Texture  = nullptr;
+    SDL_GPUTextureFormat Format   = SDL_GPU_TEXTUREFORMAT_INVALID;
+    uint32_t             Width    = 0;
+    uint32_t             Height   = 0;
+};
+
+// the pixels are tightly packed and only valid during the callback
+// a failed readback still calls the callback, without pixels
+struct ReadbackResult
+{
+    const Uint8*         Pixels      = nullptr;
+    uint32_t             Size        = 0;
+    uint32_t             Width       = 0;    // of the viewport the frame was rendered into, not of the target
+    uint32_t             Height      = 0;
+    SDL_GPUTextureFormat Format      = SDL_GPU_TEXTUREFORMAT_INVALID;
+    uint64_t             FrameNumber = 0;    // frame the pixels were rendered in
+};
+
+using ReadbackCallback = std::function<void( const ReadbackResult& result )>;
@@ -6,44 +6,63 @@
 #include "Sprite2DPipeline.h"
 #include "Sprite.h"
 #include "Window.h"
+#include "CommandStream.h"
+#include "CommandHash.h"
 
 GPURenderer::~GPURenderer()
 {
     if ( m_multiThreaded )
         renderthread_stop();
 
+    if ( m_backend ) {
+        m_backend->wait_for_idle();
+        for ( FrameData& frame : m_frames ) {
+            if ( frame.Fence ) {
+                m_backend->release_fence( frame.Fence );
+                frame.Fence = nullptr;
+            }
+        }
+
+        m_readbacks.release();
+        m_uploads.release();
+        m_stagingRing.release();
+        release_rendertargets();
+        release_samplers();
+    }
+
     // destory deviceobjects (pipelines etc) before destroyinf gpudevice!
+    m_pipelineOrder.clear();
     m_loadedPipelines.clear();
 
     if ( m_window ) {
-        SDL_ReleaseWindowFromGPUDevice( m_sdlGPUDevice, m_window->get_sdlwindow() );
+        m_backend->release_window( m_window->get_sdlwindow() );
         m_window = nullptr;
     }
 
-    if ( m_sdlGPUDevice ) {
-        SDL_DestroyGPUDevice( m_sdlGPUDevice );
-        m_sdlGPUDevice = nullptr;
-    }
+    m_backend.reset();
 }
 
-std::optional<std::unique_ptr<GPURenderer>> GPURenderer::create( Window* pWindow, bool multiThreaded )
+std::optional<std::unique_ptr<GPURenderer>> GPURenderer::create( Window* pWindow, bool multiThreaded, uint32_t framesInFlight, GPUBackendType backendType )
 {
+    // at least two frames are needed, one that gets collected and one that gets processed
+    IE_ASSERT( framesInFlight >= 2 && framesInFlight <= MaxFramesInFlight );
+
     std::unique_ptr<GPURenderer> renderer( new GPURenderer() );
 
 #ifdef _DEBUG
-    renderer->m_sdlGPUDevice = SDL_CreateGPUDevice( SDL_GPU_SHADERFORMAT_SPIRV | SDL_GPU_SHADERFORMAT_DXIL | SDL_GPU_SHADERFORMAT_MSL, true, nullptr );
+    auto backendOpt = GPUBackend::create( backendType, true );
 #else
-    renderer->m_sdlGPUDevice = SDL_CreateGPUDevice( SDL_GPU_SHADERFORMAT_SPIRV | SDL_GPU_SHADERFORMAT_DXIL | SDL_GPU_SHADERFORMAT_MSL, false, nullptr );
+    auto backendOpt = GPUBackend::create( backendType, false );
 #endif
 
-    if ( renderer->m_sdlGPUDevice == nullptr ) {
-        IE_LOG_CRITICAL( "GPUCreateDevice failed" );
+    if ( backendOpt.has_value() == false ) {
         return std::nullopt;
     }
+    renderer->m_backend = std::move( backendOpt.value() );
 
     renderer->m_window = pWindow;
     if ( renderer->m_window ) {
-        if ( !SDL_ClaimWindowForGPUDevice( renderer->m_sdlGPUDevice, renderer->m_window->get_sdlwindow() ) ) {
+        if ( !renderer->m_backend->claim_window( renderer->m_window->get_sdlwindow() ) ) {
             IE_LOG_CRITICAL( "GPUClaimWindow failed" );
             return std::nullopt;
         }
@@ -51,6 +70,16 @@ std::optional<std::unique_ptr<GPURenderer>> GPURenderer::create( Window* pWindow
 
     renderer->retrieve_shaderformatinfo();
 
+    // the first slot is collected right away, the others are free
+    renderer->m_framesInFlight = framesInFlight;
+    renderer->m_frames.resize( framesInFlight );
+    renderer->m_freeFrames.release( framesInFlight - 1 );
+    renderer->m_readbacks.init( renderer->m_backend.get(), framesInFlight );
+    if ( renderer->m_stagingRing.init( renderer->m_backend.get(), StagingRingSize, framesInFlight ) == false )
+        return std::nullopt;
+    renderer->m_uploads.init( &renderer->m_stagingRing, framesInFlight, UploadBudget );
+    renderer->import_swapchain();
+
     renderer->m_multiThreaded = multiThreaded;
     if ( multiThreaded ) {
         renderer->create_renderthread();
@@ -61,40 +90,115 @@ std::optional<std::unique_ptr<GPURenderer>> GPURenderer::create( Window* pWindow
 
 void GPURenderer::renderthread_run()
 {
-    while ( m_run.load( std::memory_order_relaxed ) ) {
-        {
-            std::unique_lock<std::mutex> ulock( m_renderMutex );
-            m_renderCV.wait( ulock, [this]() { return m_commandsUpdated == true; } );
-            process_pipelines();
-            m_commandsUpdated   = false;
-            m_renderingFinished = true;
-        }
-        m_updatingCV.notify_one();
+    while ( true ) {
+        uint64_t waitStart = SDL_GetTicksNS();
+        m_submittedFrames.acquire();
+        m_renderThreadWait.fetch_add( SDL_GetTicksNS() - waitStart, std::memory_order_relaxed );
+
+        if ( m_run.load( std::memory_order_relaxed ) == false )
+            break;
+
+        process_frame();
     }
 }
 
 void GPURenderer::renderthread_stop()
 {
-    {
-        std::unique_lock<std::mutex> ulock = wait_for_rendering_finished_and_hold_lock();
-        m_run.store( false, std::memory_order_relaxed );
-    }
-    notify_renderthread();
+    // frames that are still queued get dropped
+    m_run.store( false, std::memory_order_relaxed );
+    m_submittedFrames.release();
     m_renderThread.join();
 }
 
 bool GPURenderer::process_pipelines()
 {
-    if ( m_copyPipelines.size() != 0 ) {
-        do_copypass();
+    IE_ASSERT( m_multiThreaded == false );
+    if ( m_submittedFrames.try_acquire() == false )
+        return false;
+
+    process_frame();
+    return true;
+}
+
+void GPURenderer::process_frame()
+{
+    uint32_t slot  = static_cast<uint32_t>( m_processingFrame % m_framesInFlight );
+    m_currentFrame = &m_frames[slot];
+
+    // the gpu might still use the per frame resources from the last time this slot was processed
+    // once the fence signaled the downloads of that frame can be read without stalling
+    wait_for_frame_fence( *m_currentFrame );
+    m_readbacks.deliver( slot );
+    m_uploads.retire( slot );
+    m_stagingRing.begin_frame( slot );
+    m_frameBackendStart     = m_backend->get_stats();
+    m_frameStagingStart     = m_stagingRing.get_written_bytes();
+    m_processingStats       = {};
+    m_processingStats.Frame = m_processingFrame;
+
+    if ( m_sceneTargetEnabled )
+        update_scene_viewport();
+
+    // declared first, so the asset uploads are recorded before anything draws with them
+    m_uploads.declare_passes( m_renderGraph, slot );
+    bool uploading = m_renderGraph.empty() == false;
+
+    if ( m_commandCapture )
+        m_commandCapture->begin_frame( m_currentFrame->ViewProjection );
+
+    for ( GPUPipeline* pipeline : m_currentFrame->Pipelines ) {
+        uint64_t sortStart = SDL_GetTicksNS();
+        pipeline->begin_dispatch( slot );
+        m_processingStats.SortTime += SDL_GetTicksNS() - sortStart;
+
+        if ( m_commandCapture )
+            pipeline->capture_commands( *m_commandCapture );
+    }
+
+    if ( m_commandCapture )
+        m_commandCapture->end_frame();
+
+    // the swapchain keeps showing the last drawn frame, nothing gets mapped, recorded or presented
+    if ( m_frameElision && can_elide_frame( uploading ) ) {
+        m_processingStats.Elided  = 1;
+        m_currentFrame->InputTime = 0;
+        end_frame();
+        return;
     }
 
-    if ( m_renderPipelines.size() != 0 ) {
-        do_renderpass();
+    for ( GPUPipeline* pipeline : m_currentFrame->Pipelines )
+        pipeline->declare_passes( m_renderGraph );
+
+    if ( m_sceneTargetEnabled && m_renderGraph.empty() == false )
+        declare_sceneblit();
+
+    m_readbacks.declare_passes( m_renderGraph, slot, m_processingFrame );
+
+    // the whole frame is recorded into a single commandbuffer, its fence tells us when the gpu is done with the slot
+    if ( m_renderGraph.empty() == false ) {
+        SDL_GPUCommandBuffer* cmdbuf = m_backend->acquire_commandbuffer();
+        if ( cmdbuf == nullptr ) {
+            IE_LOG_ERROR( "AcquireGPUCommandBuffer failed : %s", SDL_GetError() );
+            m_renderGraph.clear();
+        }
+        else {
+            m_renderGraph.execute( *m_backend, cmdbuf, m_currentFrame->ViewProjection );
+            m_processingStats.CopyTime   = m_renderGraph.get_stats().CopyTime;
+            m_processingStats.RenderTime = m_renderGraph.get_stats().RenderTime;
+
+            m_currentFrame->Fence = m_backend->submit_commandbuffer_and_acquire_fence( cmdbuf );
+            if ( m_currentFrame->Fence == nullptr ) {
+                IE_LOG_ERROR( "SDL_SubmitGPUCommandBuffer failed : %s", SDL_GetError() );
+            }
+            else if ( m_currentFrame->InputTime != 0 ) {
+                // the submit queues the present, SDL does not tell when the display shows it
+                m_processingStats.InputLatency = SDL_GetTicksNS() - m_currentFrame->InputTime;
+            }
+        }
     }
+    m_currentFrame->InputTime = 0;
 
     end_frame();
-    return true;
 }
 
 Window* GPURenderer::get_window() const
@@ -104,32 +208,94 @@ Window* GPURenderer::get_window() const
 
 SDL_GPUDevice* GPURenderer::get_gpudevice() const
 {
-    return m_sdlGPUDevice;
+    return m_backend->get_sdldevice();
 };
 
-void GPURenderer::set_viewprojectionmatrix( const DXSM::Matrix viewProjection )
+GPUBackend* GPURenderer::get_backend() const
 {
-    m_viewProjection = viewProjection;
+    return m_backend.get();
 }
 
-void GPURenderer::end_frame()
+void GPURenderer::set_viewprojectionmatrix( const DXSM::Matrix viewProjection )
 {
-    m_renderPipelines.clear();
-    m_copyPipelines.clear();
-    m_computePipelines.clear();
+    m_frames[get_collecting_frameslot()].ViewProjection = viewProjection;
 }
 
-std::unique_lock<std::mutex> GPURenderer::wait_for_rendering_finished_and_hold_lock()
+void GPURenderer::end_frame()
 {
-    std::unique_lock<std::mutex> ulock( m_renderMutex );
-    m_updatingCV.wait( ulock, [this]() { return m_renderingFinished; } );
-    return ulock;
+    for ( GPUPipeline* pipeline : m_currentFrame->Pipelines )
+        pipeline->end_dispatch();
+
+    m_currentFrame = nullptr;
+
+    // the commandbuffer is submitted, its staging memory is reclaimed once the fence of the slot signaled
+    m_stagingRing.end_frame();
+
+    GPUBackendStats backendStats = m_backend->get_stats();
+    uint64_t        uploaded     = backendStats.UploadedBytes - m_frameBackendStart.UploadedBytes;
+    m_lastFrameUploadBytes.store( uploaded, std::memory_order_relaxed );
+    if ( uploaded > m_maxFrameUploadBytes.load( std::memory_order_relaxed ) )
+        m_maxFrameUploadBytes.store( uploaded, std::memory_order_relaxed );
+
+    // everything created since the last frame, the first one carries the resources created at startup
+    GPUFrameAllocations allocations = m_backend->take_frame_allocations();
+    if ( m_processingFrame > 0 && allocations.Bytes > m_allocationBudget.load( std::memory_order_relaxed ) ) {
+        IE_LOG_WARNING( "Renderer: frame %llu created %llu resources with %llu bytes, over the budget of %llu bytes. %s created %llu bytes of it",
+                        static_cast<unsigned long long>( m_processingFrame ),
+                        static_cast<unsigned long long>( allocations.Count ),
+                        static_cast<unsigned long long>( allocations.Bytes ),
+                        static_cast<unsigned long long>( m_allocationBudget.load( std::memory_order_relaxed ) ),
+                        allocations.LargestOwner.c_str(),
+                        static_cast<unsigned long long>( allocations.LargestOwnerBytes ) );
+    }
+
+    // the pipelines already added the instance data they mapped themselves
+    m_processingStats.MappedBytes += m_stagingRing.get_written_bytes() - m_frameStagingStart;
+
+    m_processingStats.DrawCalls      = backendStats.DrawCalls - m_frameBackendStart.DrawCalls;
+    m_processingStats.PipelineBinds  = backendStats.PipelineBinds - m_frameBackendStart.PipelineBinds;
+    m_processingStats.TextureBinds   = backendStats.TextureBinds - m_frameBackendStart.TextureBinds;
+    m_processingStats.UploadedBytes  = uploaded;
+    m_processingStats.CommandBuffers = backendStats.CommandBuffers - m_frameBackendStart.CommandBuffers;
+
+    // waiting for the swapchain is vsync or the gpu being behind, neither gets cheaper with fewer pixels to record
+    uint64_t frameEnd = SDL_GetTicksNS();
+    uint64_t idle     = m_processingStats.SwapchainWait + m_frameStartIdle.exchange( 0, std::memory_order_relaxed );
+    if ( m_lastFrameEnd != 0 ) {
+        uint64_t interval            = frameEnd - m_lastFrameEnd;
+        m_processingStats.FrameTime   = ( interval > idle ) ? interval - idle : 0;
+        // an elided frame records nothing, its time says nothing about the cost of a scene pixel
+        if ( m_dynamicResolution && m_processingStats.Elided == 0 )
+            update_resolution_scale( m_processingStats.FrameTime );
+    }
+    m_lastFrameEnd = frameEnd;
+    {
+        std::lock_guard<std::mutex> lock( m_statsMutex );
+        if ( m_statsHistory.size() < RenderStatsFrames )
+            m_statsHistory.push_back( m_processingStats );
+        else
+            m_statsHistory[m_statsCount % RenderStatsFrames] = m_processingStats;
+        m_statsCount++;
+    }
+
+    // hand the slot back to the collecting thread
+    ++m_processingFrame;
+    m_freeFrames.release();
 }
 
-void GPURenderer::notify_renderthread()
+void GPURenderer::wait_for_frame_fence( FrameData& frame )
 {
-    if ( m_multiThreaded )
-        m_renderCV.notify_one();
+    if ( frame.Fence == nullptr )
+        return;
+
+    uint64_t waitStart = SDL_GetTicksNS();
+    if ( m_backend->wait_for_fences( true, &frame.Fence, 1 ) == false ) {
+        IE_LOG_ERROR( "SDL_WaitForGPUFences failed : %s", SDL_GetError() );
+    }
+    m_gpuWait.fetch_add( SDL_GetTicksNS() - waitStart, std::memory_order_relaxed );
+
+    m_backend->release_fence( frame.Fence );
+    frame.Fence = nullptr;
 }
 
 ShaderFormatInfo GPURenderer::get_needed_shaderformat()
@@ -154,99 +320,652 @@ bool GPURenderer::has_window()
 
 bool GPURenderer::enable_vsync( bool enabled )
 {
-    if ( enabled == false ) {
-        bool supported = SDL_WindowSupportsGPUPresentMode( m_sdlGPUDevice, get_window()->get_sdlwindow(), SDL_GPU_PRESENTMODE_IMMEDIATE );
-        if ( supported == false )
-            return false;
+    SDL_GPUPresentMode mode = enabled ? SDL_GPU_PRESENTMODE_VSYNC : SDL_GPU_PRESENTMODE_IMMEDIATE;
+    return set_presentmode( mode ) == mode;
+}
+
+SDL_GPUPresentMode GPURenderer::set_presentmode( SDL_GPUPresentMode mode )
+{
+    if ( has_window() == false ) {
+        m_presentMode = mode;
+        return m_presentMode;
+    }
+
+    SDL_Window* window = m_window->get_sdlwindow();
+    if ( mode != SDL_GPU_PRESENTMODE_VSYNC && m_backend->window_supports_presentmode( window, mode ) == false ) {
+        IE_LOG_WARNING( "Renderer: Present mode %s is not supported, using vsync", get_presentmode_name( mode ).data() );
+        mode = SDL_GPU_PRESENTMODE_VSYNC;
+    }
+
+    if ( m_backend->set_swapchain_parameters( window, SDL_GPU_SWAPCHAINCOMPOSITION_SDR, mode ) == false ) {
+        IE_LOG_ERROR( "SDL_SetGPUSwapchainParameters failed : %s", SDL_GetError() );
+        return m_presentMode;
+    }
+
+    m_presentMode = mode;
+    return m_presentMode;
+}
+
+SDL_GPUPresentMode GPURenderer::get_presentmode() const
+{
+    return m_presentMode;
+}
+
+std::string_view GPURenderer::get_presentmode_name( SDL_GPUPresentMode mode )
+{
+    switch ( mode ) {
+    case SDL_GPU_PRESENTMODE_VSYNC: return "vsync";
+    case SDL_GPU_PRESENTMODE_IMMEDIATE: return "immediate";
+    case SDL_GPU_PRESENTMODE_MAILBOX: return "mailbox";
+    }
+    return "unknown";
+}
+
+bool GPURenderer::set_gpu_frames_in_flight( uint32_t count )
+{
+    IE_ASSERT( count >= 1 && count <= MaxGPUFrames );
+    if ( m_backend->set_allowed_frames_in_flight( count ) == false ) {
+        IE_LOG_ERROR( "SDL_SetGPUAllowedFramesInFlight failed : %s", SDL_GetError() );
+        return false;
     }
 
-    return SDL_SetGPUSwapchainParameters( m_sdlGPUDevice, get_window()->get_sdlwindow(), SDL_GPU_SWAPCHAINCOMPOSITION_SDR, enabled ? SDL_GPU_PRESENTMODE_VSYNC : SDL_GPU_PRESENTMODE_IMMEDIATE );
+    m_gpuFrames = count;
+    return true;
+}
+
+uint32_t GPURenderer::get_gpu_frames_in_flight() const
+{
+    return m_gpuFrames;
+}
+
+bool GPURenderer::wait_for_swapchain( uint64_t delayNS )
+{
+    IE_ASSERT( m_multiThreaded == false );
+    uint64_t waitStart = SDL_GetTicksNS();
+    bool     result    = has_window() ? m_backend->wait_for_swapchain( m_window->get_sdlwindow() ) : true;
+    if ( result == false )
+        IE_LOG_ERROR( "SDL_WaitForGPUSwapchain failed : %s", SDL_GetError() );
+
+    if ( delayNS > 0 )
+        SDL_DelayPrecise( delayNS );
+
+    uint64_t waited = SDL_GetTicksNS() - waitStart;
+    m_gameThreadWait.fetch_add( waited, std::memory_order_relaxed );
+    m_frameStartIdle.fetch_add( waited, std::memory_order_relaxed );
+    return result;
+}
+
+void GPURenderer::mark_input( uint64_t timestampNS )
+{
+    if ( m_pendingInput == 0 || timestampNS < m_pendingInput )
+        m_pendingInput = timestampNS;
+}
+
+void GPURenderer::add_idle_time( uint64_t idleNS )
+{
+    m_frameStartIdle.fetch_add( idleNS, std::memory_order_relaxed );
+}
+
+uint32_t GPURenderer::get_frames_in_flight() const
+{
+    return m_framesInFlight;
+}
+
+uint32_t GPURenderer::get_collecting_frameslot() const
+{
+    return static_cast<uint32_t>( m_collectingFrame % m_framesInFlight );
+}
+
+const RenderGraphStats& GPURenderer::get_rendergraph_stats() const
+{
+    return m_renderGraph.get_stats();
+}
+
+FrameWaitCounters GPURenderer::get_wait_counters() const
+{
+    FrameWaitCounters counters;
+    counters.GameThreadWait   = m_gameThreadWait.load( std::memory_order_relaxed );
+    counters.RenderThreadWait = m_renderThreadWait.load( std::memory_order_relaxed );
+    counters.GPUWait          = m_gpuWait.load( std::memory_order_relaxed );
+    return counters;
+}
+
+FrameUploadCounters GPURenderer::get_upload_counters() const
+{
+    FrameUploadCounters counters;
+    counters.LastFrameBytes   = m_lastFrameUploadBytes.load( std::memory_order_relaxed );
+    counters.MaxFrameBytes    = m_maxFrameUploadBytes.load( std::memory_order_relaxed );
+    counters.TextureRegions   = m_textureRegions.load( std::memory_order_relaxed );
+    counters.TextureBytes     = m_textureRegionBytes.load( std::memory_order_relaxed );
+    counters.StagingOverflows = m_stagingRing.get_overflow_count();
+    counters.AssetUploads     = m_uploads.get_uploaded_count();
+    counters.AssetBytes       = m_uploads.get_uploaded_bytes();
+    counters.PendingUploads   = m_uploads.get_pending_count();
+    return counters;
+}
+
+RenderStats GPURenderer::get_render_stats() const
+{
+    std::lock_guard<std::mutex> lock( m_statsMutex );
+    if ( m_statsCount == 0 )
+        return {};
+    return m_statsHistory[( m_statsCount - 1 ) % RenderStatsFrames];
+}
+
+std::vector<RenderStats> GPURenderer::get_render_stats_history() const
+{
+    std::lock_guard<std::mutex> lock( m_statsMutex );
+    std::vector<RenderStats>    history;
+    history.reserve( m_statsHistory.size() );
+
+    // once the ring is full the oldest entry is the one that gets overwritten next
+    size_t oldest = ( m_statsHistory.size() < RenderStatsFrames ) ? 0 : static_cast<size_t>( m_statsCount % RenderStatsFrames );
+    for ( size_t i = 0; i < m_statsHistory.size(); ++i )
+        history.push_back( m_statsHistory[( oldest + i ) % m_statsHistory.size()] );
+    return history;
+}
+
+RenderStats& GPURenderer::get_processing_stats()
+{
+    return m_processingStats;
+}
+
+GPUMemoryReport GPURenderer::get_memory_report() const
+{
+    return m_backend->get_memory_report();
+}
+
+void GPURenderer::set_allocation_budget( uint64_t bytes )
+{
+    m_allocationBudget.store( bytes, std::memory_order_relaxed );
 }
 
 void GPURenderer::submit_pipelines()
 {
-    for ( auto entry : m_loadedPipelines ) {
-        GPUPipeline* pipeline = entry.second.get();
-        pipeline->submit();
-        uint32_t processing = pipeline->needs_processing();
+    FrameData& frame = m_frames[get_collecting_frameslot()];
+    frame.Pipelines  = m_pipelineOrder;
+    frame.InputTime  = m_pendingInput;
+    m_pendingInput   = 0;
+    std::stable_sort( frame.Pipelines.begin(), frame.Pipelines.end(), []( const GPUPipeline* a, const GPUPipeline* b ) {
+        return a->get_renderorder() < b->get_renderorder();
+    } );
+
+    // the next slot has to be processed by the render thread before we can collect into it again
+    uint64_t waitStart = SDL_GetTicksNS();
+    m_freeFrames.acquire();
+    m_gameThreadWait.fetch_add( SDL_GetTicksNS() - waitStart, std::memory_order_relaxed );
+
+    ++m_collectingFrame;
+    uint32_t nextSlot = get_collecting_frameslot();
+    for ( GPUPipeline* pipeline : frame.Pipelines )
+        pipeline->submit( nextSlot );
+
+    m_frames[nextSlot].ViewProjection = frame.ViewProjection;
+    m_submittedFrames.release();
+}
+
+void GPURenderer::import_swapchain()
+{
+    // without a window only the null backend hands out a (fake) swapchain texture
+    m_renderGraph.import_texture(
+        RenderGraph::Swapchain,
+        [this]( SDL_GPUCommandBuffer* cmdbuf ) -> SDL_GPUTexture* {
+            // blocks while the gpu has as many frames queued as allowed, unless wait_for_swapchain already waited
+            uint64_t        waitStart = SDL_GetTicksNS();
+            SDL_GPUTexture* texture   = m_backend->acquire_swapchain_texture( cmdbuf, has_window() ? m_window->get_sdlwindow() : nullptr );
+            m_processingStats.SwapchainWait += SDL_GetTicksNS() - waitStart;
+            return texture;
+        },
+        { 0.0f, 0.5f, 0.0f, 1.0f } );
+}
 
-        if ( processing & PipelineCommand::Render )
-            m_renderPipelines.push_back( pipeline );
-        if ( processing & PipelineCommand::Copy )
-            m_copyPipelines.push_back( pipeline );
-        if ( processing & PipelineCommand::Compute )
-            m_computePipelines.push_back( pipeline );
+std::optional<RenderTarget> GPURenderer::create_rendertarget( std::string_view name, uint32_t width, uint32_t height, SDL_FColor clearColor )
+{
+    SDL_GPUTextureFormat format = m_backend->get_swapchain_textureformat( has_window() ? m_window->get_sdlwindow() : nullptr );
+    if ( format == SDL_GPU_TEXTUREFORMAT_INVALID )
+        format = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM;
+
+    SDL_GPUTextureCreateInfo textureCreateInfo = {};
+    textureCreateInfo.type                     = SDL_GPU_TEXTURETYPE_2D;
+    textureCreateInfo.format                   = format;
+    textureCreateInfo.usage                    = SDL_GPU_TEXTUREUSAGE_COLOR_TARGET | SDL_GPU_TEXTUREUSAGE_SAMPLER;
+    textureCreateInfo.width                    = width;
+    textureCreateInfo.height                   = height;
+    textureCreateInfo.layer_count_or_depth     = 1;
+    textureCreateInfo.num_levels               = 1;
+
+    RenderTarget target;
+    target.Texture = m_backend->create_texture( &textureCreateInfo, name );
+    if ( target.Texture == nullptr ) {
+        IE_LOG_ERROR( "Failed to create rendertarget %.*s : %s", static_cast<int>( name.size() ), name.data(), SDL_GetError() );
+        return std::nullopt;
     }
 
-    if ( m_multiThreaded ) {
-        m_commandsUpdated   = true;
-        m_renderingFinished = false;
+    target.Format   = format;
+    target.Width    = width;
+    target.Height   = height;
+    target.Resource = m_renderGraph.declare_resource( name, RenderResourceType::Texture );
+
+    SDL_GPUTexture* texture = target.Texture;
+    m_renderGraph.import_texture( target.Resource, [texture]( SDL_GPUCommandBuffer* ) { return texture; }, clearColor );
+    if ( m_depthEnabled )
+        attach_depthbuffer( target.Resource );
+
+    m_renderTargets.push_back( target );
+    return target;
+}
+
+const RenderTarget* GPURenderer::get_rendertarget( RenderResourceID resource ) const
+{
+    for ( const RenderTarget& target : m_renderTargets ) {
+        if ( target.Resource == resource )
+            return &target;
     }
+    return nullptr;
 }
 
-void GPURenderer::do_copypass()
+bool GPURenderer::enable_scene_rendertarget( bool enabled )
 {
-    SDL_GPUCommandBuffer* copyCmdbuf = SDL_AcquireGPUCommandBuffer( m_sdlGPUDevice );
-    if ( copyCmdbuf == nullptr ) {
-        IE_LOG_ERROR( "AcquireGPUCommandBuffer failed : %s", SDL_GetError() );
-        return;
+    // the target is kept when disabled again
+    if ( enabled && m_sceneTarget == InvalidRenderResource ) {
+        // without a window there is nothing to blit into, the scene target still works for readbacks
+        uint32_t width  = has_window() ? m_window->get_width() : 1280;
+        uint32_t height = has_window() ? m_window->get_height() : 720;
+
+        auto targetOpt = create_rendertarget( "Scene", width, height, { 0.0f, 0.5f, 0.0f, 1.0f } );
+        if ( targetOpt.has_value() == false )
+            return false;
+
+        m_sceneTarget = targetOpt->Resource;
     }
 
-    SDL_GPUCopyPass* copyPass = SDL_BeginGPUCopyPass( copyCmdbuf );
+    m_sceneTargetEnabled = enabled;
+    return true;
+}
+
+RenderResourceID GPURenderer::get_scene_rendertarget() const
+{
+    return m_sceneTarget;
+}
+
+RenderResourceID GPURenderer::get_default_rendertarget() const
+{
+    return m_sceneTargetEnabled ? m_sceneTarget : RenderGraph::Swapchain;
+}
+
+bool GPURenderer::enable_dynamic_resolution( bool enabled, const DynamicResolutionSettings& settings )
+{
+    IE_ASSERT( settings.MinScale > 0.0f && settings.MinScale <= settings.MaxScale && settings.MaxScale <= 1.0f );
+    if ( enabled && enable_scene_rendertarget( true ) == false )
+        return false;
+
+    m_resolutionSettings = settings;
+    m_dynamicResolution  = enabled;
+    m_averageFrameTime   = 0.0;
+    m_resolutionCooldown = 0;
+    m_resolutionScale.store( enabled ? settings.MaxScale : 1.0f, std::memory_order_relaxed );
+    return true;
+}
+
+float GPURenderer::get_resolution_scale() const
+{
+    return m_resolutionScale.load( std::memory_order_relaxed );
+}
 
-    for ( auto pipeline : m_copyPipelines ) {
-        pipeline->dispatch_copycommands( copyCmdbuf, copyPass );
+void GPURenderer::enable_frame_elision( bool enabled )
+{
+    m_frameElision = enabled;
+    invalidate_frame();
+}
+
+void GPURenderer::invalidate_frame()
+{
+    m_frameInvalid.store( true, std::memory_order_relaxed );
+}
+
+bool GPURenderer::can_elide_frame( bool uploading )
+{
+    // what gets uploaded only shows once the frames drawing with it are processed, a readback needs the frame drawn
+    if ( uploading || m_readbacks.get_pending_count() > 0 )
+        m_redrawFrames = m_framesInFlight;
+
+    CommandHasher hasher;
+    hasher.add( m_currentFrame->ViewProjection );
+    hasher.add( m_sceneViewport );
+    bool hashed = true;
+    for ( GPUPipeline* pipeline : m_currentFrame->Pipelines ) {
+        hasher.add( pipeline );
+        hashed = hashed && pipeline->hash_commands( hasher );
     }
 
-    SDL_EndGPUCopyPass( copyPass );
+    // a swapchain of a new size has no content yet
+    int width  = 0;
+    int height = 0;
+    if ( has_window() && SDL_GetWindowSizeInPixels( m_window->get_sdlwindow(), &width, &height ) ) {
+        hasher.add( width );
+        hasher.add( height );
+    }
 
-    if ( SDL_SubmitGPUCommandBuffer( copyCmdbuf ) == false ) {
-        IE_LOG_ERROR( "SDL_SubmitGPUCommandBuffer failed : %s", SDL_GetError() );
+    bool invalid    = m_frameInvalid.exchange( false, std::memory_order_relaxed );
+    bool identical  = hashed && invalid == false && m_redrawFrames == 0 && hasher.get() == m_lastFrameHash;
+    m_lastFrameHash = hasher.get();
+    if ( m_redrawFrames > 0 )
+        m_redrawFrames--;
+    return identical;
+}
+
+void GPURenderer::update_scene_viewport()
+{
+    const RenderTarget* scene  = get_rendertarget( m_sceneTarget );
+    float               scale  = m_dynamicResolution ? m_resolutionScale.load( std::memory_order_relaxed ) : 1.0f;
+    uint32_t            width  = std::max( static_cast<uint32_t>( scene->Width * scale ), 1u );
+    uint32_t            height = std::max( static_cast<uint32_t>( scene->Height * scale ), 1u );
+
+    // the default viewport covers the whole target, setting it would only cost a command per pass
+    m_sceneViewport = {};
+    if ( width < scene->Width || height < scene->Height ) {
+        m_sceneViewport.w         = static_cast<float>( width );
+        m_sceneViewport.h         = static_cast<float>( height );
+        m_sceneViewport.max_depth = 1.0f;
+    }
+    m_renderGraph.set_viewport( m_sceneTarget, m_sceneViewport );
+
+    m_processingStats.SceneWidth  = width;
+    m_processingStats.SceneHeight = height;
+}
+
+void GPURenderer::update_resolution_scale( uint64_t frameTime )
+{
+    const DynamicResolutionSettings& settings = m_resolutionSettings;
+    if ( m_averageFrameTime == 0.0 )
+        m_averageFrameTime = static_cast<double>( frameTime );
+    else
+        m_averageFrameTime += ( static_cast<double>( frameTime ) - m_averageFrameTime ) * settings.Smoothing;
+
+    if ( m_resolutionCooldown > 0 ) {
+        m_resolutionCooldown--;
         return;
     }
+
+    float  scale    = m_resolutionScale.load( std::memory_order_relaxed );
+    float  newScale = scale;
+    double target   = static_cast<double>( settings.TargetFrameTime );
+    if ( m_averageFrameTime > target ) {
+        // the cost follows the pixel count, which grows with the square of the scale
+        newScale = scale * static_cast<float>( std::sqrt( target / m_averageFrameTime ) );
+    }
+    else if ( m_averageFrameTime < target * settings.Headroom ) {
+        newScale = scale + settings.ScaleUpStep;
+    }
+
+    newScale = std::clamp( newScale, settings.MinScale, settings.MaxScale );
+    if ( newScale == scale )
+        return;
+
+    m_resolutionScale.store( newScale, std::memory_order_relaxed );
+    m_resolutionCooldown = settings.CooldownFrames;
 }
 
-void GPURenderer::do_renderpass()
+bool GPURenderer::enable_depthbuffer()
 {
-    SDL_GPUCommandBuffer* cmdbuf = SDL_AcquireGPUCommandBuffer( m_sdlGPUDevice );
+    if ( m_loadedPipelines.empty() == false ) {
+        IE_LOG_ERROR( "The depthbuffer has to be enabled before the first pipeline is created!" );
+        return false;
+    }
+
+    m_depthEnabled = true;
+    attach_depthbuffer( RenderGraph::Swapchain );
+    for ( const RenderTarget& target : m_renderTargets )
+        attach_depthbuffer( target.Resource );
+    return true;
+}
+
+bool GPURenderer::has_depthbuffer() const
+{
+    return m_depthEnabled;
+}
+
+bool GPURenderer::begin_commandcapture( const std::filesystem::path& path )
+{
+    auto writerOpt = CommandStreamWriter::create( path );
+    if ( writerOpt.has_value() == false )
+        return false;
+
+    m_commandCapture = std::move( writerOpt.value() );
+    return true;
+}
+
+void GPURenderer::end_commandcapture()
+{
+    m_commandCapture.reset();
+}
+
+bool GPURenderer::update_texture_region( SDL_GPUCopyPass* copyPass, SDL_GPUTexture* texture, const SDL_Rect& rect, const void* pixels, uint32_t pitch, uint32_t bytesPerTexel )
+{
+    IE_ASSERT( copyPass != nullptr && texture != nullptr && pixels != nullptr );
+    IE_ASSERT( rect.x >= 0 && rect.y >= 0 && rect.w > 0 && rect.h > 0 );
+
+    uint32_t rowSize = static_cast<uint32_t>( rect.w ) * bytesPerTexel;
+    uint32_t size    = rowSize * static_cast<uint32_t>( rect.h );
+    IE_ASSERT( pitch >= rowSize );
+
+    StagingRing::Allocation allocation;
+    Uint8*                  data = m_stagingRing.begin_write( size, allocation );
+    if ( data == nullptr )
+        return false;
+
+    // the rows are packed tightly, the texture region describes the layout
+    const Uint8* source = static_cast<const Uint8*>( pixels );
+    if ( pitch == rowSize ) {
+        SDL_memcpy( data, source, size );
+    }
+    else {
+        for ( int row = 0; row < rect.h; ++row )
+            SDL_memcpy( data + row * rowSize, source + row * pitch, rowSize );
+    }
+    m_stagingRing.end_write( allocation );
+
+    SDL_GPUTextureTransferInfo transferInfo = {};
+    transferInfo.transfer_buffer            = allocation.TransferBuffer;
+    transferInfo.offset                     = allocation.Offset;
+    transferInfo.pixels_per_row             = static_cast<Uint32>( rect.w );
+    transferInfo.rows_per_layer             = static_cast<Uint32>( rect.h );
+
+    SDL_GPUTextureRegion region = {};
+    region.texture              = texture;
+    region.x                    = static_cast<Uint32>( rect.x );
+    region.y                    = static_cast<Uint32>( rect.y );
+    region.w                    = static_cast<Uint32>( rect.w );
+    region.h                    = static_cast<Uint32>( rect.h );
+    region.d                    = 1;
+
+    // no cycling, the texels outside of rect have to stay, SDL orders this after earlier frames reading the texture
+    m_backend->upload_to_texture( copyPass, &transferInfo, &region, false );
+
+    m_textureRegions.fetch_add( 1, std::memory_order_relaxed );
+    m_textureRegionBytes.fetch_add( size, std::memory_order_relaxed );
+    return true;
+}
+
+SDL_GPUSampler* GPURenderer::get_sampler( const SDL_GPUSamplerCreateInfo& createInfo )
+{
+    std::lock_guard<std::mutex> lock( m_samplerMutex );
+    for ( const auto& [existingInfo, sampler] : m_samplers ) {
+        if ( SDL_memcmp( &existingInfo, &createInfo, sizeof( SDL_GPUSamplerCreateInfo ) ) == 0 )
+            return sampler;
+    }
+
+    SDL_GPUSampler* sampler = m_backend->create_sampler( &createInfo );
+    if ( sampler == nullptr ) {
+        IE_LOG_ERROR( "SDL_CreateGPUSampler failed : %s", SDL_GetError() );
+        return nullptr;
+    }
+    m_samplers.emplace_back( createInfo, sampler );
+    return sampler;
+}
+
+UploadHandle GPURenderer::upload_texture( SDL_GPUTexture* texture, SDL_Surface* surface, bool premultiply )
+{
+    return m_uploads.request_texture( texture, surface, premultiply );
+}
+
+UploadHandle GPURenderer::upload_texture( SDL_GPUTexture* texture, std::vector<Uint8> data, std::vector<UploadLevel> levels )
+{
+    return m_uploads.request_texture( texture, std::move( data ), std::move( levels ) );
+}
+
+UploadHandle GPURenderer::upload_buffer( SDL_GPUBuffer* buffer, const void* data, uint32_t size )
+{
+    return m_uploads.request_buffer( buffer, data, size );
+}
+
+bool GPURenderer::flush_uploads()
+{
+    IE_ASSERT( m_multiThreaded == false );
+
+    // every processed frame is done afterwards, their uploads and staging memory can be retired
+    m_backend->wait_for_idle();
+    for ( uint32_t slot = 0; slot < m_framesInFlight; ++slot )
+        m_uploads.retire( slot );
+    m_stagingRing.reclaim();
+
+    uint32_t slot = static_cast<uint32_t>( m_processingFrame % m_framesInFlight );
+    m_uploads.declare_passes( m_renderGraph, slot, true );
+    if ( m_renderGraph.empty() )
+        return true;
+
+    SDL_GPUCommandBuffer* cmdbuf = m_backend->acquire_commandbuffer();
     if ( cmdbuf == nullptr ) {
         IE_LOG_ERROR( "AcquireGPUCommandBuffer failed : %s", SDL_GetError() );
-        return;
+        m_renderGraph.clear();
+        m_uploads.retire( slot );
+        return false;
+    }
+    m_renderGraph.execute( *m_backend, cmdbuf, DXSM::Matrix::Identity );
+
+    SDL_GPUFence* fence = m_backend->submit_commandbuffer_and_acquire_fence( cmdbuf );
+    if ( fence == nullptr ) {
+        IE_LOG_ERROR( "SDL_SubmitGPUCommandBuffer failed : %s", SDL_GetError() );
+        m_uploads.retire( slot );
+        return false;
     }
 
-    // TODO: custom rendertarget pass
-    { }
+    if ( m_backend->wait_for_fences( true, &fence, 1 ) == false )
+        IE_LOG_ERROR( "SDL_WaitForGPUFences failed : %s", SDL_GetError() );
+    m_backend->release_fence( fence );
+
+    m_uploads.retire( slot );
+    m_stagingRing.reclaim();
+    return true;
+}
+
+bool GPURenderer::request_readback( RenderResourceID target, ReadbackCallback callback )
+{
+    const RenderTarget* renderTarget = get_rendertarget( target );
+    if ( renderTarget == nullptr ) {
+        IE_LOG_ERROR( "Only rendertargets can be read back!" );
+        return false;
+    }
 
-    // Main swapchain pass
-    // only works when a window is associated
-    if ( has_window() ) {
-        SDL_GPUTexture* swapchainTexture;
-        if ( !SDL_WaitAndAcquireGPUSwapchainTexture( cmdbuf, m_window->get_sdlwindow(), &swapchainTexture, nullptr, nullptr ) ) {
-            IE_LOG_ERROR( "WaitAndAcquireGPUSwapchainTexture failed : %s", SDL_GetError() );
+    m_readbacks.request( *renderTarget, std::move( callback ) );
+    return true;
+}
+
+void GPURenderer::declare_sceneblit()
+{
+    m_renderGraph.add_pass( RenderPassType::Blit, "SceneBlit", { m_sceneTarget }, { RenderGraph::Swapchain }, [this]( RenderPassContext& context ) {
+        const RenderTarget* scene     = get_rendertarget( m_sceneTarget );
+        SDL_GPUTexture*     swapchain = context.Graph->get_texture( RenderGraph::Swapchain );
+        if ( scene == nullptr || swapchain == nullptr )
             return;
-        }
 
-        if ( swapchainTexture != nullptr ) {
-            SDL_GPUColorTargetInfo colorTargetInfo = {};
-            colorTargetInfo.texture                = swapchainTexture;
-            colorTargetInfo.clear_color            = { 0.0f, 0.5f, 0.0f, 1.0f };
-            colorTargetInfo.load_op                = SDL_GPU_LOADOP_CLEAR;
-            colorTargetInfo.store_op               = SDL_GPU_STOREOP_STORE;
+        // only the part the scene was rendered into, scaled up linearly when the dynamic resolution shrank it
+        bool            scaled       = m_sceneViewport.w > 0.0f;
+        SDL_GPUBlitInfo blitInfo     = {};
+        blitInfo.source.texture      = scene->Texture;
+        blitInfo.source.w            = scaled ? static_cast<Uint32>( m_sceneViewport.w ) : scene->Width;
+        blitInfo.source.h            = scaled ? static_cast<Uint32>( m_sceneViewport.h ) : scene->Height;
+        blitInfo.destination.texture = swapchain;
+        blitInfo.destination.w       = has_window() ? m_window->get_width() : scene->Width;
+        blitInfo.destination.h       = has_window() ? m_window->get_height() : scene->Height;
+        blitInfo.load_op             = SDL_GPU_LOADOP_DONT_CARE;
+        blitInfo.filter              = scaled ? SDL_GPU_FILTER_LINEAR : SDL_GPU_FILTER_NEAREST;
+        context.Backend->blit_texture( context.CommandBuffer, &blitInfo );
+    } );
+}
 
-            SDL_GPURenderPass* renderPass = SDL_BeginGPURenderPass( cmdbuf, &colorTargetInfo, 1, nullptr );
+void GPURenderer::release_rendertargets()
+{
+    for ( RenderTarget& target : m_renderTargets ) {
+        if ( target.Texture )
+            m_backend->release_texture( target.Texture );
+        target.Texture = nullptr;
+    }
+    m_renderTargets.clear();
+    m_sceneTarget        = InvalidRenderResource;
+    m_sceneTargetEnabled = false;
 
-            for ( auto pipeline : m_renderPipelines ) {
-                pipeline->dispatch_rendercommands( m_viewProjection, cmdbuf, renderPass );
-            }
+    for ( auto& [resource, depthBuffer] : m_depthBuffers ) {
+        if ( depthBuffer.Texture )
+            m_backend->release_texture( depthBuffer.Texture );
+    }
+    m_depthBuffers.clear();
+}
+
+void GPURenderer::release_samplers()
+{
+    std::lock_guard<std::mutex> lock( m_samplerMutex );
+    for ( auto& [createInfo, sampler] : m_samplers )
+        m_backend->release_sampler( sampler );
+    m_samplers.clear();
+}
+
+void GPURenderer::attach_depthbuffer( RenderResourceID target )
+{
+    m_renderGraph.attach_depth( target, [this, target]( SDL_GPUCommandBuffer* ) { return acquire_depthbuffer( target ); } );
+}
 
-            SDL_EndGPURenderPass( renderPass );
+SDL_GPUTexture* GPURenderer::acquire_depthbuffer( RenderResourceID target )
+{
+    // the depth attachment has to match the size of the color target
+    uint32_t width  = 1280;
+    uint32_t height = 720;
+    if ( target == RenderGraph::Swapchain ) {
+        int pixelWidth  = 0;
+        int pixelHeight = 0;
+        if ( has_window() && SDL_GetWindowSizeInPixels( m_window->get_sdlwindow(), &pixelWidth, &pixelHeight ) ) {
+            width  = static_cast<uint32_t>( pixelWidth );
+            height = static_cast<uint32_t>( pixelHeight );
         }
     }
-
-    if ( SDL_SubmitGPUCommandBuffer( cmdbuf ) == false ) {
-        IE_LOG_ERROR( "SDL_SubmitGPUCommandBuffer failed : %s", SDL_GetError() );
-        return;
+    else if ( const RenderTarget* renderTarget = get_rendertarget( target ) ) {
+        width  = renderTarget->Width;
+        height = renderTarget->Height;
     }
+
+    DepthBuffer& depthBuffer = m_depthBuffers[target];
+    if ( depthBuffer.Texture != nullptr && depthBuffer.Width == width && depthBuffer.Height == height )
+        return depthBuffer.Texture;
+
+    // SDL keeps the old texture alive until the frames using it are done
+    if ( depthBuffer.Texture != nullptr )
+        m_backend->release_texture( depthBuffer.Texture );
+
+    SDL_GPUTextureCreateInfo textureCreateInfo = {};
+    textureCreateInfo.type                     = SDL_GPU_TEXTURETYPE_2D;
+    textureCreateInfo.format                   = DepthFormat;
+    textureCreateInfo.usage                    = SDL_GPU_TEXTUREUSAGE_DEPTH_STENCIL_TARGET;
+    textureCreateInfo.width                    = width;
+    textureCreateInfo.height                   = height;
+    textureCreateInfo.layer_count_or_depth     = 1;
+    textureCreateInfo.num_levels               = 1;
+
+    depthBuffer.Texture = m_backend->create_texture( &textureCreateInfo, "DepthBuffer" );
+    depthBuffer.Width   = ( depthBuffer.Texture != nullptr ) ? width : 0;
+    depthBuffer.Height  = ( depthBuffer.Texture != nullptr ) ? height : 0;
+    if ( depthBuffer.Texture == nullptr )
+        IE_LOG_ERROR( "Failed to create depthbuffer : %s", SDL_GetError() );
+    return depthBuffer.Texture;
 }
 
 void GPURenderer::create_renderthread()
@@ -257,7 +976,7 @@ void GPURenderer::create_renderthread()
 
 void GPURenderer::retrieve_shaderformatinfo()
 {
-    SDL_GPUShaderFormat backendFormats = SDL_GetGPUShaderFormats( m_sdlGPUDevice );
+    SDL_GPUShaderFormat backendFormats = m_backend->get_shaderformats();
     if ( backendFormats & SDL_GPU_SHADERFORMAT_SPIRV ) {
         m_shaderFormat.SubDirectory      = "SPIRV";
         m_shaderFormat.Format            = SDL_GPU_SHADERFORMAT_SPIRV;
@@ -2,12 +2,20 @@
 #include "SDL3/SDL_video.h"
 #include "SDL3/SDL_gpu.h"
 
+#include "GPUBackend.h"
 #include "GPUPipeline.h"
 #include "RenderCommandBuffer.h"
+#include "RenderGraph.h"
+#include "RenderTarget.h"
+#include "ReadbackQueue.h"
+#include "StagingRing.h"
+#include "UploadScheduler.h"
 
 #include <string>
 #include <filesystem>
+#include <atomic>
 #include <mutex>
+#include <semaphore>
 #include <map>
 #include <unordered_map>
 #include <type_traits>
@@ -21,85 +29,336 @@ struct ShaderFormatInfo
     std::string_view      FileNameExtension;
 };
 
+// accumulated time spent waiting on the other side of the frame pipeline, in nanoseconds
+struct FrameWaitCounters
+{
+    uint64_t GameThreadWait   = 0;    // game thread waiting for a free frame slot or the swapchain
+    uint64_t RenderThreadWait = 0;    // render thread waiting for a submitted frame
+    uint64_t GPUWait          = 0;    // render thread waiting for the gpu to finish a frame slot
+};
+
+// bytes copied from transfer buffers into buffers and textures
+struct FrameUploadCounters
+{
+    uint64_t LastFrameBytes   = 0;    // every upload of the last processed frame
+    uint64_t MaxFrameBytes    = 0;
+    uint64_t TextureRegions   = 0;    // rectangles uploaded through update_texture_region since creation
+    uint64_t TextureBytes     = 0;
+    uint64_t StagingOverflows = 0;    // uploads that did not fit into the staging ring
+    uint64_t AssetUploads     = 0;    // uploads of the upload scheduler that became resident since creation
+    uint64_t AssetBytes       = 0;
+    uint64_t PendingUploads   = 0;    // still waiting for upload budget
+};
+
+// what one processed frame cost, to compare batching efficiency between changes
+struct RenderStats
+{
+    uint64_t Frame          = 0;
+    uint64_t Sprites        = 0;    // instances the pipelines wrote for the gpu
+    uint64_t Batches        = 0;
+    uint64_t DrawCalls      = 0;
+    uint64_t PipelineBinds  = 0;
+    uint64_t TextureBinds   = 0;
+    uint64_t MappedBytes    = 0;    // written into mapped transfer buffers
+    uint64_t UploadedBytes  = 0;    // copied from transfer buffers into buffers and textures
+    uint64_t CommandBuffers = 0;
+    uint64_t SortTime       = 0;    // ns in begin_dispatch of the pipelines, merging the collected commands into drawing order
+    uint64_t CopyTime       = 0;    // ns recording the copy passes
+    uint64_t RenderTime     = 0;    // ns recording the render passes
+    uint64_t SwapchainWait  = 0;    // ns acquiring the swapchain texture blocked
+    uint64_t InputLatency   = 0;    // ns from the oldest input event of the frame to the submit that presents it, 0 without input
+    uint64_t FrameTime      = 0;    // ns since the last processed frame without waiting for the swapchain, drives the dynamic resolution
+    uint64_t SceneWidth     = 0;    // part of the scene target the frame was rendered into, 0 without scene target
+    uint64_t SceneHeight    = 0;
+    uint64_t Elided         = 0;    // 1 when the frame was identical to the last drawn one and nothing was recorded or presented
+};
+
+// bounds and reaction of the dynamic resolution, the scale applies to both axes of the scene target
+struct DynamicResolutionSettings
+{
+    float    MinScale        = 0.5f;
+    float    MaxScale        = 1.0f;
+    float    ScaleUpStep     = 0.05f;         // added while there is headroom, lowering it follows the overshoot
+    uint64_t TargetFrameTime = 16'666'667;    // ns the moving average of the frame time has to stay below
+    float    Headroom        = 0.85f;         // the scale only grows while the average is below this part of the target
+    float    Smoothing       = 0.1f;          // weight of the newest frame in the moving average
+    uint32_t CooldownFrames  = 30;            // between two changes, so the average can follow the last one
+};
+
 class Window;
 class OrthographicCamera;
+class CommandStreamWriter;
 
 class GPURenderer
 {
     friend class Application;
 
 public:
+    static constexpr uint32_t MaxFramesInFlight = 4;
+    static constexpr uint32_t StagingRingSize   = 1024 * 1024;
+    static constexpr uint32_t UploadBudget      = StagingRingSize / 2;    // asset bytes recorded per frame, the rest waits for the next one
+    static constexpr uint32_t AllocationBudget  = 4 * 1024 * 1024;        // bytes of gpu resources created per frame before it gets logged
+    static constexpr uint32_t RenderStatsFrames = 256;                    // frames kept in the render stats history
+    static constexpr uint32_t MaxGPUFrames      = 3;                      // SDL queues at most this many frames on the gpu
+
+    // the sprite depth is 1 - layer / 65535, 16 bit hold every layer exactly
+    static constexpr SDL_GPUTextureFormat DepthFormat = SDL_GPU_TEXTUREFORMAT_D16_UNORM;
+
     ~GPURenderer();
 
+    // framesInFlight is the number of frames that can be collected, processed and executed on the gpu at the same time
+    // the null backend runs the whole render path without a gpu
     [[nodiscard]]
-    static std::optional<std::unique_ptr<GPURenderer>> create( Window* pWindow = nullptr, bool multiThreaded = true );
+    static std::optional<std::unique_ptr<GPURenderer>> create( Window* pWindow = nullptr, bool multiThreaded = true, uint32_t framesInFlight = 2, GPUBackendType backendType = GPUBackendType::SDL );
 
+    // constructor arguments are only used when the pipeline does not exist yet
+    template <typename T, typename... Args>
+    std::optional<std::shared_ptr<T>> require_pipeline( Args&&... args );
+
+    // nullptr when the pipeline was not created
     template <typename T>
-    std::optional<std::shared_ptr<T>> require_pipeline();
+    std::shared_ptr<T> find_pipeline() const;
 
     void renderthread_run();
     void renderthread_stop();
+
+    // processes the oldest submitted frame, returns false if there is none
+    // only call this when the renderer is not multithreaded, otherwise the render thread does it
     bool process_pipelines();
 
     Window*        get_window() const;
-    SDL_GPUDevice* get_gpudevice() const;
+    SDL_GPUDevice* get_gpudevice() const;    // nullptr with the null backend, record through get_backend()
+    GPUBackend*    get_backend() const;
 
+    // applies to the frame that is currently collected
     void set_viewprojectionmatrix( const DXSM::Matrix viewProjection );
 
-    [[nodiscard]]
-    std::unique_lock<std::mutex> wait_for_rendering_finished_and_hold_lock();
-    void                         notify_renderthread();
-    ShaderFormatInfo             get_needed_shaderformat();
-    std::string                  add_shaderformat_fileextension( std::string_view shaderName );
+    ShaderFormatInfo get_needed_shaderformat();
+    std::string      add_shaderformat_fileextension( std::string_view shaderName );
 
     bool is_multithreaded();
     bool has_window();
 
+    // returns false when the window can not present immediately, it keeps vsync then
     bool enable_vsync( bool enabled );
 
-    // not threadsafe
-    // if the renderer is running multithreaded, use wait_for_rendering_finished_and_hold_lock() before calling this function
+    // vsync waits for the vertical blank, mailbox as well but a newer frame replaces the queued one instead of blocking,
+    // immediate presents right away and tears. Modes the window does not support fall back to vsync, which every window has.
+    // returns the mode that is used now, only call it while no frame is processed
+    SDL_GPUPresentMode      set_presentmode( SDL_GPUPresentMode mode );
+    SDL_GPUPresentMode      get_presentmode() const;
+    static std::string_view get_presentmode_name( SDL_GPUPresentMode mode );
+
+    // frames the gpu may have queued before acquiring the swapchain blocks, 1 to MaxGPUFrames
+    // fewer frames lower the input latency, more of them smooth out uneven frame times
+    bool     set_gpu_frames_in_flight( uint32_t count );
+    uint32_t get_gpu_frames_in_flight() const;
+
+    // only without the render thread, blocks until the swapchain takes another frame and sleeps delayNS more
+    // the frame can then be started just in time, acquiring the swapchain while recording does not block anymore
+    // neither the wait nor the sleep count as frame time for the dynamic resolution
+    bool wait_for_swapchain( uint64_t delayNS = 0 );
+
+    // not threadsafe, call from the thread that collects the frame
+    // the oldest input event of the frame, it is the start of the input latency in the render stats
+    void mark_input( uint64_t timestampNS );
+
+    // threadsafe, time the collecting thread slept on purpose, like wait_for_swapchain it does not count as frame time
+    void add_idle_time( uint64_t idleNS );
+
+    uint32_t            get_frames_in_flight() const;
+    uint32_t            get_collecting_frameslot() const;
+    FrameWaitCounters   get_wait_counters() const;
+    FrameUploadCounters get_upload_counters() const;
+
+    // current and peak bytes of the buffers, textures and transfer buffers, by category and by owner
+    GPUMemoryReport get_memory_report() const;
+    // frames that create more resource memory than this are logged with the owner that allocated the most
+    void set_allocation_budget( uint64_t bytes );
+
+    // threadsafe, stats of the last processed frame and the history of the frames before it, oldest first
+    RenderStats              get_render_stats() const;
+    std::vector<RenderStats> get_render_stats_history() const;
+    // render thread only, the pipelines add what only they know (sprites, batches, mapped bytes) while the frame is processed
+    RenderStats& get_processing_stats();
+
+    // stats of the last executed frame graph, only valid on the render thread
+    const RenderGraphStats& get_rendergraph_stats() const;
+
+    // offscreen color target in the swapchain format, so every pipeline can render into it
+    // render targets and the scene target have to be set up before frames get submitted
+    std::optional<RenderTarget> create_rendertarget( std::string_view name, uint32_t width, uint32_t height, SDL_FColor clearColor = { 0.0f, 0.0f, 0.0f, 1.0f } );
+    const RenderTarget*         get_rendertarget( RenderResourceID resource ) const;
+
+    // renders the frame into an offscreen target of the window size that is blitted into the swapchain,
+    // the swapchain itself can not be read back
+    bool             enable_scene_rendertarget( bool enabled );
+    RenderResourceID get_scene_rendertarget() const;
+    RenderResourceID get_default_rendertarget() const;    // scene target when enabled, otherwise the swapchain
+
+    // renders the scene into a part of the scene target that scales with the moving average of the frame time,
+    // the blit into the swapchain stretches it over the window. Readbacks of the scene target only get the viewport.
+    // enables the scene target and like it has to be set up before frames get submitted
+    bool  enable_dynamic_resolution( bool enabled, const DynamicResolutionSettings& settings = {} );
+    float get_resolution_scale() const;    // threadsafe
+
+    // frames whose commands hash the same as the last drawn frame are neither recorded nor presented, the window keeps the last one.
+    // Frames with asset uploads or readbacks are always drawn. Has to be set up before frames get submitted.
+    void enable_frame_elision( bool enabled );
+    // threadsafe, the next frame is drawn even when it is identical, e.g. after the window content got lost
+    void invalidate_frame();
+
+    // gives the swapchain and every render target a depth attachment, the pipelines then draw opaque content with depth write
+    // and blended content with depth test only. Has to be called before the first pipeline is created,
+    // the pipelines are created for the depth format.
+    bool enable_depthbuffer();
+    bool has_depthbuffer() const;
+
+    // render thread only, call from dispatch_copycommands
+    // uploads the texels of rect through the staging ring shared by all pipelines, the rest of the texture keeps its content
+    // pixels points at the first texel of rect, pitch is the distance between its rows in bytes
+    bool update_texture_region( SDL_GPUCopyPass* copyPass, SDL_GPUTexture* texture, const SDL_Rect& rect, const void* pixels, uint32_t pitch, uint32_t bytesPerTexel );
+
+    // threadsafe, samplers are shared by everyone asking for the same state and live as long as the renderer
+    // the create info has to be zero initialized, it is compared bytewise
+    SDL_GPUSampler* get_sampler( const SDL_GPUSamplerCreateInfo& createInfo );
+
+    // threadsafe, the data is uploaded in the copy pass of one of the next processed frames, as the upload budget allows
+    // commands recorded after that frame can use the resource once the returned status is scheduled
+    // surfaces of any format are converted into the RGBA8 texture, optionally with premultiplied alpha
+    UploadHandle upload_texture( SDL_GPUTexture* texture, SDL_Surface* surface, bool premultiply );
+    UploadHandle upload_texture( SDL_GPUTexture* texture, std::vector<Uint8> data, std::vector<UploadLevel> levels );
+    UploadHandle upload_buffer( SDL_GPUBuffer* buffer, const void* data, uint32_t size );
+
+    // only without the render thread, records every queued upload into a commandbuffer of its own and waits for the gpu
+    bool flush_uploads();
+
+    // threadsafe, downloads the target at the end of the next processed frame
+    // the callback is invoked on the render thread once the gpu finished that frame, nothing waits for it
+    bool request_readback( RenderResourceID target, ReadbackCallback callback );
+
+    // writes everything the pipelines submit per frame into a capture file that can be replayed offline
+    // like the render targets this has to be set up before frames get submitted, or after the last one was processed
+    bool begin_commandcapture( const std::filesystem::path& path );
+    void end_commandcapture();
+
+    // not threadsafe, call from the thread that collects the frame
+    // all threads collecting render commands for this frame have to be finished
+    // blocks only if all frame slots are still in use by the render thread
     void submit_pipelines();
 
 private:
-    void do_copypass();
-    void do_renderpass();
+    struct FrameData
+    {
+        DXSM::Matrix              ViewProjection;
+        std::vector<GPUPipeline*> Pipelines;
+        SDL_GPUFence*             Fence     = nullptr;    // signaled when the gpu is done with this frame slot
+        uint64_t                  InputTime = 0;          // oldest input event that went into the frame, 0 without input
+    };
+
+    void process_frame();
+    void wait_for_frame_fence( FrameData& frame );
+    void import_swapchain();
+    void declare_sceneblit();
+    void release_rendertargets();
+    void release_samplers();
+
+    void            attach_depthbuffer( RenderResourceID target );
+    SDL_GPUTexture* acquire_depthbuffer( RenderResourceID target );
 
     void end_frame();
+    void update_scene_viewport();
+    void update_resolution_scale( uint64_t frameTime );
+    bool can_elide_frame( bool uploading );
     void create_renderthread();
     void retrieve_shaderformatinfo();
 
 private:
-    SDL_GPUDevice*   m_sdlGPUDevice = nullptr;
-    ShaderFormatInfo m_shaderFormat;
-    Window*          m_window = nullptr;
-    bool             m_vsync  = true;
-
-    bool                    m_multiThreaded = false;
-    std::thread             m_renderThread;
-    std::atomic_bool        m_run = true;
-    std::mutex              m_renderMutex;
-    std::condition_variable m_renderCV;
-    std::condition_variable m_updatingCV;
-    bool                    m_commandsUpdated   = true;
-    bool                    m_renderingFinished = true;
+    std::unique_ptr<GPUBackend> m_backend;
+    ShaderFormatInfo            m_shaderFormat;
+    Window*                     m_window       = nullptr;
+    SDL_GPUPresentMode          m_presentMode  = SDL_GPU_PRESENTMODE_VSYNC;
+    uint32_t                    m_gpuFrames    = 2;    // the SDL default
+    uint64_t                    m_pendingInput = 0;    // collecting thread only, oldest input since the last submit
+
+    bool             m_multiThreaded = false;
+    std::thread      m_renderThread;
+    std::atomic_bool m_run = true;
+
+    // The frames form a lock-free single producer single consumer ring:
+    // the collecting thread fills frame m_collectingFrame, the render thread processes frame m_processingFrame.
+    // Both are monotonic frame numbers, the slot is frame % m_framesInFlight.
+    uint32_t                                   m_framesInFlight = 2;
+    std::vector<FrameData>                     m_frames;
+    uint64_t                                   m_collectingFrame = 0;     // collecting thread only
+    uint64_t                                   m_processingFrame = 0;     // render thread only
+    std::counting_semaphore<MaxFramesInFlight> m_submittedFrames { 0 };   // frames ready to be processed
+    std::counting_semaphore<MaxFramesInFlight> m_freeFrames { 0 };        // processed slots that can be collected into again
+
+    std::atomic<uint64_t> m_gameThreadWait   = 0;
+    std::atomic<uint64_t> m_renderThreadWait = 0;
+    std::atomic<uint64_t> m_gpuWait          = 0;
+
+    std::atomic<uint64_t> m_lastFrameUploadBytes = 0;
+    std::atomic<uint64_t> m_maxFrameUploadBytes  = 0;
+    std::atomic<uint64_t> m_textureRegions       = 0;
+    std::atomic<uint64_t> m_textureRegionBytes   = 0;
+    std::atomic<uint64_t> m_allocationBudget     = AllocationBudget;
 
     std::unordered_map<std::type_index, std::shared_ptr<GPUPipeline>> m_loadedPipelines;
+    std::vector<GPUPipeline*>                                         m_pipelineOrder;    // in creation order, the map has none
+
+    // frame that is currently processed and its graph, only used by the render thread
+    FrameData*      m_currentFrame = nullptr;
+    RenderGraph     m_renderGraph;
+    ReadbackQueue   m_readbacks;
+    StagingRing     m_stagingRing;
+    UploadScheduler m_uploads;
+    GPUBackendStats m_frameBackendStart;        // of the backend when the frame started processing
+    uint64_t        m_frameStagingStart = 0;    // written bytes of the staging ring at that time
+    RenderStats     m_processingStats;
+
+    mutable std::mutex       m_statsMutex;
+    std::vector<RenderStats> m_statsHistory;    // ring of RenderStatsFrames
+    uint64_t                 m_statsCount = 0;
+
+    std::vector<RenderTarget> m_renderTargets;
+    RenderResourceID          m_sceneTarget        = InvalidRenderResource;
+    bool                      m_sceneTargetEnabled = false;
+    SDL_GPUViewport           m_sceneViewport      = {};    // render thread only, empty while the whole target is used
+
+    DynamicResolutionSettings m_resolutionSettings;
+    bool                      m_dynamicResolution  = false;
+    std::atomic<float>        m_resolutionScale    = 1.0f;
+    double                    m_averageFrameTime   = 0.0;    // render thread only, ns
+    uint32_t                  m_resolutionCooldown = 0;
+    uint64_t                  m_lastFrameEnd       = 0;
+    std::atomic<uint64_t>     m_frameStartIdle     = 0;      // wait_for_swapchain and add_idle_time since the last processed frame
+
+    bool             m_frameElision  = false;
+    std::atomic_bool m_frameInvalid  = true;
+    uint64_t         m_lastFrameHash = 0;    // render thread only, of the last drawn frame
+    uint32_t         m_redrawFrames  = 0;    // render thread only, frames that are drawn anyway until uploads show up
+
+    // depth attachment of every color target, resized with it by the render thread
+    struct DepthBuffer
+    {
+        SDL_GPUTexture* Texture = nullptr;
+        uint32_t        Width   = 0;
+        uint32_t        Height  = 0;
+    };
 
-    // TODO: Create some kind of frameBuffer object
-    DXSM::Matrix m_viewProjection;
+    bool                                              m_depthEnabled = false;
+    std::unordered_map<RenderResourceID, DepthBuffer> m_depthBuffers;
 
-    std::vector<GPUPipeline*> m_copyPipelines;
-    std::vector<GPUPipeline*> m_renderPipelines;
-    std::vector<GPUPipeline*> m_computePipelines;
+    std::mutex                                                        m_samplerMutex;
+    std::vector<std::pair<SDL_GPUSamplerCreateInfo, SDL_GPUSampler*>> m_samplers;    // a handful, searched linearly
 
-    bool m_needsCopyPass    = false;
-    bool m_needsRenderPass  = false;
-    bool m_needsComputePass = false;
+    std::unique_ptr<CommandStreamWriter> m_commandCapture;    // render thread only once frames are submitted
 };
 
-template <typename T>
-inline std::optional<std::shared_ptr<T>> GPURenderer::require_pipeline()
+template <typename T, typename... Args>
+inline std::optional<std::shared_ptr<T>> GPURenderer::require_pipeline( Args&&... args )
 {
     static_assert( std::is_base_of<GPUPipeline, T>::value == true );
     std::type_index tyidx = std::type_index( typeid( T ) );
@@ -108,10 +367,22 @@ inline std::optional<std::shared_ptr<T>> GPURenderer::require_pipeline()
         return std::static_pointer_cast<T>( it->second );
     }
 
-    std::shared_ptr<T> newPipeline = std::make_shared<T>();
+    std::shared_ptr<T> newPipeline = std::make_shared<T>( std::forward<Args>( args )... );
     if ( newPipeline->init( this ) == false )
         return std::nullopt;
 
     m_loadedPipelines.insert( std::pair( tyidx, std::static_pointer_cast<GPUPipeline>( newPipeline ) ) );
+    m_pipelineOrder.push_back( newPipeline.get() );
     return newPipeline;
 }
+
+template <typename T>
+inline std::shared_ptr<T> GPURenderer::find_pipeline() const
+{
+    static_assert( std::is_base_of<GPUPipeline, T>::value == true );
+    auto it = m_loadedPipelines.find( std::type_index( typeid( T ) ) );
+    if ( it == m_loadedPipelines.end() )
+        return nullptr;
+
+    return std::static_pointer_cast<T>( it->second );
+}
@@ -0,0 +1,244 @@
+#include "iepch.h"
+
+#include "CoreAPI.h"
+#include "Renderer.h"
+#include "AssetManager.h"
+#include "Sprite.h"
+#include "Shader.h"
+#include "Sprite2DPipeline.h"
+#include "CommandStream.h"
+
+// Replays a command stream capture (NastyTetris --capture-commands <file>) on the null backend,
+// so changes to sorting, batching and uploading can be measured on real frames without running the game.
+// usage: ReplayBenchmark <capture> [--iterations N] [--packed] [--sort] [--assets <dir>]
+// --sort additionally runs the general sort that the bucketed command queues make unnecessary
+class ReplayBenchmark
+{
+    struct Timings
+    {
+        uint64_t Frames = 0;
+        uint64_t Replay = 0;    // filling the command queues, not part of the renderer cost
+        uint64_t Sort   = 0;
+        uint64_t Record = 0;    // batching, upload and recording through the render graph
+    };
+
+public:
+    ~ReplayBenchmark();
+
+    bool init( int argc, char** argv );
+    void run();
+
+private:
+    void replay_frame( const CommandStreamFrame& frame, Timings& timings );
+    void log_timings( const char* name, const Timings& timings ) const;
+
+private:
+    std::filesystem::path                     m_capturePath;
+    std::filesystem::path                     m_assetPath   = std::filesystem::current_path().append( "..\\..\\..\\assets\\" );
+    uint32_t                                  m_iterations  = 10;
+    bool                                      m_sort        = false;
+    Sprite2DPipeline::InstanceFormat          m_format      = Sprite2DPipeline::InstanceFormat::Full;
+    uint64_t                                  m_frameNumber = 0;
+    std::unique_ptr<GPURenderer>              m_renderer;
+    std::unique_ptr<AssetManager>             m_assetManager;
+    std::unique_ptr<CommandStreamReader>      m_reader;
+    std::vector<std::shared_ptr<GPUPipeline>> m_pipelines;
+    RenderGraph                               m_renderGraph;
+};
+
+ReplayBenchmark::~ReplayBenchmark()
+{
+    m_pipelines.clear();
+    m_assetManager.reset();
+    m_renderer.reset();
+}
+
+bool ReplayBenchmark::init( int argc, char** argv )
+{
+    for ( int i = 1; i < argc; ++i ) {
+        std::string_view arg = argv[i];
+        if ( arg == "--iterations" && i + 1 < argc ) {
+            m_iterations = static_cast<uint32_t>( SDL_strtoul( argv[++i], nullptr, 10 ) );
+        }
+        else if ( arg == "--packed" ) {
+            m_format = Sprite2DPipeline::InstanceFormat::Packed;
+        }
+        else if ( arg == "--sort" ) {
+            m_sort = true;
+        }
+        else if ( arg == "--assets" && i + 1 < argc ) {
+            m_assetPath = argv[++i];
+        }
+        else if ( m_capturePath.empty() ) {
+            m_capturePath = argv[i];
+        }
+        else {
+            IE_LOG_WARNING( "Unknown commandline argument %s", argv[i] );
+        }
+    }
+
+    if ( m_capturePath.empty() ) {
+        IE_LOG_CRITICAL( "usage: ReplayBenchmark <capture> [--iterations N] [--packed] [--sort] [--assets <dir>]" );
+        return false;
+    }
+
+    auto readerOpt = CommandStreamReader::create( m_capturePath );
+    if ( readerOpt.has_value() == false )
+        return false;
+    m_reader = std::move( readerOpt.value() );
+
+    auto rendererOpt = GPURenderer::create( nullptr, false, 2, GPUBackendType::Null );
+    if ( rendererOpt.has_value() == false )
+        return false;
+    m_renderer = std::move( rendererOpt.value() );
+
+    auto assetManagerOpt = AssetManager::create( m_assetPath, false );
+    if ( assetManagerOpt.has_value() == false )
+        return false;
+    m_assetManager = std::move( assetManagerOpt.value() );
+    m_assetManager->add_repository<Sprite>( "Images" );
+    m_assetManager->add_repository<Shader>( "Shaders" / m_renderer->get_needed_shaderformat().SubDirectory );
+
+    CoreAPI& coreapi       = CoreAPI::get_instance();
+    coreapi.m_assetManager = m_assetManager.get();
+    coreapi.m_renderer     = m_renderer.get();
+
+    // the game loads this sprite first, so the texture uids in the capture match
+    auto tileSpriteOpt = m_assetManager->require_asset<Sprite>( "tile.png" );
+    if ( tileSpriteOpt.has_value() )
+        tileSpriteOpt.value().get()->create_device_ressources( m_renderer.get() );
+    m_renderer->flush_uploads();
+
+    auto spritePipelineOpt = m_renderer->require_pipeline<Sprite2DPipeline>( m_format );
+    if ( spritePipelineOpt.has_value() == false )
+        return false;
+    m_pipelines.push_back( spritePipelineOpt.value() );
+
+    GPUBackend* backend = m_renderer->get_backend();
+    m_renderGraph.import_texture(
+        RenderGraph::Swapchain,
+        [backend]( SDL_GPUCommandBuffer* cmdbuf ) -> SDL_GPUTexture* {
+            return backend->acquire_swapchain_texture( cmdbuf, nullptr );
+        },
+        { 0.0f, 0.0f, 0.0f, 1.0f } );
+
+    IE_LOG_INFO( "ReplayBenchmark: %llu frames in %s", static_cast<unsigned long long>( m_reader->get_frame_count() ), m_capturePath.string().c_str() );
+    return true;
+}
+
+void ReplayBenchmark::run()
+{
+    CommandStreamFrame frame;
+    Timings            total;
+    Timings            best;
+
+    for ( uint32_t iteration = 0; iteration < m_iterations; ++iteration ) {
+        Timings timings;
+        m_reader->rewind();
+        while ( m_reader->next_frame( frame ) )
+            replay_frame( frame, timings );
+
+        total.Frames += timings.Frames;
+        total.Replay += timings.Replay;
+        total.Sort   += timings.Sort;
+        total.Record += timings.Record;
+
+        if ( iteration == 0 || timings.Sort + timings.Record < best.Sort + best.Record )
+            best = timings;
+    }
+
+    log_timings( "average", total );
+    log_timings( "best iteration", best );
+
+    GPUBackendStats stats  = m_renderer->get_backend()->get_stats();
+    double          frames = static_cast<double>( std::max<uint64_t>( total.Frames, 1 ) );
+    IE_LOG_INFO( "ReplayBenchmark: %.1f draw calls, %.0f vertices, %.0f bytes uploaded per frame",
+                 static_cast<double>( stats.DrawCalls ) / frames,
+                 static_cast<double>( stats.Vertices ) / frames,
+                 static_cast<double>( stats.UploadedBytes ) / frames );
+
+    auto draws = m_renderer->find_pipeline<Sprite2DPipeline>()->get_variant_drawcounts();
+    IE_LOG_INFO( "ReplayBenchmark: sprite draw calls per frame %.1f axis aligned, %.1f rotated, %.1f tinted, %.1f rotated and tinted",
+                 static_cast<double>( draws[0] ) / frames,
+                 static_cast<double>( draws[Sprite2DPipeline::VariantRotated] ) / frames,
+                 static_cast<double>( draws[Sprite2DPipeline::VariantTinted] ) / frames,
+                 static_cast<double>( draws[Sprite2DPipeline::VariantRotated | Sprite2DPipeline::VariantTinted] ) / frames );
+}
+
+void ReplayBenchmark::replay_frame( const CommandStreamFrame& frame, Timings& timings )
+{
+    // drives the pipelines like the renderer does, sort_commands runs between dispatching and recording so it can be measured
+    uint32_t framesInFlight = m_renderer->get_frames_in_flight();
+    uint32_t slot           = static_cast<uint32_t>( m_frameNumber % framesInFlight );
+    uint32_t nextSlot       = static_cast<uint32_t>( ( m_frameNumber + 1 ) % framesInFlight );
+    m_frameNumber++;
+
+    uint64_t start = SDL_GetTicksNS();
+    for ( const CommandStreamChunk& chunk : frame.Chunks ) {
+        auto it = std::find_if( m_pipelines.begin(), m_pipelines.end(), [&chunk]( const auto& pipeline ) { return pipeline->get_name() == chunk.Pipeline; } );
+        if ( it == m_pipelines.end() || ( *it )->replay_commands( chunk ) == false )
+            IE_LOG_WARNING( "ReplayBenchmark: Can not replay commands of %.*s", static_cast<int>( chunk.Pipeline.size() ), chunk.Pipeline.data() );
+    }
+
+    for ( auto& pipeline : m_pipelines ) {
+        pipeline->submit( nextSlot );
+        pipeline->begin_dispatch( slot );
+    }
+
+    uint64_t sortStart = SDL_GetTicksNS();
+    if ( m_sort ) {
+        for ( auto& pipeline : m_pipelines )
+            pipeline->sort_commands();
+    }
+
+    uint64_t recordStart = SDL_GetTicksNS();
+    for ( auto& pipeline : m_pipelines )
+        pipeline->declare_passes( m_renderGraph );
+
+    GPUBackend*           backend = m_renderer->get_backend();
+    SDL_GPUCommandBuffer* cmdbuf  = backend->acquire_commandbuffer();
+    m_renderGraph.execute( *backend, cmdbuf, frame.ViewProjection );
+    backend->submit_commandbuffer( cmdbuf );
+
+    for ( auto& pipeline : m_pipelines )
+        pipeline->end_dispatch();
+
+    uint64_t end = SDL_GetTicksNS();
+    timings.Frames++;
+    timings.Replay += sortStart - start;
+    timings.Sort   += recordStart - sortStart;
+    timings.Record += end - recordStart;
+}
+
+void ReplayBenchmark::log_timings( const char* name, const Timings& timings ) const
+{
+    if ( timings.Frames == 0 )
+        return;
+
+    double frames = static_cast<double>( timings.Frames );
+    IE_LOG_INFO( "ReplayBenchmark %s: replay %.3f us, sort %.3f us, record %.3f us per frame",
+                 name,
+                 static_cast<double>( timings.Replay ) / frames / 1000.0,
+                 static_cast<double>( timings.Sort ) / frames / 1000.0,
+                 static_cast<double>( timings.Record ) / frames / 1000.0 );
+}
+
+int main( int argc, char** argv )
+{
+    if ( !SDL_Init( 0 ) ) {
+        IE_LOG_CRITICAL( "Failed to initialize SDL" );
+        return 1;
+    }
+
+    int result = 1;
+    {
+        ReplayBenchmark benchmark;
+        if ( benchmark.init( argc, argv ) ) {
+            benchmark.run();
+            result = 0;
+        }
+    }
+
+    SDL_Quit();
+    return result;
+}
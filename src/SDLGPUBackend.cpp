@@ -0,0 +1,287 @@
+#include "iepch.h"
+#include "SDLGPUBackend.h"
+
+SDLGPUBackend::~SDLGPUBackend()
+{
+    if ( m_device ) {
+        SDL_DestroyGPUDevice( m_device );
+        m_device = nullptr;
+    }
+}
+
+std::optional<std::unique_ptr<SDLGPUBackend>> SDLGPUBackend::create( bool debugMode )
+{
+    std::unique_ptr<SDLGPUBackend> backend( new SDLGPUBackend() );
+
+    backend->m_device = SDL_CreateGPUDevice( SDL_GPU_SHADERFORMAT_SPIRV | SDL_GPU_SHADERFORMAT_DXIL | SDL_GPU_SHADERFORMAT_MSL, debugMode, nullptr );
+    if ( backend->m_device == nullptr ) {
+        IE_LOG_CRITICAL( "GPUCreateDevice failed" );
+        return std::nullopt;
+    }
+    return backend;
+}
+
+GPUBackendType SDLGPUBackend::get_type() const
+{
+    return GPUBackendType::SDL;
+}
+
+SDL_GPUDevice* SDLGPUBackend::get_sdldevice() const
+{
+    return m_device;
+}
+
+SDL_GPUShaderFormat SDLGPUBackend::get_shaderformats()
+{
+    return SDL_GetGPUShaderFormats( m_device );
+}
+
+bool SDLGPUBackend::claim_window( SDL_Window* window )
+{
+    return SDL_ClaimWindowForGPUDevice( m_device, window );
+}
+
+void SDLGPUBackend::release_window( SDL_Window* window )
+{
+    SDL_ReleaseWindowFromGPUDevice( m_device, window );
+}
+
+bool SDLGPUBackend::window_supports_presentmode( SDL_Window* window, SDL_GPUPresentMode presentMode )
+{
+    return SDL_WindowSupportsGPUPresentMode( m_device, window, presentMode );
+}
+
+bool SDLGPUBackend::set_swapchain_parameters( SDL_Window* window, SDL_GPUSwapchainComposition composition, SDL_GPUPresentMode mode )
+{
+    return SDL_SetGPUSwapchainParameters( m_device, window, composition, mode );
+}
+
+bool SDLGPUBackend::set_allowed_frames_in_flight( Uint32 count )
+{
+    return SDL_SetGPUAllowedFramesInFlight( m_device, count );
+}
+
+bool SDLGPUBackend::wait_for_swapchain( SDL_Window* window )
+{
+    if ( window == nullptr )
+        return true;
+
+    return SDL_WaitForGPUSwapchain( m_device, window );
+}
+
+SDL_GPUTextureFormat SDLGPUBackend::get_swapchain_textureformat( SDL_Window* window )
+{
+    return SDL_GetGPUSwapchainTextureFormat( m_device, window );
+}
+
+bool SDLGPUBackend::texture_supports_format( SDL_GPUTextureFormat format, SDL_GPUTextureType type, SDL_GPUTextureUsageFlags usage )
+{
+    return SDL_GPUTextureSupportsFormat( m_device, format, type, usage );
+}
+
+void SDLGPUBackend::wait_for_idle()
+{
+    SDL_WaitForGPUIdle( m_device );
+}
+
+SDL_GPUBuffer* SDLGPUBackend::create_buffer( const SDL_GPUBufferCreateInfo* createInfo, std::string_view owner )
+{
+    SDL_GPUBuffer* buffer = SDL_CreateGPUBuffer( m_device, createInfo );
+    track_allocation( buffer, GPUMemoryCategory::Buffer, createInfo->size, owner );
+    return buffer;
+}
+
+void SDLGPUBackend::release_buffer( SDL_GPUBuffer* buffer )
+{
+    untrack_allocation( buffer );
+    SDL_ReleaseGPUBuffer( m_device, buffer );
+}
+
+SDL_GPUTransferBuffer* SDLGPUBackend::create_transferbuffer( const SDL_GPUTransferBufferCreateInfo* createInfo, std::string_view owner )
+{
+    SDL_GPUTransferBuffer* transferBuffer = SDL_CreateGPUTransferBuffer( m_device, createInfo );
+    track_allocation( transferBuffer, GPUMemoryCategory::TransferBuffer, createInfo->size, owner );
+    return transferBuffer;
+}
+
+void SDLGPUBackend::release_transferbuffer( SDL_GPUTransferBuffer* transferBuffer )
+{
+    untrack_allocation( transferBuffer );
+    SDL_ReleaseGPUTransferBuffer( m_device, transferBuffer );
+}
+
+void* SDLGPUBackend::map_transferbuffer( SDL_GPUTransferBuffer* transferBuffer, bool cycle )
+{
+    return SDL_MapGPUTransferBuffer( m_device, transferBuffer, cycle );
+}
+
+void SDLGPUBackend::unmap_transferbuffer( SDL_GPUTransferBuffer* transferBuffer )
+{
+    SDL_UnmapGPUTransferBuffer( m_device, transferBuffer );
+}
+
+SDL_GPUTexture* SDLGPUBackend::create_texture( const SDL_GPUTextureCreateInfo* createInfo, std::string_view owner )
+{
+    SDL_GPUTexture* texture = SDL_CreateGPUTexture( m_device, createInfo );
+    track_allocation( texture, GPUMemoryCategory::Texture, get_texture_size( createInfo ), owner, createInfo->format );
+    return texture;
+}
+
+void SDLGPUBackend::release_texture( SDL_GPUTexture* texture )
+{
+    untrack_allocation( texture );
+    SDL_ReleaseGPUTexture( m_device, texture );
+}
+
+SDL_GPUSampler* SDLGPUBackend::create_sampler( const SDL_GPUSamplerCreateInfo* createInfo )
+{
+    return SDL_CreateGPUSampler( m_device, createInfo );
+}
+
+void SDLGPUBackend::release_sampler( SDL_GPUSampler* sampler )
+{
+    SDL_ReleaseGPUSampler( m_device, sampler );
+}
+
+SDL_GPUShader* SDLGPUBackend::create_shader( const SDL_GPUShaderCreateInfo* createInfo )
+{
+    return SDL_CreateGPUShader( m_device, createInfo );
+}
+
+void SDLGPUBackend::release_shader( SDL_GPUShader* shader )
+{
+    SDL_ReleaseGPUShader( m_device, shader );
+}
+
+SDL_GPUGraphicsPipeline* SDLGPUBackend::create_graphicspipeline( const SDL_GPUGraphicsPipelineCreateInfo* createInfo )
+{
+    return SDL_CreateGPUGraphicsPipeline( m_device, createInfo );
+}
+
+void SDLGPUBackend::release_graphicspipeline( SDL_GPUGraphicsPipeline* pipeline )
+{
+    SDL_ReleaseGPUGraphicsPipeline( m_device, pipeline );
+}
+
+SDL_GPUCommandBuffer* SDLGPUBackend::acquire_commandbuffer()
+{
+    count_commandbuffer();
+    return SDL_AcquireGPUCommandBuffer( m_device );
+}
+
+bool SDLGPUBackend::submit_commandbuffer( SDL_GPUCommandBuffer* cmdbuf )
+{
+    return SDL_SubmitGPUCommandBuffer( cmdbuf );
+}
+
+SDL_GPUFence* SDLGPUBackend::submit_commandbuffer_and_acquire_fence( SDL_GPUCommandBuffer* cmdbuf )
+{
+    return SDL_SubmitGPUCommandBufferAndAcquireFence( cmdbuf );
+}
+
+bool SDLGPUBackend::wait_for_fences( bool waitAll, SDL_GPUFence* const* fences, Uint32 count )
+{
+    return SDL_WaitForGPUFences( m_device, waitAll, fences, count );
+}
+
+void SDLGPUBackend::release_fence( SDL_GPUFence* fence )
+{
+    SDL_ReleaseGPUFence( m_device, fence );
+}
+
+SDL_GPUTexture* SDLGPUBackend::acquire_swapchain_texture( SDL_GPUCommandBuffer* cmdbuf, SDL_Window* window )
+{
+    if ( window == nullptr )
+        return nullptr;
+
+    SDL_GPUTexture* swapchainTexture = nullptr;
+    if ( !SDL_WaitAndAcquireGPUSwapchainTexture( cmdbuf, window, &swapchainTexture, nullptr, nullptr ) ) {
+        IE_LOG_ERROR( "WaitAndAcquireGPUSwapchainTexture failed : %s", SDL_GetError() );
+    }
+    return swapchainTexture;
+}
+
+SDL_GPUCopyPass* SDLGPUBackend::begin_copypass( SDL_GPUCommandBuffer* cmdbuf )
+{
+    count_copypass();
+    return SDL_BeginGPUCopyPass( cmdbuf );
+}
+
+void SDLGPUBackend::end_copypass( SDL_GPUCopyPass* copyPass )
+{
+    SDL_EndGPUCopyPass( copyPass );
+}
+
+void SDLGPUBackend::upload_to_buffer( SDL_GPUCopyPass* copyPass, const SDL_GPUTransferBufferLocation* source, const SDL_GPUBufferRegion* dest, bool cycle )
+{
+    count_upload( dest->size );
+    SDL_UploadToGPUBuffer( copyPass, source, dest, cycle );
+}
+
+void SDLGPUBackend::upload_to_texture( SDL_GPUCopyPass* copyPass, const SDL_GPUTextureTransferInfo* source, const SDL_GPUTextureRegion* dest, bool cycle )
+{
+    count_upload( get_region_size( dest ) );
+    SDL_UploadToGPUTexture( copyPass, source, dest, cycle );
+}
+
+void SDLGPUBackend::download_from_texture( SDL_GPUCopyPass* copyPass, const SDL_GPUTextureRegion* source, const SDL_GPUTextureTransferInfo* dest )
+{
+    count_download( get_region_size( source ) );
+    SDL_DownloadFromGPUTexture( copyPass, source, dest );
+}
+
+void SDLGPUBackend::blit_texture( SDL_GPUCommandBuffer* cmdbuf, const SDL_GPUBlitInfo* blitInfo )
+{
+    count_command();
+    SDL_BlitGPUTexture( cmdbuf, blitInfo );
+}
+
+SDL_GPURenderPass* SDLGPUBackend::begin_renderpass( SDL_GPUCommandBuffer*                cmdbuf,
+                                                    const SDL_GPUColorTargetInfo*        colorTargets,
+                                                    Uint32                               colorTargetCount,
+                                                    const SDL_GPUDepthStencilTargetInfo* depthTarget )
+{
+    count_renderpass();
+    return SDL_BeginGPURenderPass( cmdbuf, colorTargets, colorTargetCount, depthTarget );
+}
+
+void SDLGPUBackend::end_renderpass( SDL_GPURenderPass* renderPass )
+{
+    SDL_EndGPURenderPass( renderPass );
+}
+
+void SDLGPUBackend::set_viewport( SDL_GPURenderPass* renderPass, const SDL_GPUViewport* viewport )
+{
+    count_command();
+    SDL_SetGPUViewport( renderPass, viewport );
+}
+
+void SDLGPUBackend::bind_graphicspipeline( SDL_GPURenderPass* renderPass, SDL_GPUGraphicsPipeline* pipeline )
+{
+    count_pipelinebind();
+    SDL_BindGPUGraphicsPipeline( renderPass, pipeline );
+}
+
+void SDLGPUBackend::push_vertex_uniformdata( SDL_GPUCommandBuffer* cmdbuf, Uint32 slot, const void* data, Uint32 length )
+{
+    count_uniforms( length );
+    SDL_PushGPUVertexUniformData( cmdbuf, slot, data, length );
+}
+
+void SDLGPUBackend::bind_vertex_storagebuffers( SDL_GPURenderPass* renderPass, Uint32 firstSlot, SDL_GPUBuffer* const* buffers, Uint32 count )
+{
+    count_command();
+    SDL_BindGPUVertexStorageBuffers( renderPass, firstSlot, buffers, count );
+}
+
+void SDLGPUBackend::bind_fragment_samplers( SDL_GPURenderPass* renderPass, Uint32 firstSlot, const SDL_GPUTextureSamplerBinding* bindings, Uint32 count )
+{
+    count_texturebinds( count );
+    SDL_BindGPUFragmentSamplers( renderPass, firstSlot, bindings, count );
+}
+
+void SDLGPUBackend::draw_primitives( SDL_GPURenderPass* renderPass, Uint32 vertexCount, Uint32 instanceCount, Uint32 firstVertex, Uint32 firstInstance )
+{
+    count_draw( static_cast<uint64_t>( vertexCount ) * instanceCount );
+    SDL_DrawGPUPrimitives( renderPass, vertexCount, instanceCount, firstVertex, firstInstance );
+}
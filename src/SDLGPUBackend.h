@@ -0,0 +1,71 @@
+#pragma once
+#include "GPUBackend.h"
+
+// forwards everything to a real SDL_GPUDevice
+class SDLGPUBackend : public GPUBackend
+{
+    SDLGPUBackend() = default;
+
+public:
+    ~SDLGPUBackend() override;
+
+    [[nodiscard]]
+    static std::optional<std::unique_ptr<SDLGPUBackend>> create( bool debugMode );
+
+    GPUBackendType get_type() const override;
+    SDL_GPUDevice* get_sdldevice() const override;
+
+    SDL_GPUShaderFormat  get_shaderformats() override;
+    bool                 claim_window( SDL_Window* window ) override;
+    void                 release_window( SDL_Window* window ) override;
+    bool                 window_supports_presentmode( SDL_Window* window, SDL_GPUPresentMode presentMode ) override;
+    bool                 set_swapchain_parameters( SDL_Window* window, SDL_GPUSwapchainComposition composition, SDL_GPUPresentMode mode ) override;
+    bool                 set_allowed_frames_in_flight( Uint32 count ) override;
+    bool                 wait_for_swapchain( SDL_Window* window ) override;
+    SDL_GPUTextureFormat get_swapchain_textureformat( SDL_Window* window ) override;
+    bool                 texture_supports_format( SDL_GPUTextureFormat format, SDL_GPUTextureType type, SDL_GPUTextureUsageFlags usage ) override;
+    void                 wait_for_idle() override;
+
+    SDL_GPUBuffer*           create_buffer( const SDL_GPUBufferCreateInfo* createInfo, std::string_view owner ) override;
+    void                     release_buffer( SDL_GPUBuffer* buffer ) override;
+    SDL_GPUTransferBuffer*   create_transferbuffer( const SDL_GPUTransferBufferCreateInfo* createInfo, std::string_view owner ) override;
+    void                     release_transferbuffer( SDL_GPUTransferBuffer* transferBuffer ) override;
+    void*                    map_transferbuffer( SDL_GPUTransferBuffer* transferBuffer, bool cycle ) override;
+    void                     unmap_transferbuffer( SDL_GPUTransferBuffer* transferBuffer ) override;
+    SDL_GPUTexture*          create_texture( const SDL_GPUTextureCreateInfo* createInfo, std::string_view owner ) override;
+    void                     release_texture( SDL_GPUTexture* texture ) override;
+    SDL_GPUSampler*          create_sampler( const SDL_GPUSamplerCreateInfo* createInfo ) override;
+    void                     release_sampler( SDL_GPUSampler* sampler ) override;
+    SDL_GPUShader*           create_shader( const SDL_GPUShaderCreateInfo* createInfo ) override;
+    void                     release_shader( SDL_GPUShader* shader ) override;
+    SDL_GPUGraphicsPipeline* create_graphicspipeline( const SDL_GPUGraphicsPipelineCreateInfo* createInfo ) override;
+    void                     release_graphicspipeline( SDL_GPUGraphicsPipeline* pipeline ) override;
+
+    SDL_GPUCommandBuffer* acquire_commandbuffer() override;
+    bool                  submit_commandbuffer( SDL_GPUCommandBuffer* cmdbuf ) override;
+    SDL_GPUFence*         submit_commandbuffer_and_acquire_fence( SDL_GPUCommandBuffer* cmdbuf ) override;
+    bool                  wait_for_fences( bool waitAll, SDL_GPUFence* const* fences, Uint32 count ) override;
+    void                  release_fence( SDL_GPUFence* fence ) override;
+
+    SDL_GPUTexture* acquire_swapchain_texture( SDL_GPUCommandBuffer* cmdbuf, SDL_Window* window ) override;
+
+    SDL_GPUCopyPass* begin_copypass( SDL_GPUCommandBuffer* cmdbuf ) override;
+    void             end_copypass( SDL_GPUCopyPass* copyPass ) override;
+    void             upload_to_buffer( SDL_GPUCopyPass* copyPass, const SDL_GPUTransferBufferLocation* source, const SDL_GPUBufferRegion* dest, bool cycle ) override;
+    void             upload_to_texture( SDL_GPUCopyPass* copyPass, const SDL_GPUTextureTransferInfo* source, const SDL_GPUTextureRegion* dest, bool cycle ) override;
+    void             download_from_texture( SDL_GPUCopyPass* copyPass, const SDL_GPUTextureRegion* source, const SDL_GPUTextureTransferInfo* dest ) override;
+
+    void blit_texture( SDL_GPUCommandBuffer* cmdbuf, const SDL_GPUBlitInfo* blitInfo ) override;
+
+    SDL_GPURenderPass* begin_renderpass( SDL_GPUCommandBuffer* cmdbuf, const SDL_GPUColorTargetInfo* colorTargets, Uint32 colorTargetCount, const SDL_GPUDepthStencilTargetInfo* depthTarget ) override;
+    void               end_renderpass( SDL_GPURenderPass* renderPass ) override;
+    void               set_viewport( SDL_GPURenderPass* renderPass, const SDL_GPUViewport* viewport ) override;
+    void               bind_graphicspipeline( SDL_GPURenderPass* renderPass, SDL_GPUGraphicsPipeline* pipeline ) override;
+    void               push_vertex_uniformdata( SDL_GPUCommandBuffer* cmdbuf, Uint32 slot, const void* data, Uint32 length ) override;
+    void               bind_vertex_storagebuffers( SDL_GPURenderPass* renderPass, Uint32 firstSlot, SDL_GPUBuffer* const* buffers, Uint32 count ) override;
+    void               bind_fragment_samplers( SDL_GPURenderPass* renderPass, Uint32 firstSlot, const SDL_GPUTextureSamplerBinding* bindings, Uint32 count ) override;
+    void               draw_primitives( SDL_GPURenderPass* renderPass, Uint32 vertexCount, Uint32 instanceCount, Uint32 firstVertex, Uint32 firstInstance ) override;
+
+private:
+    SDL_GPUDevice* m_device = nullptr;
+};
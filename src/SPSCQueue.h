@@ -0,0 +1,70 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <optional>
+
+// Bounded lock-free queue for exactly one producer and one consumer thread.
+// Neither side ever blocks, try_push fails when the queue is full and try_pop when it is empty.
+template <typename T>
+class SPSCQueue
+{
+public:
+    // holds exactly capacity elements, the ring behind it is rounded up to the next power of two
+    explicit SPSCQueue( size_t capacity )
+    {
+        size_t size = 1;
+        while ( size < capacity + 1 )    // one slot stays empty to tell full and empty apart
+            size <<= 1;
+
+        m_capacity = capacity;
+        m_mask     = size - 1;
+        m_slots    = std::make_unique<std::optional<T>[]>( size );
+    }
+
+    SPSCQueue( const SPSCQueue& other )            = delete;
+    SPSCQueue& operator=( const SPSCQueue& other ) = delete;
+    SPSCQueue( SPSCQueue&& other )                 = delete;
+    SPSCQueue& operator=( SPSCQueue&& other )      = delete;
+
+    // producer only
+    bool try_push( T&& value )
+    {
+        size_t head = m_head.load( std::memory_order_relaxed );
+        size_t next = ( head + 1 ) & m_mask;
+        if ( ( ( head - m_tail.load( std::memory_order_acquire ) ) & m_mask ) >= m_capacity )
+            return false;
+
+        m_slots[head].emplace( std::move( value ) );
+        m_head.store( next, std::memory_order_release );
+        return true;
+    }
+
+    // consumer only
+    std::optional<T> try_pop()
+    {
+        size_t tail = m_tail.load( std::memory_order_relaxed );
+        if ( tail == m_head.load( std::memory_order_acquire ) )
+            return std::nullopt;
+
+        std::optional<T> value = std::move( m_slots[tail] );
+        m_slots[tail].reset();
+        m_tail.store( ( tail + 1 ) & m_mask, std::memory_order_release );
+        return value;
+    }
+
+    size_t capacity() const
+    {
+        return m_capacity;
+    }
+
+private:
+    std::unique_ptr<std::optional<T>[]> m_slots;
+    size_t                              m_capacity = 0;
+    size_t                              m_mask     = 0;
+
+    // head and tail are written by different threads, keep them on separate cache lines
+    alignas( 64 ) std::atomic<size_t> m_head = 0;
+    alignas( 64 ) std::atomic<size_t> m_tail = 0;
+};
@@ -7,7 +7,7 @@
 Shader::~Shader()
 {
     if ( m_sdlShader != nullptr )
-        SDL_ReleaseGPUShader( m_renderer->get_gpudevice(), m_sdlShader );
+        m_renderer->get_backend()->release_shader( m_sdlShader );
 }
 
 SDL_GPUShader* Shader::get_sdlshader() const
@@ -62,7 +62,7 @@ bool Shader::create_device_ressources( GPURenderer* pRenderer, const ShaderCreat
     sdl_shadercreateinfo.num_storage_buffers     = createInfo.StorageBufferCount;
     sdl_shadercreateinfo.num_uniform_buffers     = createInfo.UniformBufferCount;
 
-    m_sdlShader = SDL_CreateGPUShader( pRenderer->get_gpudevice(), &sdl_shadercreateinfo );
+    m_sdlShader = pRenderer->get_backend()->create_shader( &sdl_shadercreateinfo );
     if ( m_sdlShader == nullptr ) {
         IE_LOG_ERROR( "Failed to create shader!" );
         SDL_free( m_data );
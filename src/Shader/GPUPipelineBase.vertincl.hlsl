@@ -3,3 +3,11 @@ cbuffer FrameMatrices : register(b0, space1)
 {
     float4x4 ViewProjectionMatrix : packoffset(c0);
 };
+
+// the depth of a sprite is its layer depth (1 - layer / 65535) and not projected by the camera,
+// so it can be compared against the depthbuffer directly
+float4 with_layer_depth(float4 position, float depth)
+{
+    position.z = depth * position.w;
+    return position;
+}
@@ -4,13 +4,65 @@ struct SpriteData
 {
     float X, Y, Z, Rotation;
     float2 Scale;
-    float2 Padding;
+    float2 PreviousPosition;    // only SPRITE_INTERPOLATED, padding otherwise
     float4 SourceRect;
     float4 Color;
 };
 
+#ifdef SPRITE_PACKED
+// see Sprite2DPipeline::PackedSpriteVertexUniform
+struct PackedSpriteData
+{
+    uint PositionXY;       // half2
+    uint DepthRotation;    // unorm16 depth, unorm16 rotation in turns
+    uint ScaleWH;          // half2
+    uint SourceXY;         // unorm16 x2
+    uint SourceZW;         // unorm16 x2
+    uint Color;            // rgba8
+    uint2 Padding;
+};
+
+StructuredBuffer<PackedSpriteData> DataBuffer : register(t0, space0);
+
+float2 unpack_unorm16x2(uint value)
+{
+    return float2(value & 0xFFFF, value >> 16) / 65535.0f;
+}
+
+SpriteData load_sprite(uint index)
+{
+    PackedSpriteData packed = DataBuffer[index];
+
+    SpriteData sprite;
+    sprite.X = f16tof32(packed.PositionXY);
+    sprite.Y = f16tof32(packed.PositionXY >> 16);
+    sprite.Z = (packed.DepthRotation & 0xFFFF) / 65535.0f;
+    sprite.Rotation = (packed.DepthRotation >> 16) / 65536.0f * 6.28318530718f;
+    sprite.Scale = float2(f16tof32(packed.ScaleWH), f16tof32(packed.ScaleWH >> 16));
+    sprite.PreviousPosition = float2(0.0f, 0.0f);
+    sprite.SourceRect = float4(unpack_unorm16x2(packed.SourceXY), unpack_unorm16x2(packed.SourceZW));
+    sprite.Color = float4(packed.Color & 0xFF, (packed.Color >> 8) & 0xFF, (packed.Color >> 16) & 0xFF, packed.Color >> 24) / 255.0f;
+    return sprite;
+}
+#else
 StructuredBuffer<SpriteData> DataBuffer : register(t0, space0);
 
+SpriteData load_sprite(uint index)
+{
+    return DataBuffer[index];
+}
+#endif
+
+#ifdef SPRITE_INTERPOLATED
+// see InterpolationUniform in Sprite2DPipeline.cpp
+cbuffer FrameInterpolation : register(b1, space1)
+{
+    float InterpolationFactor;
+    uint FirstSprite;    // the whole buffer is bound, every batch starts at its own sprite
+    uint2 InterpolationPadding;
+};
+#endif
+
 
 static const uint QuadIndices[6] = { 0, 1, 2, 3, 2, 1 };
 static const float2 QuadVertices[4] = { { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 0.0f, 1.0f }, { 1.0f, 1.0f } };
@@ -26,18 +78,28 @@ struct Output
 Output main(uint id : SV_VertexID)
 {
     uint spriteIndex = id / 6;
+#ifdef SPRITE_INTERPOLATED
+    spriteIndex += FirstSprite;
+#endif
     uint vert = QuadIndices[id % 6];
-    SpriteData sprite = DataBuffer[spriteIndex];
+    SpriteData sprite = load_sprite(spriteIndex);
 
-    float c = cos(sprite.Rotation);
-    float s = sin(sprite.Rotation);
+    float2 position = float2(sprite.X, sprite.Y);
+#ifdef SPRITE_INTERPOLATED
+    position = lerp(sprite.PreviousPosition, position, InterpolationFactor);
+#endif
 
     float2 coord = QuadVertices[vert];
     coord *= sprite.Scale;
+
+#ifdef SPRITE_ROTATED
+    float c = cos(sprite.Rotation);
+    float s = sin(sprite.Rotation);
     float2x2 rotation = { c, s, -s, c };
     coord = mul(coord, rotation);
+#endif
 
-    float4 coordWithDepth = float4(coord.x + sprite.X, coord.y + sprite.Y, sprite.Z, 1.0f);
+    float4 coordWithDepth = float4(coord.x + position.x, coord.y + position.y, sprite.Z, 1.0f);
     
     float2 texcoord[4] =
     {
@@ -49,7 +111,7 @@ Output main(uint id : SV_VertexID)
     
     
     Output output;    
-    output.Position = mul(ViewProjectionMatrix, coordWithDepth);
+    output.Position = with_layer_depth(mul(ViewProjectionMatrix, coordWithDepth), sprite.Z);
     output.TexCoord = texcoord[vert];
     output.Color = sprite.Color;
     return output;
@@ -9,5 +9,9 @@ struct Input
 
 float4 main(Input input) : SV_Target0
 {   
+#ifdef SPRITE_UNTINTED
+    return Texture.Sample(Sampler, input.TexCoord);
+#else
     return input.Color * Texture.Sample(Sampler, input.TexCoord);
+#endif
 }
\ No newline at end of file
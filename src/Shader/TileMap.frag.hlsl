@@ -0,0 +1,26 @@
+Texture2D<float4> TileTexture : register(t0, space2);
+Texture2D<float4> CellTexture : register(t1, space2);    // one texel per cell, alpha 0 is an empty cell
+SamplerState TileSampler : register(s0, space2);
+SamplerState CellSampler : register(s1, space2);
+
+struct Input
+{
+    float2 MapCoord : TEXCOORD0;
+};
+
+float4 main(Input input) : SV_Target0
+{
+    uint width, height;
+    CellTexture.GetDimensions(width, height);
+
+    float2 mapSize = float2(width, height);
+    float2 cellCoord = input.MapCoord * mapSize;
+    float2 cell = min(floor(cellCoord), mapSize - 1.0f);
+
+    float4 cellColor = CellTexture.Sample(CellSampler, (cell + 0.5f) / mapSize);
+    if (cellColor.a == 0.0f)
+        discard;
+
+    // every cell shows the whole tile
+    return cellColor * TileTexture.Sample(TileSampler, cellCoord - cell);
+}
@@ -0,0 +1,27 @@
+#include "GPUPipelineBase.vertincl.hlsl"
+
+// see TileMapPipeline::TileMapUniform
+cbuffer TileMapData : register(b1, space1)
+{
+    float4 MapRect : packoffset(c0);     // x, y, width, height
+    float4 MapDepth : packoffset(c1);    // x is the depth
+};
+
+static const uint QuadIndices[6] = { 0, 1, 2, 3, 2, 1 };
+static const float2 QuadVertices[4] = { { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 0.0f, 1.0f }, { 1.0f, 1.0f } };
+
+struct Output
+{
+    float2 MapCoord : TEXCOORD0;    // 0 to 1 across the whole map
+    float4 Position : SV_Position;
+};
+
+Output main(uint id : SV_VertexID)
+{
+    float2 coord = QuadVertices[QuadIndices[id % 6]];
+
+    Output output;
+    output.Position = with_layer_depth(mul(ViewProjectionMatrix, float4(MapRect.xy + coord * MapRect.zw, MapDepth.x, 1.0f)), MapDepth.x);
+    output.MapCoord = coord;
+    return output;
+}
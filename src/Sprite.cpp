@@ -10,10 +10,28 @@
 Sprite::~Sprite()
 {
     release_device_ressources();
+    if ( m_imageData )
+        SDL_DestroySurface( m_imageData );
 }
 
 bool Sprite::load_from_file( std::filesystem::path fullPath )
 {
+    m_textureFilePath = fullPath;
+
+    // block compressed textures are uploaded as they are, with the mips they were converted with
+    if ( fullPath.extension() == ".dds" ) {
+        auto compressedOpt = CompressedTexture::load_dds( fullPath );
+        if ( compressedOpt.has_value() == false )
+            return false;
+
+        m_compressed = std::move( compressedOpt.value() );
+        m_width      = m_compressed->get_width();
+        m_height     = m_compressed->get_height();
+        m_format     = SDL_PIXELFORMAT_UNKNOWN;
+        m_opaque     = m_compressed->is_opaque();
+        return true;
+    }
+
     // Load the texture
     m_imageData = IMG_Load( fullPath.string().c_str() );
     if ( m_imageData == nullptr ) {
@@ -24,6 +42,22 @@ bool Sprite::load_from_file( std::filesystem::path fullPath )
     m_width  = static_cast<uint32_t>( m_imageData->w );
     m_height = static_cast<uint32_t>( m_imageData->h );
     m_format = m_imageData->format;
+
+    // opaque sprites can be drawn with depth write instead of blending, a palette may have transparent colors
+    m_opaque = SDL_ISPIXELFORMAT_ALPHA( m_format ) == false && SDL_ISPIXELFORMAT_INDEXED( m_format ) == false;
+    if ( m_opaque == false && SDL_BYTESPERPIXEL( m_format ) == 4 ) {
+        const SDL_PixelFormatDetails* details = SDL_GetPixelFormatDetails( m_format );
+        m_opaque                              = details != nullptr;
+        for ( int y = 0; m_opaque && y < m_imageData->h; ++y ) {
+            const Uint32* row = reinterpret_cast<const Uint32*>( static_cast<const Uint8*>( m_imageData->pixels ) + y * m_imageData->pitch );
+            for ( int x = 0; x < m_imageData->w; ++x ) {
+                if ( ( row[x] & details->Amask ) != details->Amask ) {
+                    m_opaque = false;
+                    break;
+                }
+            }
+        }
+    }
     return true;
 }
 
@@ -32,41 +66,27 @@ bool Sprite::create_device_ressources( GPURenderer* pRenderer )
     if ( m_ready )
         return true;
 
-    if ( m_imageData == nullptr )
+    if ( m_imageData == nullptr && m_compressed == nullptr )
         return false;
 
     m_renderer             = pRenderer;
-    SDL_GPUDevice* pDevice = m_renderer->get_gpudevice();
-
-    SDL_GPUBufferCreateInfo vertexbufferCreateInfo = {};
-    vertexbufferCreateInfo.usage                   = SDL_GPU_BUFFERUSAGE_VERTEX;
-    vertexbufferCreateInfo.size                    = sizeof( Sprite2DPipeline::Vertex ) * 4;
-
-    m_vertexBuffer = SDL_CreateGPUBuffer( pDevice, &vertexbufferCreateInfo );
-    if ( m_vertexBuffer == nullptr ) {
-        return false;
-    }
-
-    SDL_GPUBufferCreateInfo indexbufferCreateInfo = {};
-    indexbufferCreateInfo.usage                   = SDL_GPU_BUFFERUSAGE_INDEX;
-    indexbufferCreateInfo.size                    = sizeof( Uint16 ) * 6;
-
-    m_indexBuffer = SDL_CreateGPUBuffer( pDevice, &indexbufferCreateInfo );
-    if ( m_indexBuffer == nullptr ) {
-        release_device_ressources();
-        return false;
-    }
+    GPUBackend*    backend = m_renderer->get_backend();
 
     SDL_GPUTextureCreateInfo textureCreateInfo = {};
     textureCreateInfo.type                     = SDL_GPU_TEXTURETYPE_2D;
-    textureCreateInfo.format                   = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM;
+    textureCreateInfo.format                   = m_compressed ? m_compressed->get_format() : SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM;
     textureCreateInfo.usage                    = SDL_GPU_TEXTUREUSAGE_SAMPLER;
     textureCreateInfo.width                    = m_width;
     textureCreateInfo.height                   = m_height;
     textureCreateInfo.layer_count_or_depth     = 1;
-    textureCreateInfo.num_levels               = 1;
+    textureCreateInfo.num_levels               = m_compressed ? static_cast<Uint32>( m_compressed->get_levels().size() ) : 1;
+
+    if ( backend->texture_supports_format( textureCreateInfo.format, textureCreateInfo.type, textureCreateInfo.usage ) == false ) {
+        IE_LOG_ERROR( "Sprite %s: the gpu can not sample its block compressed format", m_textureFilePath.string().c_str() );
+        return false;
+    }
 
-    m_texture = SDL_CreateGPUTexture( pDevice, &textureCreateInfo );
+    m_texture = backend->create_texture( &textureCreateInfo, m_textureFilePath.filename().string() );
     if ( m_texture == nullptr ) {
         release_device_ressources();
         return false;
@@ -79,123 +99,31 @@ bool Sprite::create_device_ressources( GPURenderer* pRenderer )
     samplerCreateInfo.address_mode_v           = SDL_GPU_SAMPLERADDRESSMODE_CLAMP_TO_EDGE;
     samplerCreateInfo.address_mode_u           = SDL_GPU_SAMPLERADDRESSMODE_CLAMP_TO_EDGE;
     samplerCreateInfo.address_mode_w           = SDL_GPU_SAMPLERADDRESSMODE_CLAMP_TO_EDGE;
+    samplerCreateInfo.max_lod                  = 1000.0f;    // every mip level the texture has
 
-    m_sampler = SDL_CreateGPUSampler( pDevice, &samplerCreateInfo );
-    if ( m_sampler == nullptr ) {
-        release_device_ressources();
-        return false;
-    }
-
-    // Set up buffer data
-    SDL_GPUTransferBufferCreateInfo transferBufferCreateInfo = {};
-    transferBufferCreateInfo.usage                           = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD;
-    transferBufferCreateInfo.size                            = ( sizeof( Sprite2DPipeline::Vertex ) * 4 ) + ( sizeof( Uint16 ) * 6 );
-
-    SDL_GPUTransferBuffer* bufferTransferBuffer = SDL_CreateGPUTransferBuffer( pDevice, &transferBufferCreateInfo );
-    if ( bufferTransferBuffer == nullptr ) {
+    // every sprite samples the same way, the renderer hands out one shared sampler
+    SDL_GPUSampler* sampler = m_renderer->get_sampler( samplerCreateInfo );
+    if ( sampler == nullptr ) {
         release_device_ressources();
         return false;
     }
 
-    Sprite2DPipeline::Vertex* transferData = static_cast<Sprite2DPipeline::Vertex*>( SDL_MapGPUTransferBuffer( pDevice, bufferTransferBuffer, false ) );
-    if ( transferData == nullptr ) {
-        SDL_ReleaseGPUTransferBuffer( pDevice, bufferTransferBuffer );
-        release_device_ressources();
-        return false;
-    }
-
-    float width  = static_cast<float>( m_width );
-    float height = static_cast<float>( m_height );
-
-    transferData[0] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
-    transferData[1] = { width, 0.0f, 0.0f, 1.0f, 0.0f };
-    transferData[2] = { width, height, 0.0f, 1.0f, 1.0f };
-    transferData[3] = { 0.0f, height, 0.0f, 0.0f, 1.0f };
-
-    Uint16* indexData = (Uint16*)&transferData[4];
-    indexData[0]      = 0;
-    indexData[1]      = 1;
-    indexData[2]      = 2;
-    indexData[3]      = 0;
-    indexData[4]      = 2;
-    indexData[5]      = 3;
-
-    SDL_UnmapGPUTransferBuffer( pDevice, bufferTransferBuffer );
-
-    // Set up texture data
-    transferBufferCreateInfo.usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD;
-    transferBufferCreateInfo.size  = m_height * m_width * 4;
+    // queued for the next frames, the upload scheduler owns the image data from now on
+    if ( m_compressed ) {
+        std::vector<UploadLevel> levels;
+        for ( const CompressedTexture::MipLevel& mip : m_compressed->get_levels() )
+            levels.push_back( { mip.Offset, mip.Width, mip.Height } );
 
-    SDL_GPUTransferBuffer* textureTransferBuffer = SDL_CreateGPUTransferBuffer( pDevice, &transferBufferCreateInfo );
-    if ( textureTransferBuffer == nullptr ) {
-        SDL_ReleaseGPUTransferBuffer( pDevice, bufferTransferBuffer );
-        release_device_ressources();
-        return false;
+        m_textureUpload = m_renderer->upload_texture( m_texture, m_compressed->take_data(), std::move( levels ) );
+        m_compressed.reset();
     }
-
-    Uint8* textureTransferPtr = static_cast<Uint8*>( SDL_MapGPUTransferBuffer( pDevice, textureTransferBuffer, false ) );
-    if ( textureTransferPtr == nullptr ) {
-        SDL_ReleaseGPUTransferBuffer( pDevice, textureTransferBuffer );
-        SDL_ReleaseGPUTransferBuffer( pDevice, bufferTransferBuffer );
-        release_device_ressources();
-        return false;
+    else {
+        // the sprite pipelines blend with straight alpha
+        m_textureUpload = m_renderer->upload_texture( m_texture, m_imageData, false );
+        m_imageData     = nullptr;
     }
 
-    SDL_memcpy( textureTransferPtr, m_imageData->pixels, m_width * m_height * 4 );
-    SDL_UnmapGPUTransferBuffer( pDevice, textureTransferBuffer );
-
-    // Upload the transfer data to the GPU resources
-    SDL_GPUCommandBuffer* uploadCmdBuf = SDL_AcquireGPUCommandBuffer( pDevice );
-    if ( uploadCmdBuf == nullptr ) {
-        SDL_ReleaseGPUTransferBuffer( pDevice, textureTransferBuffer );
-        SDL_ReleaseGPUTransferBuffer( pDevice, bufferTransferBuffer );
-        release_device_ressources();
-        return false;
-    }
-
-    SDL_GPUCopyPass* copyPass = SDL_BeginGPUCopyPass( uploadCmdBuf );
-
-    SDL_GPUTransferBufferLocation transferBufferLocation = {};
-    transferBufferLocation.transfer_buffer               = bufferTransferBuffer;
-    transferBufferLocation.offset                        = 0;
-
-    SDL_GPUBufferRegion bufferRegion = {};
-    bufferRegion.buffer              = m_vertexBuffer;
-    bufferRegion.offset              = 0;
-    bufferRegion.size                = sizeof( Sprite2DPipeline::Vertex ) * 4;
-
-    SDL_UploadToGPUBuffer( copyPass, &transferBufferLocation, &bufferRegion, false );
-
-    transferBufferLocation = { .transfer_buffer = bufferTransferBuffer, .offset = sizeof( Sprite2DPipeline::Vertex ) * 4 };
-    bufferRegion.buffer    = m_indexBuffer;
-    bufferRegion.offset    = 0;
-    bufferRegion.size      = sizeof( Uint16 ) * 6;
-
-    SDL_UploadToGPUBuffer( copyPass, &transferBufferLocation, &bufferRegion, false );
-
-    SDL_GPUTextureTransferInfo textureTransferInfo = {};
-    textureTransferInfo.transfer_buffer            = textureTransferBuffer;
-    textureTransferInfo.offset                     = 0; /* Zeroes out the rest */
-
-    SDL_GPUTextureRegion textureRegion = {};
-    textureRegion.texture              = m_texture;
-    textureRegion.w                    = m_width;
-    textureRegion.h                    = m_height;
-    textureRegion.d                    = 1;
-
-    SDL_UploadToGPUTexture( copyPass, &textureTransferInfo, &textureRegion, false );
-
-    SDL_DestroySurface( m_imageData );
-    SDL_EndGPUCopyPass( copyPass );
-    SDL_SubmitGPUCommandBuffer( uploadCmdBuf );
-    SDL_ReleaseGPUTransferBuffer( pDevice, bufferTransferBuffer );
-    SDL_ReleaseGPUTransferBuffer( pDevice, textureTransferBuffer );
-
-    m_vertexBufferBinding   = { .buffer = m_vertexBuffer, .offset = 0 };
-    m_indexBufferBinding    = { .buffer = m_indexBuffer, .offset = 0 };
-    m_textureSamplerBinding = { .texture = m_texture, .sampler = m_sampler };
-
-    m_imageData = nullptr;
+    m_textureSamplerBinding = { .texture = m_texture, .sampler = sampler };
 
     auto piplineOpt = m_renderer->require_pipeline<Sprite2DPipeline>();
     if ( piplineOpt.has_value() == false )
@@ -209,22 +137,15 @@ bool Sprite::create_device_ressources( GPURenderer* pRenderer )
 
 void Sprite::release_device_ressources()
 {
-    if ( m_vertexBuffer ) {
-        SDL_ReleaseGPUBuffer( m_renderer->get_gpudevice(), m_vertexBuffer );
-        m_vertexBuffer = nullptr;
-    }
-    if ( m_indexBuffer ) {
-        SDL_ReleaseGPUBuffer( m_renderer->get_gpudevice(), m_indexBuffer );
-        m_indexBuffer = nullptr;
+    // a queued upload is dropped, a recorded one keeps the texture alive until the gpu is done with it
+    if ( m_textureUpload ) {
+        m_textureUpload->cancel();
+        m_textureUpload = nullptr;
     }
     if ( m_texture ) {
-        SDL_ReleaseGPUTexture( m_renderer->get_gpudevice(), m_texture );
+        m_renderer->get_backend()->release_texture( m_texture );
         m_texture = nullptr;
     }
-    if ( m_sampler ) {
-        SDL_ReleaseGPUSampler( m_renderer->get_gpudevice(), m_sampler );
-        m_sampler = nullptr;
-    }
     m_ready = false;
 }
 
@@ -243,19 +164,24 @@ uint32_t Sprite::get_height() const
     return m_height;
 }
 
-SDL_GPUTexture* Sprite::get_sdltexture()
+bool Sprite::is_opaque() const
 {
-    return m_texture;
+    return m_opaque;
 }
 
-SDL_GPUBuffer* Sprite::get_sdlvertexbuffer()
+bool Sprite::is_uploaded() const
 {
-    return m_vertexBuffer;
+    return m_textureUpload && m_textureUpload->is_scheduled();
 }
 
-SDL_GPUBuffer* Sprite::get_sdlindexbuffer()
+bool Sprite::is_resident() const
 {
-    return m_indexBuffer;
+    return m_textureUpload && m_textureUpload->is_resident();
+}
+
+SDL_GPUTexture* Sprite::get_sdltexture()
+{
+    return m_texture;
 }
 
 void Sprite::render( float x, float y, DXSM::Color color, uint16_t layer )
@@ -265,5 +191,5 @@ void Sprite::render( float x, float y, DXSM::Color color, uint16_t layer )
 
 void Sprite::render( float x, float y, float angle, float scale, DXSM::Color color, uint16_t layer )
 {
-    m_pipeline->collect( get_uid(), x, y, angle, scale * get_width(), scale * get_height(), color, layer );
+    m_pipeline->collect( get_uid(), x, y, angle, scale * get_width(), scale * get_height(), color, layer, m_opaque );
 }
@@ -6,6 +6,8 @@
 namespace DXSM = DirectX::SimpleMath;
 
 #include "Asset.h"
+#include "CompressedTexture.h"
+#include "UploadScheduler.h"
 
 #include <filesystem>
 
@@ -15,6 +17,7 @@ class GPURenderer;
 class Sprite : public Asset<Sprite>
 {
     friend class Sprite2DPipeline;
+    friend class TileMapPipeline;
 
 public:
     virtual ~Sprite();
@@ -26,29 +29,31 @@ public:
     SDL_PixelFormat get_format() const;
     uint32_t        get_width() const;
     uint32_t        get_height() const;
+    bool            is_opaque() const;    // no texel is transparent
+
+    // the texture upload was recorded, render thread commands recorded after it can sample the texture
+    bool is_uploaded() const;
+    // the gpu finished the texture upload
+    bool is_resident() const;
 
     SDL_GPUTexture* get_sdltexture();
-    SDL_GPUBuffer*  get_sdlvertexbuffer();
-    SDL_GPUBuffer*  get_sdlindexbuffer();
 
     void render( float x, float y, DXSM::Color color = { 1.0f, 1.0f, 1.0f, 1.0f }, uint16_t layer = 0 );
     void render( float x, float y, float angle, float scale, DXSM::Color color = { 1.0f, 1.0f, 1.0f, 1.0f }, uint16_t layer = 0 );
 
 private:
-    bool                              m_ready     = false;
-    GPURenderer*                      m_renderer  = nullptr;
-    std::shared_ptr<Sprite2DPipeline> m_pipeline  = nullptr;
-    SDL_Surface*                      m_imageData = nullptr;
-    std::filesystem::path             m_textureFilePath;
-    SDL_PixelFormat                   m_format = SDL_PIXELFORMAT_UNKNOWN;
-    uint32_t                          m_width = 0, m_height = 0;
-
-    SDL_GPUTexture* m_texture      = nullptr;
-    SDL_GPUSampler* m_sampler      = nullptr;
-    SDL_GPUBuffer*  m_vertexBuffer = nullptr;
-    SDL_GPUBuffer*  m_indexBuffer  = nullptr;
-
-    SDL_GPUBufferBinding         m_vertexBufferBinding   = {};
-    SDL_GPUBufferBinding         m_indexBufferBinding    = {};
-    SDL_GPUTextureSamplerBinding m_textureSamplerBinding = {};
+    bool                               m_ready     = false;
+    GPURenderer*                       m_renderer  = nullptr;
+    std::shared_ptr<Sprite2DPipeline>  m_pipeline  = nullptr;
+    SDL_Surface*                       m_imageData = nullptr;
+    std::unique_ptr<CompressedTexture> m_compressed;    // instead of the image data for dds files
+    std::filesystem::path              m_textureFilePath;
+    SDL_PixelFormat                    m_format = SDL_PIXELFORMAT_UNKNOWN;
+    uint32_t                           m_width = 0, m_height = 0;
+    bool                               m_opaque = false;
+
+    SDL_GPUTexture* m_texture = nullptr;
+    UploadHandle    m_textureUpload;
+
+    SDL_GPUTextureSamplerBinding m_textureSamplerBinding = {};    // the sampler is owned by the renderer
 };
@@ -12,21 +12,112 @@
 
 #include "Shader.h"
 #include "AssetRepository.h"
+#include "CommandStream.h"
+#include "CommandHash.h"
 
 static constexpr uint32_t SpriteBatchSizeMax = 20000;
 
+// second vertex uniform buffer of SpriteBatch.vert.hlsl (SPRITE_INTERPOLATED)
+struct InterpolationUniform
+{
+    float    Factor;
+    uint32_t FirstSprite;
+    uint32_t Padding[2];
+};
+
+// a captured sprite is its texture uid, the instance data and whether it was drawn opaque, stored unaligned
+static constexpr uint32_t CapturedSpriteSize = sizeof( AssetUID<Sprite> ) + sizeof( Sprite2DPipeline::SpriteVertexUniform ) + sizeof( uint8_t );
+
+static void write_captured_sprite( Uint8*& dst, AssetUID<Sprite> texture, const Sprite2DPipeline::SpriteVertexUniform& info, bool opaque )
+{
+    // AssetUID only wraps the internal uid
+    uint8_t opaqueFlag = opaque ? 1 : 0;
+    SDL_memcpy( dst, static_cast<const void*>( &texture ), sizeof( AssetUID<Sprite> ) );
+    SDL_memcpy( dst + sizeof( AssetUID<Sprite> ), &info, sizeof( Sprite2DPipeline::SpriteVertexUniform ) );
+    SDL_memcpy( dst + sizeof( AssetUID<Sprite> ) + sizeof( Sprite2DPipeline::SpriteVertexUniform ), &opaqueFlag, sizeof( uint8_t ) );
+    dst += CapturedSpriteSize;
+}
+
+// opaque and blended sprites of a texture go into different buckets, the texture index stays dense
+static uint32_t make_bucket_key( AssetUID<Sprite> texture, bool opaque )
+{
+    return ( static_cast<uint32_t>( texture.get_index() ) << 1 ) | ( opaque ? 1u : 0u );
+}
+
+static bool is_opaque_bucket( uint32_t key )
+{
+    return ( key & 1u ) != 0;
+}
+
+// the tint is skipped for sprites that are exactly white
+template <typename Instance>
+static uint8_t get_sprite_variant( const Instance& info )
+{
+    uint8_t variant = 0;
+    if ( info.rotation != 0.0f )
+        variant |= Sprite2DPipeline::VariantRotated;
+    if ( info.color.R() != 1.0f || info.color.G() != 1.0f || info.color.B() != 1.0f || info.color.A() != 1.0f )
+        variant |= Sprite2DPipeline::VariantTinted;
+    return variant;
+}
+
+static SDL_GPUShader* require_shader( GPURenderer* pRenderer, std::string_view name, const Shader::ShaderCreateInfo& createInfo )
+{
+    auto shaderAsset = CoreAPI::get_assetmanager()->get_repository<Shader>()->require_asset( pRenderer->add_shaderformat_fileextension( name ) );
+    if ( shaderAsset.has_value() == false ) {
+        IE_LOG_ERROR( "Shader %.*s not found!", static_cast<int>( name.size() ), name.data() );
+        return nullptr;
+    }
+
+    AssetView<Shader>& shader = shaderAsset.value();
+    IE_ASSERT( shader.get()->create_device_ressources( pRenderer, createInfo ) );
+    return shader.get()->get_sdlshader();
+}
+
+static uint16_t to_unorm16( float value )
+{
+    return static_cast<uint16_t>( std::clamp( value, 0.0f, 1.0f ) * 65535.0f + 0.5f );
+}
+
+Sprite2DPipeline::Sprite2DPipeline( InstanceFormat format ) :
+    m_instanceFormat( format )
+{ }
+
 Sprite2DPipeline::~Sprite2DPipeline()
 {
-    if ( m_spriteTransferBuffer ) {
-        SDL_ReleaseGPUTransferBuffer( m_renderer->get_gpudevice(), m_spriteTransferBuffer );
-        m_spriteTransferBuffer = nullptr;
+    // m_pipeline is one of the variants, GPUPipeline must not release it again
+    for ( auto* pipelines : { &m_variantPipelines, &m_opaquePipelines, &m_interpolatedPipelines } ) {
+        for ( SDL_GPUGraphicsPipeline*& pipeline : *pipelines ) {
+            if ( pipeline )
+                m_renderer->get_backend()->release_graphicspipeline( pipeline );
+            pipeline = nullptr;
+        }
     }
+    m_pipeline = nullptr;
 
-    for ( auto gpubuffer : m_gpuBuffer ) {
-        SDL_ReleaseGPUBuffer( m_renderer->get_gpudevice(), gpubuffer );
+    if ( m_interpolatedBuffer ) {
+        m_renderer->get_backend()->release_buffer( m_interpolatedBuffer );
+        m_interpolatedBuffer = nullptr;
     }
-    m_gpuBuffer.clear();
-    m_batches.clear();
+
+    if ( m_interpolatedTransferBuffer ) {
+        m_renderer->get_backend()->release_transferbuffer( m_interpolatedTransferBuffer );
+        m_interpolatedTransferBuffer = nullptr;
+    }
+
+    for ( auto& frame : m_frameResources ) {
+        if ( frame.TransferBuffer ) {
+            m_renderer->get_backend()->release_transferbuffer( frame.TransferBuffer );
+            frame.TransferBuffer = nullptr;
+        }
+
+        for ( auto gpubuffer : frame.GPUBuffer ) {
+            m_renderer->get_backend()->release_buffer( gpubuffer );
+        }
+        frame.GPUBuffer.clear();
+        frame.Batches.clear();
+    }
+    m_frameResources.clear();
 }
 
 bool Sprite2DPipeline::init( GPURenderer* pRenderer )
@@ -40,31 +131,52 @@ bool Sprite2DPipeline::init( GPURenderer* pRenderer )
 
     m_renderer = pRenderer;
 
-    auto shaderRepo = CoreAPI::get_assetmanager()->get_repository<Shader>();
-    IE_ASSERT( shaderRepo != nullptr );
+    IE_ASSERT( CoreAPI::get_assetmanager()->get_repository<Shader>() != nullptr );
 
-    // load shaders
-    auto vertexShaderAsset = shaderRepo->require_asset( pRenderer->add_shaderformat_fileextension( "SpriteBatch.vert" ) );
-    if ( vertexShaderAsset.has_value() == false ) {
-        IE_LOG_ERROR( "Vertex Shader not found!" );
+    // load shaders, the axis aligned vertex shader skips the rotation and the untinted fragment shader the color multiply
+    bool           packed             = m_instanceFormat == InstanceFormat::Packed;
+    SDL_GPUShader* vertexShaders[2]   = { require_shader( pRenderer, packed ? "SpriteBatchPacked.vert" : "SpriteBatch.vert", { 0, 0, 1, 1 } ),
+                                          require_shader( pRenderer, packed ? "SpriteBatchPackedRotated.vert" : "SpriteBatchRotated.vert", { 0, 0, 1, 1 } ) };
+    SDL_GPUShader* fragmentShaders[2] = { require_shader( pRenderer, "Texture.frag", { 1, 0, 0, 0 } ), require_shader( pRenderer, "TextureXColor.frag", { 1, 0, 0, 0 } ) };
+    if ( vertexShaders[0] == nullptr || vertexShaders[1] == nullptr || fragmentShaders[0] == nullptr || fragmentShaders[1] == nullptr )
         return false;
-    }
 
-    auto fragmentShaderAsset = shaderRepo->require_asset( pRenderer->add_shaderformat_fileextension( "TextureXColor.frag" ) );
-    if ( fragmentShaderAsset.has_value() == false ) {
-        IE_LOG_ERROR( "Fragment Shader not found!" );
+    // the interpolated sprites are always uploaded in the full format, their factor is the second uniform buffer
+    SDL_GPUShader* interpolatedShaders[2] = { require_shader( pRenderer, "SpriteBatchInterpolated.vert", { 0, 0, 1, 2 } ),
+                                              require_shader( pRenderer, "SpriteBatchInterpolatedRotated.vert", { 0, 0, 1, 2 } ) };
+    if ( interpolatedShaders[0] == nullptr || interpolatedShaders[1] == nullptr )
         return false;
+
+    for ( uint8_t variant = 0; variant < VariantCount; ++variant ) {
+        bool rotated = ( variant & VariantRotated ) != 0;
+        bool tinted  = ( variant & VariantTinted ) != 0;
+        if ( create_variant_pipelines( variant, vertexShaders[rotated ? 1 : 0], interpolatedShaders[rotated ? 1 : 0], fragmentShaders[tinted ? 1 : 0] ) == false )
+            return false;
+    }
+    m_pipeline = m_variantPipelines[VariantRotated | VariantTinted];
+
+    m_frameResources.resize( m_renderer->get_frames_in_flight() );
+    for ( auto& frame : m_frameResources ) {
+        if ( ensure_transferbuffer_size( frame, SpriteBatchSizeMax * get_instancestride() ) == false )
+            return false;
+
+        frame.Batches.reserve( 100 );
     }
 
-    AssetView<Shader>& vertexShader   = vertexShaderAsset.value();
-    AssetView<Shader>& fragmentShader = fragmentShaderAsset.value();
+    m_spanFrames.resize( m_renderer->get_frames_in_flight() );
+    m_spanCollectingSlot = m_renderer->get_collecting_frameslot();
+
+    m_renderCmd    = std::make_shared<CommandQueue>( m_renderer->get_frames_in_flight(), m_renderer->get_collecting_frameslot() );
+    m_spriteAssets = CoreAPI::get_assetmanager()->get_repository<Sprite>();
 
-    IE_ASSERT( vertexShader.get()->create_device_ressources( pRenderer, { 0, 0, 1, 1 } ) );
-    IE_ASSERT( fragmentShader.get()->create_device_ressources( pRenderer, { 1, 0, 0, 0 } ) );
+    m_initialized = true;
+    return true;
+}
 
-    // Create the pipeline
+bool Sprite2DPipeline::create_variant_pipelines( uint8_t variant, SDL_GPUShader* vertexShader, SDL_GPUShader* interpolatedVertexShader, SDL_GPUShader* fragmentShader )
+{
     SDL_GPUColorTargetDescription colorTargets[1]     = {};
-    colorTargets[0].format                            = SDL_GetGPUSwapchainTextureFormat( m_renderer->get_gpudevice(), m_renderer->get_window()->get_sdlwindow() );
+    colorTargets[0].format                            = m_renderer->get_backend()->get_swapchain_textureformat( m_renderer->has_window() ? m_renderer->get_window()->get_sdlwindow() : nullptr );
     colorTargets[0].blend_state.src_color_blendfactor = SDL_GPU_BLENDFACTOR_SRC_ALPHA;
     colorTargets[0].blend_state.dst_color_blendfactor = SDL_GPU_BLENDFACTOR_ONE_MINUS_SRC_ALPHA;
     colorTargets[0].blend_state.color_blend_op        = SDL_GPU_BLENDOP_ADD;
@@ -74,110 +186,214 @@ bool Sprite2DPipeline::init( GPURenderer* pRenderer )
     colorTargets[0].blend_state.enable_blend          = true;
 
     SDL_GPUGraphicsPipelineCreateInfo pipelineCreateInfo     = {};
-    pipelineCreateInfo.vertex_shader                         = vertexShader.get()->get_sdlshader();
-    pipelineCreateInfo.fragment_shader                       = fragmentShader.get()->get_sdlshader();
+    pipelineCreateInfo.vertex_shader                         = vertexShader;
+    pipelineCreateInfo.fragment_shader                       = fragmentShader;
     pipelineCreateInfo.primitive_type                        = SDL_GPU_PRIMITIVETYPE_TRIANGLELIST;
     pipelineCreateInfo.target_info.color_target_descriptions = colorTargets;
     pipelineCreateInfo.target_info.num_color_targets         = 1;
 
-    m_pipeline = SDL_CreateGPUGraphicsPipeline( m_renderer->get_gpudevice(), &pipelineCreateInfo );
-    if ( m_pipeline == nullptr ) {
+    // blended sprites only test against the depth of the opaque ones
+    set_depthstate( pipelineCreateInfo, false );
+
+    m_variantPipelines[variant] = m_renderer->get_backend()->create_graphicspipeline( &pipelineCreateInfo );
+    if ( m_variantPipelines[variant] == nullptr ) {
         IE_LOG_ERROR( "Failed to create pipeline!" );
         return false;
     }
 
-    SDL_GPUTransferBufferCreateInfo tbufferCreateInfo = {};
-    tbufferCreateInfo.usage                           = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD;
-    tbufferCreateInfo.size                            = SpriteBatchSizeMax *  sizeof( SpriteVertexUniform );
-
-    m_spriteTransferBuffer = SDL_CreateGPUTransferBuffer( m_renderer->get_gpudevice(), &tbufferCreateInfo );
-    if ( m_spriteTransferBuffer == nullptr ) {
-        IE_LOG_ERROR( "Failed to create GPUTransferBuffer!" );
+    // interpolated sprites are always blended
+    pipelineCreateInfo.vertex_shader = interpolatedVertexShader;
+    m_interpolatedPipelines[variant] = m_renderer->get_backend()->create_graphicspipeline( &pipelineCreateInfo );
+    if ( m_interpolatedPipelines[variant] == nullptr ) {
+        IE_LOG_ERROR( "Failed to create interpolated pipeline!" );
         return false;
     }
+    pipelineCreateInfo.vertex_shader = vertexShader;
 
-    m_renderCmd    = std::make_shared<DoubleBufferedCommandQueue<SpriteBatchInfo>>();
-    m_spriteAssets = CoreAPI::get_assetmanager()->get_repository<Sprite>();
-    m_batches.reserve( 100 );
+    // opaque sprites need no blending and write the depth, so everything they cover is rejected before it gets shaded
+    if ( m_renderer->has_depthbuffer() ) {
+        colorTargets[0].blend_state.enable_blend = false;
+        set_depthstate( pipelineCreateInfo, true );
 
-    m_initialized = true;
+        m_opaquePipelines[variant] = m_renderer->get_backend()->create_graphicspipeline( &pipelineCreateInfo );
+        if ( m_opaquePipelines[variant] == nullptr ) {
+            IE_LOG_ERROR( "Failed to create opaque pipeline!" );
+            return false;
+        }
+    }
     return true;
 }
 
+void Sprite2DPipeline::submit( uint32_t nextFrameSlot )
+{
+    GPUPipeline::submit( nextFrameSlot );
+
+    // the frame shares the interpolated sprites, they are copied if they get changed while it is in flight
+    SpanFrame& collected          = m_spanFrames[m_spanCollectingSlot];
+    collected.Interpolated        = m_interpolated;
+    collected.InterpolationFactor = m_interpolationFactor;
+    m_interpolatedSubmitted       = true;
+
+    IE_ASSERT( nextFrameSlot < m_spanFrames.size() );
+    m_spanCollectingSlot = nextFrameSlot;
+}
+
 void Sprite2DPipeline::dispatch_copycommands( SDL_GPUCommandBuffer* cmdbuf, SDL_GPUCopyPass* copyPass )
 {
-    IE_ASSERT( m_renderer != nullptr && m_renderer->get_gpudevice() != nullptr );
+    IE_ASSERT( m_renderer != nullptr && m_renderer->get_backend() != nullptr );
     IE_ASSERT( cmdbuf != nullptr && copyPass != nullptr );
     IE_ASSERT( get_commandqueue() != nullptr );
     (void)cmdbuf;
 
-    SpriteVertexUniform* dataPtr = nullptr;
-    AssetUID<Sprite>     currentSprite;
-
-    bool       firstBatch   = true;
-    BatchData* currentBatch = nullptr;
-
-    for ( Sprite2DPipeline::SpriteBatchInfo* sprite : get_commandqueue()->get_rendercommands() ) {
-        // start new batch when changing texture or max batch size is reached (should be sorted by texture at this point)
-        if ( currentBatch == nullptr || currentSprite != sprite->texture || currentBatch->count >= SpriteBatchSizeMax ) {
-            // unmap and upload previous batch data before changeing to new batch
-            if ( firstBatch == false ) {
-                SDL_UnmapGPUTransferBuffer( m_renderer->get_gpudevice(), m_spriteTransferBuffer );
-                SDL_GPUTransferBufferLocation tranferBufferLocation { .transfer_buffer = m_spriteTransferBuffer, .offset = 0 };
-                SDL_GPUBufferRegion           bufferRegion { .buffer = get_gpubuffer_by_index( currentBatch->bufferIdx ),
-                                                             .offset = 0,
-                                                             .size   = static_cast<uint32_t>( currentBatch->count * sizeof( SpriteVertexUniform ) ) };
-                SDL_UploadToGPUBuffer( copyPass, &tranferBufferLocation, &bufferRegion, true );
-                dataPtr = nullptr;
-            }
+    GPUBackend*      backend  = m_renderer->get_backend();
+    const auto&      commands = get_commandqueue()->get_rendercommands();
+    const uint32_t   stride   = get_instancestride();
+    FrameResources&  frame    = get_dispatching_frameresources();
+    const SpanFrame& spans    = m_spanFrames[m_dispatchSlot];
+    uint32_t         count    = static_cast<uint32_t>( commands.size() + spans.Instances.size() );
+
+    upload_interpolated_sprites( spans, copyPass );
+    if ( count == 0 )
+        return;
+
+    // every sprite of this frame is written contiguously into the transfer buffer of the frame slot
+    if ( ensure_transferbuffer_size( frame, count * stride ) == false )
+        return;
+
+    // the frame fence was waited on before dispatching, so the gpu is done with this slot and nothing needs to be cycled
+    Uint8* dataPtr = static_cast<Uint8*>( backend->map_transferbuffer( frame.TransferBuffer, false ) );
+    if ( dataPtr == nullptr ) {
+        IE_LOG_ERROR( "SDL_MapGPUTransferBuffer failed : %s", SDL_GetError() );
+        return;
+    }
 
-            currentBatch          = add_batch();
-            currentBatch->texture = sprite->texture;
-            currentSprite         = sprite->texture;
+    // Opaque sprites come first and front to back, the depth test rejects what they cover.
+    // The spans and the blended sprites follow back to front, they only test against that depth.
+    const auto& buckets     = get_commandqueue()->get_buckets();
+    uint32_t    writeOffset = 0;
+    for ( auto it = buckets.rbegin(); it != buckets.rend(); ++it ) {
+        if ( is_opaque_bucket( it->Key ) )
+            write_commands( frame, commands.data() + it->First, it->Count, true, dataPtr, writeOffset );
+    }
 
-            dataPtr    = static_cast<SpriteVertexUniform*>( SDL_MapGPUTransferBuffer( m_renderer->get_gpudevice(), m_spriteTransferBuffer, true ) );
-            firstBatch = false;
-        }
+    write_spans( frame, spans, dataPtr, writeOffset );
+    frame.InterpolatedPosition = frame.Batches.size();
 
-        // add to batch
-        dataPtr[currentBatch->count++] = sprite->info;
+    if ( buckets.empty() ) {
+        // sort_commands() dropped the buckets, the commands are in drawing order already
+        write_commands( frame, commands.data(), commands.size(), false, dataPtr, writeOffset );
     }
-
-    // unmap and upload last batch data
-    if ( currentBatch && currentBatch->count > 0 ) {
-        SDL_UnmapGPUTransferBuffer( m_renderer->get_gpudevice(), m_spriteTransferBuffer );
-        SDL_GPUTransferBufferLocation tranferBufferLocation { .transfer_buffer = m_spriteTransferBuffer, .offset = 0 };
-        SDL_GPUBufferRegion           bufferRegion { .buffer = get_gpubuffer_by_index( currentBatch->bufferIdx ),
-                                                     .offset = 0,
-                                                     .size   = static_cast<uint32_t>( currentBatch->count * sizeof( SpriteVertexUniform ) ) };
-        SDL_UploadToGPUBuffer( copyPass, &tranferBufferLocation, &bufferRegion, true );
+    else {
+        for ( const auto& bucket : buckets ) {
+            if ( is_opaque_bucket( bucket.Key ) == false )
+                write_commands( frame, commands.data() + bucket.First, bucket.Count, false, dataPtr, writeOffset );
+        }
+    }
+    backend->unmap_transferbuffer( frame.TransferBuffer );
+
+    RenderStats& stats = m_renderer->get_processing_stats();
+    stats.Sprites += count;
+    stats.Batches += frame.Batches.size();
+    stats.MappedBytes += count * stride;
+
+    // upload every batch region into its own storage buffer
+    for ( const BatchData& batch : frame.Batches ) {
+        SDL_GPUTransferBufferLocation tranferBufferLocation { .transfer_buffer = frame.TransferBuffer, .offset = batch.transferOffset };
+        SDL_GPUBufferRegion           bufferRegion { .buffer = get_gpubuffer_by_index( frame, batch.bufferIdx ), .offset = 0, .size = batch.count * stride };
+        backend->upload_to_buffer( copyPass, &tranferBufferLocation, &bufferRegion, false );
     }
 }
 
 void Sprite2DPipeline::dispatch_rendercommands( const DXSM::Matrix& viewProjection, SDL_GPUCommandBuffer* cmdbuf, SDL_GPURenderPass* renderPass )
 {
-    IE_ASSERT( m_renderer != nullptr && m_renderer->get_gpudevice() != nullptr );
+    IE_ASSERT( m_renderer != nullptr && m_renderer->get_backend() != nullptr );
     IE_ASSERT( cmdbuf != nullptr && renderPass != nullptr );
     IE_ASSERT( m_spriteAssets.expired() == false );
 
-    SDL_BindGPUGraphicsPipeline( renderPass, m_pipeline );
-    SDL_PushGPUVertexUniformData( cmdbuf, 0, &viewProjection, sizeof( DXSM::Matrix ) );
+    GPUBackend* backend = m_renderer->get_backend();
+
+    backend->push_vertex_uniformdata( cmdbuf, 0, &viewProjection, sizeof( DXSM::Matrix ) );
+
+    auto                     spriteAssets = m_spriteAssets.lock();
+    FrameResources&          frame        = get_dispatching_frameresources();
+    std::span<BatchData>     batches      = frame.Batches;
+    SDL_GPUGraphicsPipeline* bound        = nullptr;
 
-    auto spriteAssets = m_spriteAssets.lock();
-    for ( size_t i = 0; i < m_batches.size(); ++i ) {
-        if ( m_batches[i].texture.valid() == false ) {
+    // the interpolated sprites go between the spans and the blended collected sprites
+    draw_batches( batches.first( frame.InterpolatedPosition ), frame, *spriteAssets, renderPass, bound );
+    draw_interpolated_sprites( m_spanFrames[m_dispatchSlot].InterpolationFactor, *spriteAssets, cmdbuf, renderPass, bound );
+    draw_batches( batches.subspan( frame.InterpolatedPosition ), frame, *spriteAssets, renderPass, bound );
+}
+
+void Sprite2DPipeline::draw_batches( std::span<const BatchData> batches, const FrameResources& frame, AssetRepository<Sprite>& spriteAssets, SDL_GPURenderPass* renderPass,
+                                     SDL_GPUGraphicsPipeline*& bound )
+{
+    GPUBackend* backend = m_renderer->get_backend();
+    for ( const BatchData& batch : batches ) {
+        if ( batch.texture.valid() == false ) {
             continue;
         }
 
-        auto gpuBuffer = get_gpubuffer_by_index( m_batches[i].bufferIdx );
-        SDL_BindGPUVertexStorageBuffers( renderPass, 0, &gpuBuffer, 1 );
+        SDL_GPUGraphicsPipeline* pipeline = batch.opaque ? m_opaquePipelines[batch.variant] : m_variantPipelines[batch.variant];
+        if ( pipeline != bound ) {
+            backend->bind_graphicspipeline( renderPass, pipeline );
+            bound = pipeline;
+        }
+
+        auto gpuBuffer = get_gpubuffer_by_index( frame, batch.bufferIdx );
+        backend->bind_vertex_storagebuffers( renderPass, 0, &gpuBuffer, 1 );
 
-        auto texture = spriteAssets->get_asset( m_batches[i].texture );
-        SDL_BindGPUFragmentSamplers( renderPass, 0, &texture->m_textureSamplerBinding, 1 );
+        // replayed captures may reference textures that were never loaded
+        if ( spriteAssets.is_available( batch.texture ) == false ) {
+            continue;
+        }
+
+        // the texture upload may still wait for upload budget
+        auto texture = spriteAssets.get_asset( batch.texture );
+        if ( texture->is_uploaded() == false ) {
+            continue;
+        }
+        backend->bind_fragment_samplers( renderPass, 0, &texture->m_textureSamplerBinding, 1 );
 
-        SDL_DrawGPUPrimitives( renderPass, m_batches[i].count * 6, 1, 0, 0 );
+        backend->draw_primitives( renderPass, batch.count * 6, 1, 0, 0 );
+        m_variantDraws[batch.variant].fetch_add( 1, std::memory_order_relaxed );
     }
-    clear_batches();
+}
+
+void Sprite2DPipeline::draw_interpolated_sprites( float factor, AssetRepository<Sprite>& spriteAssets, SDL_GPUCommandBuffer* cmdbuf, SDL_GPURenderPass* renderPass,
+                                                  SDL_GPUGraphicsPipeline*& bound )
+{
+    if ( m_interpolatedBatches.empty() )
+        return;
+
+    GPUBackend* backend = m_renderer->get_backend();
+    backend->bind_vertex_storagebuffers( renderPass, 0, &m_interpolatedBuffer, 1 );
+
+    uint32_t drawn = 0;
+    for ( const InterpolatedBatch& batch : m_interpolatedBatches ) {
+        if ( spriteAssets.is_available( batch.texture ) == false )
+            continue;
+
+        auto texture = spriteAssets.get_asset( batch.texture );
+        if ( texture->is_uploaded() == false )
+            continue;
+
+        SDL_GPUGraphicsPipeline* pipeline = m_interpolatedPipelines[batch.variant];
+        if ( pipeline != bound ) {
+            backend->bind_graphicspipeline( renderPass, pipeline );
+            bound = pipeline;
+        }
+        backend->bind_fragment_samplers( renderPass, 0, &texture->m_textureSamplerBinding, 1 );
+
+        // the storage buffer can not be bound with an offset, the shader starts at the first sprite of the batch
+        InterpolationUniform uniform = { factor, batch.first, 0, 0 };
+        backend->push_vertex_uniformdata( cmdbuf, 1, &uniform, sizeof( InterpolationUniform ) );
+
+        backend->draw_primitives( renderPass, batch.count * 6, 1, 0, 0 );
+        m_variantDraws[batch.variant].fetch_add( 1, std::memory_order_relaxed );
+        drawn += batch.count;
+    }
+    m_renderer->get_processing_stats().Sprites += drawn;
 }
 
 const std::string_view Sprite2DPipeline::get_name() const
@@ -189,20 +405,168 @@ void Sprite2DPipeline::sort_commands()
 {
     IE_ASSERT( get_commandqueue() != nullptr );
     auto cmdQueue = get_commandqueue();
+    // only needed when the depth of the sprites does not come from their layer, the buckets already are in drawing order
     cmdQueue->sort( []( const SpriteBatchInfo* a, const SpriteBatchInfo* b ) {
-        if ( a->texture < b->texture )
-            return true;
-
-        if ( a->info.z > b->info.z )
-            return true;
+        if ( a->info.z != b->info.z )
+            return a->info.z > b->info.z;
 
-        return false;
+        return a->texture < b->texture;
     } );
 }
 
 uint32_t Sprite2DPipeline::needs_processing() const
 {
-    return ( get_commandqueue()->get_rendercommands().size() != 0 ) ? PipelineCommand::Render | PipelineCommand::Copy : 0;
+    const SpanFrame& spans           = m_spanFrames[m_dispatchSlot];
+    bool             hasSpans        = spans.Spans.empty() == false;
+    bool             hasInterpolated = spans.Interpolated != nullptr && spans.Interpolated->Instances.empty() == false;
+    if ( get_commandqueue()->get_rendercommands().size() != 0 || hasSpans )
+        return PipelineCommand::Render | PipelineCommand::Copy;
+
+    // the interpolated sprites only need a copy when they changed, a replaced set may be empty and still has to drop the old batches
+    uint64_t version = ( spans.Interpolated != nullptr ) ? spans.Interpolated->Version : 0;
+    return ( hasInterpolated ? PipelineCommand::Render : 0 ) | ( version != m_uploadedVersion ? PipelineCommand::Copy : 0 );
+}
+
+void Sprite2DPipeline::end_dispatch()
+{
+    clear_batches( get_dispatching_frameresources() );
+
+    SpanFrame& spans = m_spanFrames[m_dispatchSlot];
+    spans.Spans.clear();
+    spans.Instances.clear();
+    spans.Interpolated.reset();
+
+    GPUPipeline::end_dispatch();
+}
+
+void Sprite2DPipeline::capture_commands( CommandStreamWriter& writer )
+{
+    const auto&      commands = get_commandqueue()->get_rendercommands();
+    const SpanFrame& spans    = m_spanFrames[m_dispatchSlot];
+    uint32_t         count    = static_cast<uint32_t>( commands.size() + spans.Instances.size() );
+    if ( spans.Interpolated != nullptr )
+        count += static_cast<uint32_t>( spans.Interpolated->Instances.size() );
+
+    Uint8* dst = writer.add_chunk( get_name(), sizeof( uint32_t ) + count * CapturedSpriteSize );
+    SDL_memcpy( dst, &count, sizeof( uint32_t ) );
+    dst += sizeof( uint32_t );
+
+    // spans are captured as single sprites, they get queued and sorted when replayed
+    for ( const SpanData& span : spans.Spans ) {
+        for ( uint32_t i = 0; i < span.count; ++i )
+            write_captured_sprite( dst, span.texture, spans.Instances[span.first + i], false );
+    }
+
+    // interpolated sprites are captured where they were drawn
+    if ( spans.Interpolated != nullptr ) {
+        for ( const SpanData& span : spans.Interpolated->Spans ) {
+            for ( uint32_t i = 0; i < span.count; ++i ) {
+                const InterpolatedSpriteVertexUniform& instance = spans.Interpolated->Instances[span.first + i];
+                DXSM::Vector2                          position = DXSM::Vector2::Lerp( { instance.previous_x, instance.previous_y }, { instance.x, instance.y }, spans.InterpolationFactor );
+
+                SpriteVertexUniform info = {};
+                info.x                   = position.x;
+                info.y                   = position.y;
+                info.z                   = instance.z;
+                info.rotation            = instance.rotation;
+                info.scale_w             = instance.scale_w;
+                info.scale_h             = instance.scale_h;
+                info.source              = instance.source;
+                info.color               = instance.color;
+                write_captured_sprite( dst, span.texture, info, false );
+            }
+        }
+    }
+
+    // the bucket keys tell the opaque sprites, sort_commands() dropped them and everything is blended then
+    const auto& buckets = get_commandqueue()->get_buckets();
+    if ( buckets.empty() ) {
+        for ( const SpriteBatchInfo* sprite : commands )
+            write_captured_sprite( dst, sprite->texture, sprite->info, false );
+    }
+    else {
+        for ( const auto& bucket : buckets ) {
+            for ( uint32_t i = 0; i < bucket.Count; ++i ) {
+                const SpriteBatchInfo* sprite = commands[bucket.First + i];
+                write_captured_sprite( dst, sprite->texture, sprite->info, is_opaque_bucket( bucket.Key ) );
+            }
+        }
+    }
+}
+
+bool Sprite2DPipeline::replay_commands( const CommandStreamChunk& chunk )
+{
+    IE_ASSERT( m_initialized );
+
+    uint32_t count = 0;
+    if ( chunk.Size < sizeof( uint32_t ) )
+        return false;
+
+    SDL_memcpy( &count, chunk.Data, sizeof( uint32_t ) );
+    if ( chunk.Size != sizeof( uint32_t ) + static_cast<uint64_t>( count ) * CapturedSpriteSize )
+        return false;
+
+    auto         cmdQueue = get_commandqueue();
+    const Uint8* src      = chunk.Data + sizeof( uint32_t );
+    for ( uint32_t i = 0; i < count; ++i ) {
+        AssetUID<Sprite>    texture;
+        SpriteVertexUniform info;
+        uint8_t             opaqueFlag = 0;
+        SDL_memcpy( static_cast<void*>( &texture ), src, sizeof( AssetUID<Sprite> ) );
+        SDL_memcpy( &info, src + sizeof( AssetUID<Sprite> ), sizeof( SpriteVertexUniform ) );
+        SDL_memcpy( &opaqueFlag, src + sizeof( AssetUID<Sprite> ) + sizeof( SpriteVertexUniform ), sizeof( uint8_t ) );
+        src += CapturedSpriteSize;
+
+        // the capture only has the depth, the layer it came from is recovered for the bucket
+        // without a depthbuffer the opaque sprites are blended like when collecting them
+        bool             opaque = opaqueFlag != 0 && m_opaquePipelines[0] != nullptr;
+        uint16_t         layer  = static_cast<uint16_t>( std::lround( std::clamp( 1.0f - info.z, 0.0f, 1.0f ) * ( std::numeric_limits<uint16_t>::max )() ) );
+        SpriteBatchInfo* cmd    = cmdQueue->create_entry( layer, make_bucket_key( texture, opaque ) );
+        cmd->texture            = texture;
+        cmd->info               = info;
+    }
+    return true;
+}
+
+bool Sprite2DPipeline::hash_commands( CommandHasher& hasher ) const
+{
+    // the buckets carry whether the sprites are drawn opaque, the commands come in drawing order
+    auto cmdQueue = get_commandqueue();
+    for ( const CommandQueue::BucketRange& bucket : cmdQueue->get_buckets() ) {
+        hasher.add( bucket.Layer );
+        hasher.add( bucket.Key );
+        hasher.add( bucket.Count );
+    }
+
+    const auto& commands = cmdQueue->get_rendercommands();
+    hasher.add( commands.size() );
+    for ( const SpriteBatchInfo* sprite : commands ) {
+        hasher.add( sprite->texture.get_index() );
+        hasher.add( sprite->info );
+    }
+
+    const SpanFrame& spans = m_spanFrames[m_dispatchSlot];
+    for ( const SpanData& span : spans.Spans ) {
+        hasher.add( span.texture.get_index() );
+        hasher.add( span.count );
+    }
+    hasher.add( spans.Instances.data(), spans.Instances.size() * sizeof( SpriteVertexUniform ) );
+
+    // a version stands for the whole set of interpolated sprites, the factor only moves them when there are any
+    hasher.add( ( spans.Interpolated != nullptr ) ? spans.Interpolated->Version : 0 );
+    if ( spans.Interpolated != nullptr && spans.Interpolated->Instances.empty() == false )
+        hasher.add( spans.InterpolationFactor );
+    return true;
+}
+
+Sprite2DPipeline::InstanceFormat Sprite2DPipeline::get_instanceformat() const
+{
+    return m_instanceFormat;
+}
+
+uint32_t Sprite2DPipeline::get_instancestride() const
+{
+    return ( m_instanceFormat == InstanceFormat::Packed ) ? sizeof( PackedSpriteVertexUniform ) : sizeof( SpriteVertexUniform );
 }
 
 Sprite2DPipeline::CommandQueue* Sprite2DPipeline::get_commandqueue() const
@@ -210,58 +574,329 @@ Sprite2DPipeline::CommandQueue* Sprite2DPipeline::get_commandqueue() const
     return static_pointer_cast<Sprite2DPipeline::CommandQueue>( m_renderCmd ).get();
 }
 
-Sprite2DPipeline::BatchData* Sprite2DPipeline::add_batch()
+Sprite2DPipeline::FrameResources& Sprite2DPipeline::get_dispatching_frameresources()
 {
-    Sprite2DPipeline::BatchData& newbatch = m_batches.emplace_back();
-    newbatch.bufferIdx                    = find_free_gpubuffer();
+    IE_ASSERT( m_dispatchSlot < m_frameResources.size() );
+    return m_frameResources[m_dispatchSlot];
+}
+
+Sprite2DPipeline::BatchData* Sprite2DPipeline::add_batch( FrameResources& frame )
+{
+    Sprite2DPipeline::BatchData& newbatch = frame.Batches.emplace_back();
+    newbatch.bufferIdx                    = find_free_gpubuffer( frame );
     newbatch.count                        = 0;
+    newbatch.transferOffset               = 0;
+    newbatch.opaque                       = false;
+    newbatch.variant                      = 0;
 
     return &newbatch;
 }
 
-void Sprite2DPipeline::clear_batches()
+Sprite2DPipeline::BatchData* Sprite2DPipeline::continue_batch( FrameResources& frame, AssetUID<Sprite> texture, bool opaque, uint32_t writeOffset )
+{
+    // the instances are written back to back, so the last batch goes on as long as texture and pipeline stay the same
+    if ( frame.Batches.empty() == false ) {
+        BatchData& last = frame.Batches.back();
+        if ( last.texture == texture && last.opaque == opaque && last.count < SpriteBatchSizeMax )
+            return &last;
+    }
+
+    BatchData* batch      = add_batch( frame );
+    batch->texture        = texture;
+    batch->opaque         = opaque;
+    batch->transferOffset = writeOffset;
+    return batch;
+}
+
+void Sprite2DPipeline::write_commands( FrameResources& frame, SpriteBatchInfo* const* commands, size_t count, bool opaque, Uint8* dataPtr, uint32_t& writeOffset )
 {
-    m_batches.clear();
-    m_gpuBuffer_used = 0;
+    const uint32_t stride = get_instancestride();
+    for ( size_t i = 0; i < count; ++i ) {
+        const SpriteBatchInfo* sprite = commands[i];
+        BatchData*             batch  = continue_batch( frame, sprite->texture, opaque, writeOffset );
+
+        write_instance( dataPtr + writeOffset, sprite->info );
+        writeOffset    += stride;
+        batch->variant |= get_sprite_variant( sprite->info );
+        batch->count++;
+    }
 }
 
-uint32_t Sprite2DPipeline::find_free_gpubuffer()
+void Sprite2DPipeline::write_spans( FrameResources& frame, const SpanFrame& spans, Uint8* dataPtr, uint32_t& writeOffset )
 {
-    if ( m_gpuBuffer_used < m_gpuBuffer.size() )
-        return m_gpuBuffer_used++;
+    const uint32_t stride = get_instancestride();
+
+    for ( const SpanData& span : spans.Spans ) {
+        const SpriteVertexUniform* instances = spans.Instances.data() + span.first;
+        uint32_t                   remaining = span.count;
 
-    auto&                   buffer     = m_gpuBuffer.emplace_back();
+        while ( remaining > 0 ) {
+            BatchData* currentBatch = continue_batch( frame, span.texture, false, writeOffset );
+            uint32_t   count        = std::min<uint32_t>( remaining, SpriteBatchSizeMax - currentBatch->count );
+            for ( uint32_t i = 0; i < count && currentBatch->variant != ( VariantRotated | VariantTinted ); ++i )
+                currentBatch->variant |= get_sprite_variant( instances[i] );
+
+            if ( m_instanceFormat == InstanceFormat::Full ) {
+                SDL_memcpy( dataPtr + writeOffset, instances, count * sizeof( SpriteVertexUniform ) );
+            }
+            else {
+                for ( uint32_t i = 0; i < count; ++i )
+                    write_instance( dataPtr + writeOffset + i * stride, instances[i] );
+            }
+
+            writeOffset         += count * stride;
+            currentBatch->count += static_cast<uint16_t>( count );
+            instances           += count;
+            remaining           -= count;
+        }
+    }
+}
+
+void Sprite2DPipeline::write_instance( Uint8* dst, const SpriteVertexUniform& info ) const
+{
+    if ( m_instanceFormat == InstanceFormat::Full ) {
+        SDL_memcpy( dst, &info, sizeof( SpriteVertexUniform ) );
+        return;
+    }
+
+    using DirectX::PackedVector::XMConvertFloatToHalf;
+    constexpr float TwoPi = 6.28318530718f;
+
+    float turns = std::fmod( info.rotation, TwoPi ) / TwoPi;
+    if ( turns < 0.0f )
+        turns += 1.0f;
+
+    PackedSpriteVertexUniform packed = {};
+    packed.x                         = XMConvertFloatToHalf( info.x );
+    packed.y                         = XMConvertFloatToHalf( info.y );
+    packed.z                         = to_unorm16( info.z );
+    packed.rotation                  = static_cast<uint16_t>( static_cast<uint32_t>( turns * 65536.0f ) );    // a full turn wraps back to 0
+    packed.scale_w                   = XMConvertFloatToHalf( info.scale_w );
+    packed.scale_h                   = XMConvertFloatToHalf( info.scale_h );
+    packed.source[0]                 = to_unorm16( info.source.x );
+    packed.source[1]                 = to_unorm16( info.source.y );
+    packed.source[2]                 = to_unorm16( info.source.z );
+    packed.source[3]                 = to_unorm16( info.source.w );
+    packed.color                     = info.color.RGBA().v;
+    SDL_memcpy( dst, &packed, sizeof( PackedSpriteVertexUniform ) );
+}
+
+void Sprite2DPipeline::clear_batches( FrameResources& frame )
+{
+    frame.Batches.clear();
+    frame.GPUBufferUsed        = 0;
+    frame.InterpolatedPosition = 0;
+}
+
+bool Sprite2DPipeline::ensure_transferbuffer_size( FrameResources& frame, uint32_t size )
+{
+    if ( frame.TransferBuffer != nullptr && frame.TransferBufferSize >= size )
+        return true;
+
+    if ( frame.TransferBuffer != nullptr )
+        m_renderer->get_backend()->release_transferbuffer( frame.TransferBuffer );
+
+    SDL_GPUTransferBufferCreateInfo tbufferCreateInfo = {};
+    tbufferCreateInfo.usage                           = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD;
+    tbufferCreateInfo.size                            = size;
+
+    frame.TransferBuffer     = m_renderer->get_backend()->create_transferbuffer( &tbufferCreateInfo, "Sprite2DPipeline" );
+    frame.TransferBufferSize = ( frame.TransferBuffer != nullptr ) ? size : 0;
+    if ( frame.TransferBuffer == nullptr ) {
+        IE_LOG_ERROR( "Failed to create GPUTransferBuffer!" );
+        return false;
+    }
+    return true;
+}
+
+void Sprite2DPipeline::upload_interpolated_sprites( const SpanFrame& spans, SDL_GPUCopyPass* copyPass )
+{
+    uint64_t version = ( spans.Interpolated != nullptr ) ? spans.Interpolated->Version : 0;
+    if ( version == m_uploadedVersion )
+        return;
+
+    m_uploadedVersion = version;
+    m_interpolatedBatches.clear();
+    if ( spans.Interpolated == nullptr || spans.Interpolated->Instances.empty() )
+        return;
+
+    GPUBackend*                backend = m_renderer->get_backend();
+    const InterpolatedSprites& sprites = *spans.Interpolated;
+    uint32_t                   size    = static_cast<uint32_t>( sprites.Instances.size() * sizeof( InterpolatedSpriteVertexUniform ) );
+
+    // grown by half so a slowly growing set does not recreate the buffers every fixed update
+    if ( m_interpolatedBufferSize < size ) {
+        if ( m_interpolatedBuffer != nullptr )
+            backend->release_buffer( m_interpolatedBuffer );
+
+        SDL_GPUBufferCreateInfo createInfo = {};
+        createInfo.usage                   = SDL_GPU_BUFFERUSAGE_GRAPHICS_STORAGE_READ;
+        createInfo.size                    = size + size / 2;
+
+        m_interpolatedBuffer     = backend->create_buffer( &createInfo, "Sprite2DPipeline" );
+        m_interpolatedBufferSize = ( m_interpolatedBuffer != nullptr ) ? createInfo.size : 0;
+    }
+
+    if ( m_interpolatedTransferBufferSize < size ) {
+        if ( m_interpolatedTransferBuffer != nullptr )
+            backend->release_transferbuffer( m_interpolatedTransferBuffer );
+
+        SDL_GPUTransferBufferCreateInfo createInfo = {};
+        createInfo.usage                           = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD;
+        createInfo.size                            = size + size / 2;
+
+        m_interpolatedTransferBuffer     = backend->create_transferbuffer( &createInfo, "Sprite2DPipeline" );
+        m_interpolatedTransferBufferSize = ( m_interpolatedTransferBuffer != nullptr ) ? createInfo.size : 0;
+    }
+
+    if ( m_interpolatedBuffer == nullptr || m_interpolatedTransferBuffer == nullptr ) {
+        IE_LOG_ERROR( "Failed to create the buffers for %zu interpolated sprites!", sprites.Instances.size() );
+        return;
+    }
+
+    // frames in flight may still read the last upload, both buffers are cycled instead of waiting for them
+    Uint8* dataPtr = static_cast<Uint8*>( backend->map_transferbuffer( m_interpolatedTransferBuffer, true ) );
+    if ( dataPtr == nullptr ) {
+        IE_LOG_ERROR( "SDL_MapGPUTransferBuffer failed : %s", SDL_GetError() );
+        return;
+    }
+    SDL_memcpy( dataPtr, sprites.Instances.data(), size );
+    backend->unmap_transferbuffer( m_interpolatedTransferBuffer );
+
+    SDL_GPUTransferBufferLocation tranferBufferLocation { .transfer_buffer = m_interpolatedTransferBuffer, .offset = 0 };
+    SDL_GPUBufferRegion           bufferRegion { .buffer = m_interpolatedBuffer, .offset = 0, .size = size };
+    backend->upload_to_buffer( copyPass, &tranferBufferLocation, &bufferRegion, true );
+
+    RenderStats& stats = m_renderer->get_processing_stats();
+    stats.MappedBytes += size;
+
+    for ( const SpanData& span : sprites.Spans ) {
+        InterpolatedBatch& batch = m_interpolatedBatches.emplace_back();
+        batch.texture            = span.texture;
+        batch.first              = span.first;
+        batch.count              = span.count;
+        for ( uint32_t i = 0; i < span.count && batch.variant != ( VariantRotated | VariantTinted ); ++i )
+            batch.variant |= get_sprite_variant( sprites.Instances[span.first + i] );
+    }
+}
+
+uint32_t Sprite2DPipeline::find_free_gpubuffer( FrameResources& frame )
+{
+    if ( frame.GPUBufferUsed < frame.GPUBuffer.size() )
+        return frame.GPUBufferUsed++;
+
+    auto&                   buffer     = frame.GPUBuffer.emplace_back();
     SDL_GPUBufferCreateInfo createInfo = {};
     createInfo.usage                   = SDL_GPU_BUFFERUSAGE_GRAPHICS_STORAGE_READ;
-    createInfo.size                    = SpriteBatchSizeMax * sizeof( SpriteVertexUniform );
+    createInfo.size                    = SpriteBatchSizeMax * get_instancestride();
 
-    buffer = SDL_CreateGPUBuffer( m_renderer->get_gpudevice(), &createInfo );
+    buffer = m_renderer->get_backend()->create_buffer( &createInfo, "Sprite2DPipeline" );
     if ( buffer == nullptr ) {
         CoreAPI::get_application()->raise_critical_error( std::format( "SDL_CreateGPUBuffer failed : {0}", SDL_GetError() ) );
     }
-    return m_gpuBuffer_used++;
+    return frame.GPUBufferUsed++;
 }
 
-SDL_GPUBuffer* Sprite2DPipeline::get_gpubuffer_by_index( uint32_t index ) const
+SDL_GPUBuffer* Sprite2DPipeline::get_gpubuffer_by_index( const FrameResources& frame, uint32_t index ) const
 {
-    IE_ASSERT( index < m_gpuBuffer_used );
-    return m_gpuBuffer[index];
+    IE_ASSERT( index < frame.GPUBufferUsed );
+    return frame.GPUBuffer[index];
 }
 
-void Sprite2DPipeline::collect( AssetUID<Sprite> spriteUID, float x, float y, float angle, float scale_x, float scale_y, DXSM::Color color, uint16_t layer )
+void Sprite2DPipeline::collect( AssetUID<Sprite> spriteUID, float x, float y, float angle, float scale_x, float scale_y, DXSM::Color color, uint16_t layer, bool opaqueTexture )
 {
     IE_ASSERT( m_initialized );
     auto cmdQueue = get_commandqueue();
-    cmdQueue->grow_if_needed();
 
-    SpriteBatchInfo* cmd = cmdQueue->create_entry();
+    // without a depthbuffer everything is drawn in layer order
+    bool             opaque = opaqueTexture && color.A() >= 1.0f && m_opaquePipelines[0] != nullptr;
+    SpriteBatchInfo* cmd    = cmdQueue->create_entry( layer, make_bucket_key( spriteUID, opaque ) );
     cmd->texture         = spriteUID;
     cmd->info.x          = x;
     cmd->info.y          = y;
-    cmd->info.z          = 1.0f - ( ( layer == 0 ) ? 0.0f : static_cast<float>( layer ) / ( std::numeric_limits<uint16_t>::max )() );
+    cmd->info.z          = get_layer_depth( layer );
     cmd->info.rotation   = angle;
     cmd->info.scale_w    = scale_x;
     cmd->info.scale_h    = scale_y;
     cmd->info.source     = DXSM::Vector4 { 0.0f, 0.0f, 1.0f, 1.0f };
     cmd->info.color      = color;
 }
+
+std::span<Sprite2DPipeline::SpriteVertexUniform> Sprite2DPipeline::collect_span( AssetUID<Sprite> spriteUID, uint32_t count, uint16_t layer )
+{
+    IE_ASSERT( m_initialized );
+    if ( count == 0 )
+        return {};
+
+    SpanFrame& frame = m_spanFrames[m_spanCollectingSlot];
+    SpanData&  span  = frame.Spans.emplace_back();
+    span.texture     = spriteUID;
+    span.first       = static_cast<uint32_t>( frame.Instances.size() );
+    span.count       = count;
+
+    SpriteVertexUniform instance = {};
+    instance.z                   = get_layer_depth( layer );
+    instance.source              = DXSM::Vector4 { 0.0f, 0.0f, 1.0f, 1.0f };
+    instance.color               = DXSM::Color { 1.0f, 1.0f, 1.0f, 1.0f };
+    frame.Instances.resize( span.first + count, instance );
+
+    return { frame.Instances.data() + span.first, count };
+}
+
+void Sprite2DPipeline::clear_interpolated_spans()
+{
+    IE_ASSERT( m_initialized );
+
+    // the old set stays alive as long as a frame in flight draws it
+    m_interpolated          = std::make_shared<InterpolatedSprites>();
+    m_interpolated->Version = ++m_interpolatedVersion;
+    m_interpolatedSubmitted = false;
+}
+
+std::span<Sprite2DPipeline::InterpolatedSpriteVertexUniform> Sprite2DPipeline::collect_interpolated_span( AssetUID<Sprite> spriteUID, uint32_t count, uint16_t layer )
+{
+    IE_ASSERT( m_initialized );
+    if ( count == 0 )
+        return {};
+
+    if ( m_interpolated == nullptr ) {
+        clear_interpolated_spans();
+    }
+    else if ( m_interpolatedSubmitted ) {
+        m_interpolated          = std::make_shared<InterpolatedSprites>( *m_interpolated );
+        m_interpolated->Version = ++m_interpolatedVersion;
+        m_interpolatedSubmitted = false;
+    }
+
+    InterpolatedSprites& sprites = *m_interpolated;
+    SpanData&            span    = sprites.Spans.emplace_back();
+    span.texture                 = spriteUID;
+    span.first                   = static_cast<uint32_t>( sprites.Instances.size() );
+    span.count                   = count;
+
+    InterpolatedSpriteVertexUniform instance = {};
+    instance.z                               = get_layer_depth( layer );
+    instance.source                          = DXSM::Vector4 { 0.0f, 0.0f, 1.0f, 1.0f };
+    instance.color                           = DXSM::Color { 1.0f, 1.0f, 1.0f, 1.0f };
+    sprites.Instances.resize( span.first + count, instance );
+
+    return { sprites.Instances.data() + span.first, count };
+}
+
+void Sprite2DPipeline::set_interpolationfactor( float factor )
+{
+    m_interpolationFactor = std::clamp( factor, 0.0f, 1.0f );
+}
+
+float Sprite2DPipeline::get_layer_depth( uint16_t layer )
+{
+    return 1.0f - ( ( layer == 0 ) ? 0.0f : static_cast<float>( layer ) / ( std::numeric_limits<uint16_t>::max )() );
+}
+
+std::array<uint64_t, Sprite2DPipeline::VariantCount> Sprite2DPipeline::get_variant_drawcounts() const
+{
+    std::array<uint64_t, VariantCount> counts = {};
+    for ( uint32_t i = 0; i < VariantCount; ++i )
+        counts[i] = m_variantDraws[i].load( std::memory_order_relaxed );
+    return counts;
+}
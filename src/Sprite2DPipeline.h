@@ -11,18 +11,29 @@ namespace DXSM = DirectX::SimpleMath;
 #include "GPUPipeline.h"
 #include "RenderCommandBuffer.h"
 
+#include <array>
+#include <atomic>
 #include <string>
 #include <memory>
+#include <span>
 
 class Sprite2DPipeline : public GPUPipeline
 {
 public:
-    struct Vertex
+    enum class InstanceFormat
     {
-        float x = 0.0f, y = 0.0f, z = 0.0f;
-        float u = 0.0f, v = 0.0f;
+        Full,      // SpriteVertexUniform, 64 bytes per sprite
+        Packed     // PackedSpriteVertexUniform, 32 bytes per sprite
     };
 
+    // shader variants, every batch is drawn with the cheapest one that covers all of its sprites
+    enum SpriteVariant : uint8_t
+    {
+        VariantRotated = 1,    // SPRITE_ROTATED vertex shader, some sprite has a rotation
+        VariantTinted  = 2     // TextureXColor fragment shader, some sprite is not white
+    };
+    static constexpr uint32_t VariantCount = 4;
+
     struct SpriteVertexUniform
     {
         float         x, y, z, rotation;
@@ -31,6 +42,32 @@ public:
         DXSM::Color   color;
     };
 
+    // quantised version of SpriteVertexUniform, unpacked in SpriteBatch.vert.hlsl (SPRITE_PACKED)
+    // position and scale are half floats, they lose sub pixel precision from 1024 on (the spacing is 1.0 there),
+    // beyond that only integer positions are exact
+    struct PackedSpriteVertexUniform
+    {
+        uint16_t x, y;                // half
+        uint16_t z, rotation;         // unorm16, rotation is normalized to one full turn
+        uint16_t scale_w, scale_h;    // half
+        uint16_t source[4];           // unorm16
+        uint32_t color;               // rgba8
+        uint32_t padding_a, padding_b;
+    };
+    static_assert( sizeof( PackedSpriteVertexUniform ) == 32 );
+
+    // SpriteVertexUniform with the position of the previous fixed update in place of the padding,
+    // SpriteBatch.vert.hlsl (SPRITE_INTERPOLATED) blends between both by the interpolation factor of the frame.
+    // Always uploaded in this format, also by a packed pipeline.
+    struct InterpolatedSpriteVertexUniform
+    {
+        float         x, y, z, rotation;
+        float         scale_w, scale_h, previous_x, previous_y;
+        DXSM::Vector4 source;
+        DXSM::Color   color;
+    };
+    static_assert( sizeof( InterpolatedSpriteVertexUniform ) == sizeof( SpriteVertexUniform ) );
+
     struct SpriteBatchInfo
     {
         SpriteBatchInfo() = default;
@@ -48,43 +85,156 @@ public:
     struct BatchData
     {
         AssetUID<Sprite> texture;
-        uint16_t         bufferIdx = 0;
-        uint16_t         count     = 0;
+        uint16_t         bufferIdx      = 0;
+        uint16_t         count          = 0;
+        uint32_t         transferOffset = 0;
+        bool             opaque         = false;    // drawn with the opaque pipeline
+        uint8_t          variant        = 0;        // SpriteVariant flags of all sprites in the batch
+    };
+
+    // instances of one collect_span() call, stored in SpanFrame::Instances
+    struct SpanData
+    {
+        AssetUID<Sprite> texture;
+        uint32_t         first = 0;
+        uint32_t         count = 0;
     };
 
-    using CommandQueue = DoubleBufferedCommandQueue<SpriteBatchInfo>;
+    // instances of collect_interpolated_span(), shared with every frame that draws them until they get replaced
+    struct InterpolatedSprites
+    {
+        uint64_t                                     Version = 0;
+        std::vector<SpanData>                        Spans;
+        std::vector<InterpolatedSpriteVertexUniform> Instances;
+    };
+
+    // the interpolated sprites are uploaded once, in the order of their spans, and drawn with one draw call per span
+    struct InterpolatedBatch
+    {
+        AssetUID<Sprite> texture;
+        uint32_t         first   = 0;
+        uint32_t         count   = 0;
+        uint8_t          variant = 0;
+    };
+
+    // handed over between the collecting and the render thread like the command queues
+    struct SpanFrame
+    {
+        std::vector<SpanData>                      Spans;
+        std::vector<SpriteVertexUniform>           Instances;
+        std::shared_ptr<const InterpolatedSprites> Interpolated;
+        float                                      InterpolationFactor = 1.0f;
+    };
+
+    // gpu resources of one frame in flight, only reused after the frame fence was signaled
+    struct FrameResources
+    {
+        SDL_GPUTransferBuffer*      TransferBuffer     = nullptr;
+        uint32_t                    TransferBufferSize = 0;
+        std::vector<SDL_GPUBuffer*> GPUBuffer;
+        uint16_t                    GPUBufferUsed = 0;
+        std::vector<BatchData>      Batches;
+        size_t                      InterpolatedPosition = 0;    // the interpolated sprites are drawn before this batch
+    };
+
+    // bucketed by layer and texture, the commands are dispatched in drawing order without sorting them
+    using CommandQueue = BucketedCommandQueue<SpriteBatchInfo>;
 
 public:
-    Sprite2DPipeline() = default;
+    explicit Sprite2DPipeline( InstanceFormat format = InstanceFormat::Full );
     virtual ~Sprite2DPipeline();
 
     // Geerbt ber GPUPipeline
     bool init( GPURenderer* pRenderer ) override;
+    void submit( uint32_t nextFrameSlot ) override;
     void dispatch_copycommands( SDL_GPUCommandBuffer* cmdbuf, SDL_GPUCopyPass* renderPass ) override;
     void dispatch_rendercommands( const DXSM::Matrix& viewProjection, SDL_GPUCommandBuffer* cmdbuf, SDL_GPURenderPass* renderPass ) override;
 
     const std::string_view get_name() const override;
     void                   sort_commands() override;
     uint32_t               needs_processing() const override;
-
-    void collect( AssetUID<Sprite> spriteUID, float x, float y, float angle = 0.0f, float scale_x = 1.0f, float scale_y = 1.0f, DXSM::Color color = { 1.0f, 1.0f, 1.0f, 1.0f }, uint16_t layer = 0 );
+    void                   end_dispatch() override;
+    void                   capture_commands( CommandStreamWriter& writer ) override;
+    bool                   replay_commands( const CommandStreamChunk& chunk ) override;
+    bool                   hash_commands( CommandHasher& hasher ) const override;
+
+    InstanceFormat get_instanceformat() const;
+    uint32_t       get_instancestride() const;
+
+    // threadsafe, every collecting thread writes into its own queue
+    // with a depthbuffer sprites of an opaque texture without transparent color are drawn first, front to back and with depth write
+    void collect( AssetUID<Sprite> spriteUID, float x, float y, float angle = 0.0f, float scale_x = 1.0f, float scale_y = 1.0f, DXSM::Color color = { 1.0f, 1.0f, 1.0f, 1.0f }, uint16_t layer = 0,
+                  bool opaqueTexture = false );
+
+    // not threadsafe, call from the thread that submits the frames
+    // reserves count instances of one texture and layer that are copied into the upload memory as they are,
+    // without going through the command queue and the sort. Spans are drawn before the blended collected sprites in the order they were requested.
+    // The instances are initialized with the depth of the layer, no rotation, the full texture and white,
+    // position and scale (in pixels) have to be written. The span stays valid until the next call.
+    std::span<SpriteVertexUniform> collect_span( AssetUID<Sprite> spriteUID, uint32_t count, uint16_t layer = 0 );
+
+    // not threadsafe, call from the thread that submits the frames
+    // Interpolated spans are kept and drawn every frame after the spans, until clear_interpolated_spans() is called.
+    // So they only have to be written when the simulation advanced, and are only uploaded after such a change.
+    // The instances are initialized like the ones of collect_span(), position and previous position have to be written.
+    // The span stays valid until the next call.
+    void                                       clear_interpolated_spans();
+    std::span<InterpolatedSpriteVertexUniform> collect_interpolated_span( AssetUID<Sprite> spriteUID, uint32_t count, uint16_t layer = 0 );
+
+    // not threadsafe, call from the thread that submits the frames
+    // blend factor from the previous to the current position of the interpolated sprites in the collected frame
+    void set_interpolationfactor( float factor );
+
+    static float get_layer_depth( uint16_t layer );
+
+    // threadsafe, draw calls per SpriteVariant combination since the pipeline was created
+    std::array<uint64_t, VariantCount> get_variant_drawcounts() const;
 
 private:
-    BatchData* add_batch();
-    void       clear_batches();
-
-    uint32_t       find_free_gpubuffer();
-    SDL_GPUBuffer* get_gpubuffer_by_index( uint32_t index ) const;
+    bool       create_variant_pipelines( uint8_t variant, SDL_GPUShader* vertexShader, SDL_GPUShader* interpolatedVertexShader, SDL_GPUShader* fragmentShader );
+    BatchData* add_batch( FrameResources& frame );
+    BatchData* continue_batch( FrameResources& frame, AssetUID<Sprite> texture, bool opaque, uint32_t writeOffset );
+    void       write_commands( FrameResources& frame, SpriteBatchInfo* const* commands, size_t count, bool opaque, Uint8* dataPtr, uint32_t& writeOffset );
+    void       write_spans( FrameResources& frame, const SpanFrame& spans, Uint8* dataPtr, uint32_t& writeOffset );
+    void       write_instance( Uint8* dst, const SpriteVertexUniform& info ) const;
+    void       clear_batches( FrameResources& frame );
+    bool       ensure_transferbuffer_size( FrameResources& frame, uint32_t size );
+    void       upload_interpolated_sprites( const SpanFrame& spans, SDL_GPUCopyPass* copyPass );
+    void       draw_batches( std::span<const BatchData> batches, const FrameResources& frame, AssetRepository<Sprite>& spriteAssets, SDL_GPURenderPass* renderPass, SDL_GPUGraphicsPipeline*& bound );
+    void       draw_interpolated_sprites( float factor, AssetRepository<Sprite>& spriteAssets, SDL_GPUCommandBuffer* cmdbuf, SDL_GPURenderPass* renderPass, SDL_GPUGraphicsPipeline*& bound );
+
+    uint32_t       find_free_gpubuffer( FrameResources& frame );
+    SDL_GPUBuffer* get_gpubuffer_by_index( const FrameResources& frame, uint32_t index ) const;
 
     Sprite2DPipeline::CommandQueue* get_commandqueue() const;
+    FrameResources&                 get_dispatching_frameresources();
 
 private:
-    bool                                   m_initialized = false;
+    bool                                   m_initialized    = false;
+    InstanceFormat                         m_instanceFormat = InstanceFormat::Full;
     std::weak_ptr<AssetRepository<Sprite>> m_spriteAssets;
 
-    SDL_GPUTransferBuffer* m_spriteTransferBuffer = nullptr;
-
-    std::vector<SDL_GPUBuffer*>              m_gpuBuffer;
-    uint16_t                                 m_gpuBuffer_used = 0;
-    std::vector<Sprite2DPipeline::BatchData> m_batches;
+    // indexed by SpriteVariant flags, m_pipeline is the rotated and tinted one
+    std::array<SDL_GPUGraphicsPipeline*, VariantCount> m_variantPipelines = {};
+    std::array<SDL_GPUGraphicsPipeline*, VariantCount> m_opaquePipelines       = {};    // only with a depthbuffer
+    std::array<SDL_GPUGraphicsPipeline*, VariantCount> m_interpolatedPipelines = {};
+    std::array<std::atomic<uint64_t>, VariantCount>    m_variantDraws          = {};
+
+    std::vector<FrameResources> m_frameResources;
+    std::vector<SpanFrame>      m_spanFrames;
+    uint32_t                    m_spanCollectingSlot = 0;
+
+    // collecting thread, m_interpolated is copied before it gets changed once a frame holds it
+    std::shared_ptr<InterpolatedSprites> m_interpolated;
+    bool                                 m_interpolatedSubmitted = false;
+    uint64_t                             m_interpolatedVersion   = 0;
+    float                                m_interpolationFactor   = 1.0f;
+
+    // render thread, one buffer for all interpolated sprites that is cycled when it gets replaced
+    SDL_GPUBuffer*                 m_interpolatedBuffer             = nullptr;
+    uint32_t                       m_interpolatedBufferSize         = 0;
+    SDL_GPUTransferBuffer*         m_interpolatedTransferBuffer     = nullptr;
+    uint32_t                       m_interpolatedTransferBufferSize = 0;
+    uint64_t                       m_uploadedVersion                = 0;
+    std::vector<InterpolatedBatch> m_interpolatedBatches;
 };
@@ -0,0 +1,144 @@
+#include "iepch.h"
+#include "StagingRing.h"
+
+#include "GPUBackend.h"
+
+StagingRing::~StagingRing()
+{
+    release();
+}
+
+bool StagingRing::init( GPUBackend* backend, uint32_t size, uint32_t frameSlots )
+{
+    IE_ASSERT( backend != nullptr && size >= Alignment && frameSlots > 0 );
+    m_backend = backend;
+
+    SDL_GPUTransferBufferCreateInfo createInfo = {};
+    createInfo.usage                           = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD;
+    createInfo.size                            = size;
+
+    m_buffer = m_backend->create_transferbuffer( &createInfo, "StagingRing" );
+    if ( m_buffer == nullptr ) {
+        IE_LOG_ERROR( "Failed to create the staging ring GPUTransferBuffer!" );
+        return false;
+    }
+
+    m_size = size;
+    m_head = 0;
+    m_tail = 0;
+    m_frameEnd.assign( frameSlots, 0 );
+    return true;
+}
+
+void StagingRing::release()
+{
+    if ( m_backend == nullptr )
+        return;
+
+    for ( SDL_GPUTransferBuffer* buffer : m_overflowBuffers )
+        m_backend->release_transferbuffer( buffer );
+    m_overflowBuffers.clear();
+
+    if ( m_buffer ) {
+        m_backend->release_transferbuffer( m_buffer );
+        m_buffer = nullptr;
+    }
+    m_backend = nullptr;
+}
+
+void StagingRing::begin_frame( uint32_t frameSlot )
+{
+    IE_ASSERT( frameSlot < m_frameEnd.size() );
+    m_frameSlot = frameSlot;
+
+    // the last frame in this slot is done and every frame before it as well
+    m_tail = m_frameEnd[frameSlot];
+}
+
+void StagingRing::end_frame()
+{
+    m_frameEnd[m_frameSlot] = m_head;
+
+    // SDL keeps them alive until the gpu is done with the frame
+    for ( SDL_GPUTransferBuffer* buffer : m_overflowBuffers )
+        m_backend->release_transferbuffer( buffer );
+    m_overflowBuffers.clear();
+}
+
+void StagingRing::reclaim()
+{
+    m_tail = m_head;
+    std::fill( m_frameEnd.begin(), m_frameEnd.end(), m_head );
+
+    for ( SDL_GPUTransferBuffer* buffer : m_overflowBuffers )
+        m_backend->release_transferbuffer( buffer );
+    m_overflowBuffers.clear();
+}
+
+Uint8* StagingRing::begin_write( uint32_t size, Allocation& allocation )
+{
+    IE_ASSERT( m_buffer != nullptr && size > 0 );
+    m_writtenBytes += size;
+
+    uint64_t alignedSize = ( static_cast<uint64_t>( size ) + Alignment - 1 ) & ~static_cast<uint64_t>( Alignment - 1 );
+    uint64_t position    = m_head;
+    uint64_t offset      = position % m_size;
+
+    // allocations never wrap around the end of the buffer
+    if ( offset + alignedSize > m_size )
+        position += m_size - offset;
+
+    if ( position + alignedSize - m_tail <= m_size ) {
+        allocation.TransferBuffer = m_buffer;
+        allocation.Offset         = static_cast<uint32_t>( position % m_size );
+        m_head                    = position + alignedSize;
+
+        // the gpu may still read other parts of the ring, the written part is not in use
+        Uint8* data = static_cast<Uint8*>( m_backend->map_transferbuffer( m_buffer, false ) );
+        if ( data == nullptr ) {
+            IE_LOG_ERROR( "SDL_MapGPUTransferBuffer failed : %s", SDL_GetError() );
+            return nullptr;
+        }
+        return data + allocation.Offset;
+    }
+
+    if ( m_overflowCount.fetch_add( 1, std::memory_order_relaxed ) == 0 )
+        IE_LOG_WARNING( "Staging ring of %u bytes is full, consider making it bigger", m_size );
+
+    SDL_GPUTransferBufferCreateInfo createInfo = {};
+    createInfo.usage                           = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD;
+    createInfo.size                            = size;
+
+    allocation.TransferBuffer = m_backend->create_transferbuffer( &createInfo, "StagingRing" );
+    allocation.Offset         = 0;
+    if ( allocation.TransferBuffer == nullptr ) {
+        IE_LOG_ERROR( "Failed to create GPUTransferBuffer!" );
+        return nullptr;
+    }
+    m_overflowBuffers.push_back( allocation.TransferBuffer );
+
+    Uint8* data = static_cast<Uint8*>( m_backend->map_transferbuffer( allocation.TransferBuffer, false ) );
+    if ( data == nullptr )
+        IE_LOG_ERROR( "SDL_MapGPUTransferBuffer failed : %s", SDL_GetError() );
+    return data;
+}
+
+void StagingRing::end_write( const Allocation& allocation )
+{
+    m_backend->unmap_transferbuffer( allocation.TransferBuffer );
+}
+
+uint32_t StagingRing::get_size() const
+{
+    return m_size;
+}
+
+uint64_t StagingRing::get_overflow_count() const
+{
+    return m_overflowCount.load( std::memory_order_relaxed );
+}
+
+uint64_t StagingRing::get_written_bytes() const
+{
+    return m_writtenBytes;
+}
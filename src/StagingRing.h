@@ -0,0 +1,66 @@
+#pragma once
+#include "SDL3/SDL_gpu.h"
+
+#include <atomic>
+#include <vector>
+
+class GPUBackend;
+
+// Upload memory shared by everything that uploads small amounts of data each frame.
+// Allocations are sub-allocated from one upload transfer buffer that is used as a ring. The memory of a frame is
+// reclaimed once the fence of its frame slot signaled, the frames finish in order so the ring only has one tail.
+// When the ring is full a transfer buffer of its own is created for the allocation and released after the frame.
+// Render thread only, except for get_overflow_count().
+class StagingRing
+{
+public:
+    struct Allocation
+    {
+        SDL_GPUTransferBuffer* TransferBuffer = nullptr;
+        uint32_t               Offset         = 0;
+    };
+
+    // D3D12 needs texture uploads at this alignment, SDL copies unaligned ones again
+    static constexpr uint32_t Alignment = 512;
+
+    StagingRing() = default;
+    ~StagingRing();
+
+    StagingRing( const StagingRing& other )            = delete;
+    StagingRing( StagingRing&& other )                 = delete;
+    StagingRing& operator=( const StagingRing& other ) = delete;
+    StagingRing& operator=( StagingRing&& other )      = delete;
+
+    bool init( GPUBackend* backend, uint32_t size, uint32_t frameSlots );
+    void release();
+
+    // the fence of the frame slot has to be signaled
+    void begin_frame( uint32_t frameSlot );
+    // call after the commandbuffer of the frame was submitted
+    void end_frame();
+    // the gpu has to be idle, frees the whole ring
+    void reclaim();
+
+    // reserves and maps size bytes, end_write() has to be called before the allocation is used in a copy pass
+    Uint8* begin_write( uint32_t size, Allocation& allocation );
+    void   end_write( const Allocation& allocation );
+
+    uint32_t get_size() const;
+    uint64_t get_overflow_count() const;
+    uint64_t get_written_bytes() const;    // handed out by begin_write since creation
+
+private:
+    GPUBackend*            m_backend = nullptr;
+    SDL_GPUTransferBuffer* m_buffer  = nullptr;
+    uint32_t               m_size    = 0;
+
+    // monotonic byte positions, the offset in the buffer is position % m_size
+    uint64_t              m_head = 0;
+    uint64_t              m_tail = 0;
+    std::vector<uint64_t> m_frameEnd;    // head at the end of the frame that last used the slot
+    uint32_t              m_frameSlot    = 0;
+    uint64_t              m_writtenBytes = 0;
+
+    std::vector<SDL_GPUTransferBuffer*> m_overflowBuffers;    // released at the end of the frame
+    std::atomic<uint64_t>               m_overflowCount = 0;
+};
@@ -6,6 +6,7 @@
 #include "Application.h"
 #include "Renderer.h"
 #include "Sprite2DPipeline.h"
+#include "TileMapPipeline.h"
 #include "AssetManager.h"
 #include "Window.h"
 
@@ -21,12 +22,21 @@ TetrisGameScene::TetrisGameScene()
     m_tileSprite       = tileSpriteOpt.value();
     m_tileSprite.get()->create_device_ressources( CoreAPI::get_gpurenderer() );
 
+    auto tileMapOpt = CoreAPI::get_gpurenderer()->require_pipeline<TileMapPipeline>();
+    m_tileMap       = tileMapOpt.value();
+    m_tileMap->set_renderorder( -1 );    // the board lies below all sprites
+
+    auto spritePipelineOpt = CoreAPI::get_gpurenderer()->require_pipeline<Sprite2DPipeline>();
+    m_spritePipeline       = spritePipelineOpt.value();
+
     create_playingfield( 10, 20 );
     m_nextTetromino = static_cast<TetrominoType>( m_tetrominoDistribution( m_rngEngine ) );
 }
 
 TetrisGameScene::~TetrisGameScene()
 {
+    // the pipeline outlives the scene and would keep drawing the effect
+    m_spritePipeline->clear_interpolated_spans();
     destroy_playingfield();
 }
 
@@ -131,6 +141,8 @@ void TetrisGameScene::check_row_completion()
 
 void TetrisGameScene::update_fallout_effect( double deltaTime )
 {
+    m_falloutChanged = m_falloutChanged || m_removedElements.empty() == false;
+
     int  min    = 0 - m_tileSprite.get()->get_width();
     auto elemIt = m_removedElements.begin();
     while ( elemIt != m_removedElements.end() ) {
@@ -150,27 +162,31 @@ void TetrisGameScene::render_field()
 {
     const std::shared_ptr<Sprite> sprite = m_tileSprite.get();
 
-    // render playing field borders
-    DXSM::Color borderColorModifier { 0.8f, 0.8f, 0.8f, 1.0f };
-    for ( int x = 1; x < get_total_width() - 1; x++ ) {
-        sprite->render( static_cast<float>( x * m_tileSprite.get()->get_width() ), 0.0f, borderColorModifier );
-        sprite->render( static_cast<float>( x * m_tileSprite.get()->get_width() ), static_cast<float>( ( get_total_height() - 1 ) * m_tileSprite.get()->get_height() ), borderColorModifier );
-    }
+    int totalWidth  = get_total_width();
+    int totalHeight = get_total_height();
+    m_boardCells.assign( static_cast<size_t>( totalWidth ) * totalHeight, 0 );
 
-    for ( int y = 0; y < get_total_height(); y++ ) {
-        sprite->render( 0.0f, static_cast<float>( y * m_tileSprite.get()->get_height() ), borderColorModifier );
-        sprite->render( static_cast<float>( ( get_total_width() - 1 ) * m_tileSprite.get()->get_width() ), static_cast<float>( y * m_tileSprite.get()->get_height() ), borderColorModifier );
+    // playing field borders
+    DXSM::Color borderColorModifier { 0.8f, 0.8f, 0.8f, 1.0f };
+    for ( int y = 0; y < totalHeight; y++ ) {
+        for ( int x = 0; x < totalWidth; x++ ) {
+            if ( x < m_borderThickness || y < m_borderThickness || x >= totalWidth - m_borderThickness || y >= totalHeight - m_borderThickness )
+                m_boardCells[y * totalWidth + x] = borderColorModifier.RGBA().v;
+        }
     }
 
-    // render static elements
+    // static elements
     for ( int y = 0; y < get_field_height(); y++ ) {
         for ( int x = 0; x < get_field_width(); x++ ) {
             if ( m_gameField[y * get_field_width() + x].Active ) {
-                sprite->render( static_cast<float>( ( x + m_borderThickness ) * m_tileSprite.get()->get_width() ), static_cast<float>( ( y + m_borderThickness ) * m_tileSprite.get()->get_height() ),
-                                m_gameField[y * get_field_width() + x].Color );
+                m_boardCells[( y + m_borderThickness ) * totalWidth + x + m_borderThickness] = m_gameField[y * get_field_width() + x].Color.RGBA().v;
             }
         }
     }
+
+    // only uploaded when a cell changed
+    m_tileMap->collect( sprite->get_uid(), m_boardCells.data(), static_cast<uint16_t>( totalWidth ), static_cast<uint16_t>( totalHeight ), 0.0f, 0.0f, static_cast<float>( sprite->get_width() ),
+                        static_cast<float>( sprite->get_height() ) );
 }
 
 int TetrisGameScene::get_field_width() const
@@ -308,10 +324,27 @@ void TetrisGameScene::interpolate_and_create_rendercommands( float interpFactor,
         }
     }
 
-    // render effects
-    for ( const auto& elem : m_removedElements ) {
-        DXSM::Vector2 interpolated = DXSM::Vector2::Lerp( elem.Position, elem.PositionNext, interpFactor );
-        sprite->render( static_cast<float>( interpolated.x ), static_cast<float>( interpolated.y ), elem.Color );
+    // render effects, the elements only move with the fixed update and the vertex shader interpolates between their positions
+    m_spritePipeline->set_interpolationfactor( interpFactor );
+    if ( m_falloutChanged == false )
+        return;
+
+    m_falloutChanged = false;
+    m_spritePipeline->clear_interpolated_spans();
+
+    // all elements share texture and layer so they are written in one go
+    auto  instances = m_spritePipeline->collect_interpolated_span( sprite->get_uid(), static_cast<uint32_t>( m_removedElements.size() ) );
+    float width     = static_cast<float>( sprite->get_width() );
+    float height    = static_cast<float>( sprite->get_height() );
+    for ( size_t i = 0; i < instances.size(); ++i ) {
+        const RemovedElement& elem = m_removedElements[i];
+        instances[i].previous_x    = elem.Position.x;
+        instances[i].previous_y    = elem.Position.y;
+        instances[i].x             = elem.PositionNext.x;
+        instances[i].y             = elem.PositionNext.y;
+        instances[i].scale_w       = width;
+        instances[i].scale_h       = height;
+        instances[i].color         = elem.Color;
     }
 }
 
@@ -7,6 +7,8 @@ namespace DXSM = DirectX::SimpleMath;
 #include "Tetromino.h"
 #include "Sprite.h"
 #include "AssetManager.h"
+#include "TileMapPipeline.h"
+#include "Sprite2DPipeline.h"
 
 #include <memory>
 #include <cstdint>
@@ -46,7 +48,7 @@ public:
     void check_row_completion();
     void update_fallout_effect( double deltaTime );
 
-    void render_field();    // render the static parts
+    void render_field();    // render the static parts, the borders and the fused elements are one tile map
 
     int get_field_width() const;     // Width of GameField in elements
     int get_field_height() const;    // Height of GameField + Spawnarea in elements
@@ -79,8 +81,12 @@ private:
     bool m_keyDown_D = false;
     bool m_keyDown_R = false;
 
-    AssetView<Sprite> m_tileSprite;
+    AssetView<Sprite>                  m_tileSprite;
+    std::shared_ptr<TileMapPipeline>   m_tileMap;
+    std::vector<TileMapPipeline::Cell> m_boardCells;
+    std::shared_ptr<Sprite2DPipeline>  m_spritePipeline;
 
     DXSM::Vector2               m_gravityAccel = { 0.0f, 600.0f };
     std::vector<RemovedElement> m_removedElements;
+    bool                        m_falloutChanged = false;    // the interpolated sprites of the effect have to be written again
 };
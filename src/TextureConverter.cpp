@@ -0,0 +1,333 @@
+#include "iepch.h"
+
+#include "SDL3_image/SDL_image.h"
+
+#include "CompressedTexture.h"
+
+// Converts an image into a block compressed DDS file with a full mip chain, so the sprite can be uploaded without decoding it.
+// usage: TextureConverter <input> <output.dds> [--bc1 | --bc3] [--no-mips]
+// Without a format, opaque images become BC1 and everything else BC3. BC1 keeps 1 bit alpha, texels below 128 turn transparent.
+// The encoder fits the endpoints to the principal axis of each block, it is meant for sprite art and not for the best quality.
+// BC7 files of other tools (e.g. texconv -f BC7_UNORM) can be loaded by the game as well.
+
+struct Color
+{
+    float R = 0.0f, G = 0.0f, B = 0.0f;
+};
+
+static uint16_t to_rgb565( const Color& color )
+{
+    uint32_t r = static_cast<uint32_t>( std::clamp( color.R, 0.0f, 255.0f ) * 31.0f / 255.0f + 0.5f );
+    uint32_t g = static_cast<uint32_t>( std::clamp( color.G, 0.0f, 255.0f ) * 63.0f / 255.0f + 0.5f );
+    uint32_t b = static_cast<uint32_t>( std::clamp( color.B, 0.0f, 255.0f ) * 31.0f / 255.0f + 0.5f );
+    return static_cast<uint16_t>( ( r << 11 ) | ( g << 5 ) | b );
+}
+
+static Color from_rgb565( uint16_t value )
+{
+    return { static_cast<float>( ( value >> 11 ) & 31 ) * 255.0f / 31.0f, static_cast<float>( ( value >> 5 ) & 63 ) * 255.0f / 63.0f, static_cast<float>( value & 31 ) * 255.0f / 31.0f };
+}
+
+static Color lerp( const Color& a, const Color& b, float t )
+{
+    return { a.R + ( b.R - a.R ) * t, a.G + ( b.G - a.G ) * t, a.B + ( b.B - a.B ) * t };
+}
+
+static float distance_squared( const Color& a, const Color& b )
+{
+    return ( a.R - b.R ) * ( a.R - b.R ) + ( a.G - b.G ) * ( a.G - b.G ) + ( a.B - b.B ) * ( a.B - b.B );
+}
+
+// block is 4x4 rgba texels, transparent texels are ignored for the endpoints
+// with allowTransparent the 3 color mode is used for blocks with transparent texels, index 3 is transparent black
+static void encode_colorblock( const Uint8* block, bool allowTransparent, Uint8* output )
+{
+    Color colors[16];
+    bool  transparent[16];
+    bool  anyTransparent = false;
+    Color mean;
+    int   count = 0;
+    for ( int i = 0; i < 16; ++i ) {
+        colors[i]      = { static_cast<float>( block[i * 4 + 0] ), static_cast<float>( block[i * 4 + 1] ), static_cast<float>( block[i * 4 + 2] ) };
+        transparent[i] = allowTransparent && block[i * 4 + 3] < 128;
+        anyTransparent = anyTransparent || transparent[i];
+        if ( transparent[i] == false ) {
+            mean.R += colors[i].R;
+            mean.G += colors[i].G;
+            mean.B += colors[i].B;
+            ++count;
+        }
+    }
+
+    uint16_t endpoint0 = 0;
+    uint16_t endpoint1 = 0;
+    if ( count > 0 ) {
+        mean = { mean.R / count, mean.G / count, mean.B / count };
+
+        // principal axis of the colors by power iteration on their covariance
+        float covariance[6] = {};
+        for ( int i = 0; i < 16; ++i ) {
+            if ( transparent[i] )
+                continue;
+            float r = colors[i].R - mean.R, g = colors[i].G - mean.G, b = colors[i].B - mean.B;
+            covariance[0] += r * r;
+            covariance[1] += r * g;
+            covariance[2] += r * b;
+            covariance[3] += g * g;
+            covariance[4] += g * b;
+            covariance[5] += b * b;
+        }
+
+        Color axis = { 1.0f, 1.0f, 1.0f };
+        for ( int iteration = 0; iteration < 8; ++iteration ) {
+            Color next  = { covariance[0] * axis.R + covariance[1] * axis.G + covariance[2] * axis.B,
+                            covariance[1] * axis.R + covariance[3] * axis.G + covariance[4] * axis.B,
+                            covariance[2] * axis.R + covariance[4] * axis.G + covariance[5] * axis.B };
+            float length = std::max( { std::abs( next.R ), std::abs( next.G ), std::abs( next.B ) } );
+            if ( length <= 0.0f )
+                break;
+            axis = { next.R / length, next.G / length, next.B / length };
+        }
+
+        float minProjection = std::numeric_limits<float>::max();
+        float maxProjection = std::numeric_limits<float>::lowest();
+        Color minColor, maxColor;
+        for ( int i = 0; i < 16; ++i ) {
+            if ( transparent[i] )
+                continue;
+            float projection = colors[i].R * axis.R + colors[i].G * axis.G + colors[i].B * axis.B;
+            if ( projection < minProjection ) {
+                minProjection = projection;
+                minColor      = colors[i];
+            }
+            if ( projection > maxProjection ) {
+                maxProjection = projection;
+                maxColor      = colors[i];
+            }
+        }
+
+        endpoint0 = to_rgb565( maxColor );
+        endpoint1 = to_rgb565( minColor );
+    }
+
+    // endpoint0 > endpoint1 selects the 4 color mode, the 3 color mode is the other way around
+    bool threeColors = anyTransparent;
+    if ( ( threeColors && endpoint0 > endpoint1 ) || ( threeColors == false && endpoint0 < endpoint1 ) )
+        std::swap( endpoint0, endpoint1 );
+
+    Color palette[4];
+    int   paletteSize = threeColors ? 3 : 4;
+    palette[0] = from_rgb565( endpoint0 );
+    palette[1] = from_rgb565( endpoint1 );
+    if ( threeColors ) {
+        palette[2] = lerp( palette[0], palette[1], 0.5f );
+    }
+    else {
+        palette[2] = lerp( palette[0], palette[1], 1.0f / 3.0f );
+        palette[3] = lerp( palette[0], palette[1], 2.0f / 3.0f );
+    }
+
+    uint32_t indices = 0;
+    for ( int i = 0; i < 16; ++i ) {
+        uint32_t best = 3;
+        if ( transparent[i] == false ) {
+            // equal endpoints in the 4 color mode all decode to the first one
+            best           = 0;
+            float bestDist = distance_squared( colors[i], palette[0] );
+            for ( int p = 1; p < paletteSize && endpoint0 != endpoint1; ++p ) {
+                float dist = distance_squared( colors[i], palette[p] );
+                if ( dist < bestDist ) {
+                    bestDist = dist;
+                    best     = static_cast<uint32_t>( p );
+                }
+            }
+        }
+        indices |= best << ( i * 2 );
+    }
+
+    SDL_memcpy( output, &endpoint0, 2 );
+    SDL_memcpy( output + 2, &endpoint1, 2 );
+    SDL_memcpy( output + 4, &indices, 4 );
+}
+
+// BC3 alpha block, 8 interpolated values between the smallest and the largest alpha
+static void encode_alphablock( const Uint8* block, Uint8* output )
+{
+    Uint8 alpha0 = 0;
+    Uint8 alpha1 = 255;
+    for ( int i = 0; i < 16; ++i ) {
+        alpha0 = std::max( alpha0, block[i * 4 + 3] );
+        alpha1 = std::min( alpha1, block[i * 4 + 3] );
+    }
+
+    float palette[8];
+    palette[0] = alpha0;
+    palette[1] = alpha1;
+    for ( int p = 1; p < 7; ++p )
+        palette[p + 1] = ( ( 7 - p ) * alpha0 + p * alpha1 ) / 7.0f;
+
+    uint64_t indices = 0;
+    for ( int i = 0; i < 16; ++i ) {
+        uint64_t best     = 0;
+        float    bestDist = std::abs( block[i * 4 + 3] - palette[0] );
+        for ( int p = 1; p < 8 && alpha0 != alpha1; ++p ) {
+            float dist = std::abs( block[i * 4 + 3] - palette[p] );
+            if ( dist < bestDist ) {
+                bestDist = dist;
+                best     = static_cast<uint64_t>( p );
+            }
+        }
+        indices |= best << ( i * 3 );
+    }
+
+    output[0] = alpha0;
+    output[1] = alpha1;
+    SDL_memcpy( output + 2, &indices, 6 );    // little endian, the upper 16 bits are unused
+}
+
+static std::vector<Uint8> encode_level( const std::vector<Uint8>& pixels, uint32_t width, uint32_t height, SDL_GPUTextureFormat format )
+{
+    uint32_t           blockSize = CompressedTexture::get_blocksize( format );
+    std::vector<Uint8> output( CompressedTexture::get_levelsize( format, width, height ) );
+    Uint8*             dst = output.data();
+
+    for ( uint32_t blockY = 0; blockY < height; blockY += 4 ) {
+        for ( uint32_t blockX = 0; blockX < width; blockX += 4 ) {
+            // blocks at the border repeat the last row and column
+            Uint8 block[16 * 4];
+            for ( uint32_t y = 0; y < 4; ++y ) {
+                for ( uint32_t x = 0; x < 4; ++x ) {
+                    uint32_t sx = std::min( blockX + x, width - 1 );
+                    uint32_t sy = std::min( blockY + y, height - 1 );
+                    SDL_memcpy( block + ( y * 4 + x ) * 4, pixels.data() + ( sy * width + sx ) * 4, 4 );
+                }
+            }
+
+            if ( format == SDL_GPU_TEXTUREFORMAT_BC3_RGBA_UNORM ) {
+                encode_alphablock( block, dst );
+                encode_colorblock( block, false, dst + 8 );
+            }
+            else {
+                encode_colorblock( block, true, dst );
+            }
+            dst += blockSize;
+        }
+    }
+    return output;
+}
+
+static std::vector<Uint8> downsample( const std::vector<Uint8>& pixels, uint32_t width, uint32_t height, uint32_t& outWidth, uint32_t& outHeight )
+{
+    outWidth  = std::max( width / 2, 1u );
+    outHeight = std::max( height / 2, 1u );
+
+    std::vector<Uint8> output( outWidth * outHeight * 4 );
+    for ( uint32_t y = 0; y < outHeight; ++y ) {
+        for ( uint32_t x = 0; x < outWidth; ++x ) {
+            uint32_t x0 = std::min( x * 2, width - 1 ), x1 = std::min( x * 2 + 1, width - 1 );
+            uint32_t y0 = std::min( y * 2, height - 1 ), y1 = std::min( y * 2 + 1, height - 1 );
+            for ( uint32_t channel = 0; channel < 4; ++channel ) {
+                uint32_t sum = pixels[( y0 * width + x0 ) * 4 + channel] + pixels[( y0 * width + x1 ) * 4 + channel] + pixels[( y1 * width + x0 ) * 4 + channel] +
+                               pixels[( y1 * width + x1 ) * 4 + channel];
+                output[( y * outWidth + x ) * 4 + channel] = static_cast<Uint8>( ( sum + 2 ) / 4 );
+            }
+        }
+    }
+    return output;
+}
+
+static bool convert( const std::filesystem::path& input, const std::filesystem::path& output, SDL_GPUTextureFormat format, bool mips )
+{
+    SDL_Surface* image = IMG_Load( input.string().c_str() );
+    if ( image == nullptr ) {
+        IE_LOG_ERROR( "Could not load %s : %s", input.string().c_str(), SDL_GetError() );
+        return false;
+    }
+
+    SDL_Surface* rgba = SDL_ConvertSurface( image, SDL_PIXELFORMAT_RGBA32 );
+    SDL_DestroySurface( image );
+    if ( rgba == nullptr ) {
+        IE_LOG_ERROR( "Could not convert %s : %s", input.string().c_str(), SDL_GetError() );
+        return false;
+    }
+
+    uint32_t           width  = static_cast<uint32_t>( rgba->w );
+    uint32_t           height = static_cast<uint32_t>( rgba->h );
+    std::vector<Uint8> pixels( width * height * 4 );
+    for ( uint32_t y = 0; y < height; ++y )
+        SDL_memcpy( pixels.data() + y * width * 4, static_cast<const Uint8*>( rgba->pixels ) + y * rgba->pitch, width * 4 );
+    SDL_DestroySurface( rgba );
+
+    bool opaque = true;
+    for ( uint32_t i = 0; i < width * height && opaque; ++i )
+        opaque = pixels[i * 4 + 3] == 255;
+
+    if ( format == SDL_GPU_TEXTUREFORMAT_INVALID )
+        format = opaque ? SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM : SDL_GPU_TEXTUREFORMAT_BC3_RGBA_UNORM;
+
+    CompressedTexture texture( format, width, height );
+    texture.set_opaque( opaque );
+
+    while ( true ) {
+        std::vector<Uint8> level = encode_level( pixels, width, height, format );
+        texture.add_level( level.data(), static_cast<uint32_t>( level.size() ) );
+        if ( mips == false || ( width == 1 && height == 1 ) )
+            break;
+
+        pixels = downsample( pixels, width, height, width, height );
+    }
+
+    if ( texture.save_dds( output ) == false )
+        return false;
+
+    IE_LOG_INFO( "TextureConverter: %s -> %s, %s with %u levels, %u bytes",
+                 input.string().c_str(),
+                 output.string().c_str(),
+                 ( format == SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM ) ? "BC1" : "BC3",
+                 static_cast<uint32_t>( texture.get_levels().size() ),
+                 static_cast<uint32_t>( texture.get_data().size() ) );
+    return true;
+}
+
+int main( int argc, char** argv )
+{
+    std::filesystem::path input, output;
+    SDL_GPUTextureFormat  format = SDL_GPU_TEXTUREFORMAT_INVALID;
+    bool                  mips   = true;
+
+    for ( int i = 1; i < argc; ++i ) {
+        std::string_view arg = argv[i];
+        if ( arg == "--bc1" ) {
+            format = SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM;
+        }
+        else if ( arg == "--bc3" ) {
+            format = SDL_GPU_TEXTUREFORMAT_BC3_RGBA_UNORM;
+        }
+        else if ( arg == "--no-mips" ) {
+            mips = false;
+        }
+        else if ( input.empty() ) {
+            input = argv[i];
+        }
+        else if ( output.empty() ) {
+            output = argv[i];
+        }
+        else {
+            IE_LOG_WARNING( "Unknown commandline argument %s", argv[i] );
+        }
+    }
+
+    if ( input.empty() || output.empty() ) {
+        IE_LOG_CRITICAL( "usage: TextureConverter <input> <output.dds> [--bc1 | --bc3] [--no-mips]" );
+        return 1;
+    }
+
+    if ( !SDL_Init( 0 ) ) {
+        IE_LOG_CRITICAL( "Failed to initialize SDL" );
+        return 1;
+    }
+
+    int result = convert( input, output, format, mips ) ? 0 : 1;
+    SDL_Quit();
+    return result;
+}
@@ -0,0 +1,301 @@
+#include "iepch.h"
+#include "TileMapPipeline.h"
+
+#include "AssetManager.h"
+#include "CoreAPI.h"
+#include "Renderer.h"
+#include "Shader.h"
+#include "Sprite.h"
+#include "Window.h"
+#include "CommandHash.h"
+
+TileMapPipeline::~TileMapPipeline()
+{
+    if ( m_renderer == nullptr )
+        return;
+
+    GPUBackend* backend = m_renderer->get_backend();
+    m_frames.clear();
+
+    if ( m_cellTexture ) {
+        backend->release_texture( m_cellTexture );
+        m_cellTexture = nullptr;
+    }
+}
+
+bool TileMapPipeline::init( GPURenderer* pRenderer )
+{
+    IE_ASSERT( pRenderer != nullptr );
+
+    if ( m_initialized ) {
+        IE_LOG_WARNING( "Pipeline already initialized!" );
+        return true;
+    }
+
+    m_renderer          = pRenderer;
+    GPUBackend* backend = m_renderer->get_backend();
+
+    auto shaderRepo = CoreAPI::get_assetmanager()->get_repository<Shader>();
+    IE_ASSERT( shaderRepo != nullptr );
+
+    auto vertexShaderAsset = shaderRepo->require_asset( pRenderer->add_shaderformat_fileextension( "TileMap.vert" ) );
+    if ( vertexShaderAsset.has_value() == false ) {
+        IE_LOG_ERROR( "Vertex Shader not found!" );
+        return false;
+    }
+
+    auto fragmentShaderAsset = shaderRepo->require_asset( pRenderer->add_shaderformat_fileextension( "TileMap.frag" ) );
+    if ( fragmentShaderAsset.has_value() == false ) {
+        IE_LOG_ERROR( "Fragment Shader not found!" );
+        return false;
+    }
+
+    AssetView<Shader>& vertexShader   = vertexShaderAsset.value();
+    AssetView<Shader>& fragmentShader = fragmentShaderAsset.value();
+
+    // vertex: view projection and map uniforms, fragment: tile and cell texture
+    IE_ASSERT( vertexShader.get()->create_device_ressources( pRenderer, { 0, 0, 0, 2 } ) );
+    IE_ASSERT( fragmentShader.get()->create_device_ressources( pRenderer, { 2, 0, 0, 0 } ) );
+
+    SDL_GPUColorTargetDescription colorTargets[1]     = {};
+    colorTargets[0].format                            = backend->get_swapchain_textureformat( m_renderer->has_window() ? m_renderer->get_window()->get_sdlwindow() : nullptr );
+    colorTargets[0].blend_state.src_color_blendfactor = SDL_GPU_BLENDFACTOR_SRC_ALPHA;
+    colorTargets[0].blend_state.dst_color_blendfactor = SDL_GPU_BLENDFACTOR_ONE_MINUS_SRC_ALPHA;
+    colorTargets[0].blend_state.color_blend_op        = SDL_GPU_BLENDOP_ADD;
+    colorTargets[0].blend_state.src_alpha_blendfactor = SDL_GPU_BLENDFACTOR_SRC_ALPHA;
+    colorTargets[0].blend_state.dst_alpha_blendfactor = SDL_GPU_BLENDFACTOR_ONE_MINUS_SRC_ALPHA;
+    colorTargets[0].blend_state.alpha_blend_op        = SDL_GPU_BLENDOP_ADD;
+    colorTargets[0].blend_state.enable_blend          = true;
+
+    SDL_GPUGraphicsPipelineCreateInfo pipelineCreateInfo     = {};
+    pipelineCreateInfo.vertex_shader                         = vertexShader.get()->get_sdlshader();
+    pipelineCreateInfo.fragment_shader                       = fragmentShader.get()->get_sdlshader();
+    pipelineCreateInfo.primitive_type                        = SDL_GPU_PRIMITIVETYPE_TRIANGLELIST;
+    pipelineCreateInfo.target_info.color_target_descriptions = colorTargets;
+    pipelineCreateInfo.target_info.num_color_targets         = 1;
+
+    // the cells are opaque tiles, empty ones are discarded and leave the depth untouched
+    set_depthstate( pipelineCreateInfo, true );
+
+    m_pipeline = backend->create_graphicspipeline( &pipelineCreateInfo );
+    if ( m_pipeline == nullptr ) {
+        IE_LOG_ERROR( "Failed to create pipeline!" );
+        return false;
+    }
+
+    // cells are looked up texel exact
+    SDL_GPUSamplerCreateInfo samplerCreateInfo = {};
+    samplerCreateInfo.min_filter               = SDL_GPU_FILTER_NEAREST;
+    samplerCreateInfo.mag_filter               = SDL_GPU_FILTER_NEAREST;
+    samplerCreateInfo.mipmap_mode              = SDL_GPU_SAMPLERMIPMAPMODE_NEAREST;
+    samplerCreateInfo.address_mode_u           = SDL_GPU_SAMPLERADDRESSMODE_CLAMP_TO_EDGE;
+    samplerCreateInfo.address_mode_v           = SDL_GPU_SAMPLERADDRESSMODE_CLAMP_TO_EDGE;
+    samplerCreateInfo.address_mode_w           = SDL_GPU_SAMPLERADDRESSMODE_CLAMP_TO_EDGE;
+
+    m_cellSampler = m_renderer->get_sampler( samplerCreateInfo );
+    if ( m_cellSampler == nullptr ) {
+        IE_LOG_ERROR( "Failed to create sampler!" );
+        return false;
+    }
+
+    m_frames.resize( m_renderer->get_frames_in_flight() );
+    m_collectingSlot = m_renderer->get_collecting_frameslot();
+    m_spriteAssets   = CoreAPI::get_assetmanager()->get_repository<Sprite>();
+
+    m_initialized = true;
+    return true;
+}
+
+void TileMapPipeline::submit( uint32_t nextFrameSlot )
+{
+    // nothing is queued, the frame data of the slot is handed over as a whole
+    IE_ASSERT( nextFrameSlot < m_frames.size() );
+    m_collectingSlot = nextFrameSlot;
+}
+
+void TileMapPipeline::begin_dispatch( uint32_t frameSlot )
+{
+    IE_ASSERT( frameSlot < m_frames.size() );
+    m_dispatchSlot = frameSlot;
+}
+
+void TileMapPipeline::end_dispatch()
+{
+    FrameData& frame  = m_frames[m_dispatchSlot];
+    frame.Visible     = false;
+    frame.UploadCells = false;
+}
+
+void TileMapPipeline::dispatch_copycommands( SDL_GPUCommandBuffer* cmdbuf, SDL_GPUCopyPass* copyPass )
+{
+    IE_ASSERT( cmdbuf != nullptr && copyPass != nullptr );
+    (void)cmdbuf;
+
+    FrameData& frame = m_frames[m_dispatchSlot];
+    if ( ensure_celltexture( frame.Width, frame.Height ) == false )
+        return;
+
+    // a resized map is collected as one dirty rectangle covering everything, so the new texture gets filled completely
+    m_renderer->update_texture_region( copyPass, m_cellTexture, frame.DirtyRect, frame.Cells.data(), static_cast<uint32_t>( frame.DirtyRect.w * sizeof( Cell ) ), sizeof( Cell ) );
+}
+
+void TileMapPipeline::dispatch_rendercommands( const DXSM::Matrix& viewProjection, SDL_GPUCommandBuffer* cmdbuf, SDL_GPURenderPass* renderPass )
+{
+    IE_ASSERT( cmdbuf != nullptr && renderPass != nullptr );
+    IE_ASSERT( m_spriteAssets.expired() == false );
+
+    GPUBackend* backend      = m_renderer->get_backend();
+    FrameData&  frame        = m_frames[m_dispatchSlot];
+    auto        spriteAssets = m_spriteAssets.lock();
+
+    // nothing to draw before the first cells were uploaded
+    if ( m_cellTexture == nullptr || frame.Tile.valid() == false || spriteAssets->is_available( frame.Tile ) == false )
+        return;
+
+    auto tile = spriteAssets->get_asset( frame.Tile );
+    if ( tile->is_uploaded() == false )
+        return;
+
+    SDL_GPUTextureSamplerBinding bindings[2] = {};
+    bindings[0]                              = tile->m_textureSamplerBinding;
+    bindings[1].texture                      = m_cellTexture;
+    bindings[1].sampler                      = m_cellSampler;
+
+    backend->bind_graphicspipeline( renderPass, m_pipeline );
+    backend->push_vertex_uniformdata( cmdbuf, 0, &viewProjection, sizeof( DXSM::Matrix ) );
+    backend->push_vertex_uniformdata( cmdbuf, 1, &frame.Uniform, sizeof( TileMapUniform ) );
+    backend->bind_fragment_samplers( renderPass, 0, bindings, 2 );
+    backend->draw_primitives( renderPass, 6, 1, 0, 0 );
+}
+
+const std::string_view TileMapPipeline::get_name() const
+{
+    return "TileMapPipeline";
+}
+
+uint32_t TileMapPipeline::needs_processing() const
+{
+    const FrameData& frame      = m_frames[m_dispatchSlot];
+    uint32_t         processing = 0;
+    if ( frame.UploadCells )
+        processing |= PipelineCommand::Copy;
+    if ( frame.Visible )
+        processing |= PipelineCommand::Render;
+    return processing;
+}
+
+bool TileMapPipeline::hash_commands( CommandHasher& hasher ) const
+{
+    const FrameData& frame = m_frames[m_dispatchSlot];
+    hasher.add( frame.Visible );
+    if ( frame.Visible ) {
+        hasher.add( frame.Tile.get_index() );
+        hasher.add( frame.Width );
+        hasher.add( frame.Height );
+        hasher.add( frame.Uniform );
+    }
+
+    // only collected when the cells changed, the uploaded cells are part of what is drawn
+    hasher.add( frame.UploadCells );
+    if ( frame.UploadCells ) {
+        hasher.add( frame.DirtyRect );
+        hasher.add( frame.Cells.data(), frame.Cells.size() * sizeof( Cell ) );
+    }
+    return true;
+}
+
+void TileMapPipeline::collect( AssetUID<Sprite> tileUID, const Cell* cells, uint16_t width, uint16_t height, float x, float y, float cellWidth, float cellHeight, uint16_t layer )
+{
+    IE_ASSERT( m_initialized );
+    IE_ASSERT( cells != nullptr && width > 0 && height > 0 );
+
+    FrameData& frame = m_frames[m_collectingSlot];
+    IE_ASSERT( frame.Visible == false );    // one map per frame
+
+    frame.Visible        = true;
+    frame.Tile           = tileUID;
+    frame.Uniform.x      = x;
+    frame.Uniform.y      = y;
+    frame.Uniform.width  = width * cellWidth;
+    frame.Uniform.height = height * cellHeight;
+    frame.Uniform.z      = 1.0f - ( ( layer == 0 ) ? 0.0f : static_cast<float>( layer ) / ( std::numeric_limits<uint16_t>::max )() );
+
+    // the cell texture keeps its content, only the rectangle around the changed cells has to be uploaded
+    size_t   count = static_cast<size_t>( width ) * height;
+    SDL_Rect dirty = { 0, 0, width, height };
+    if ( width == m_collectedWidth && height == m_collectedHeight ) {
+        dirty = find_changed_cells( cells );
+        if ( SDL_RectEmpty( &dirty ) )
+            return;
+    }
+
+    m_collectedCells.assign( cells, cells + count );
+    m_collectedWidth  = width;
+    m_collectedHeight = height;
+
+    frame.UploadCells = true;
+    frame.Width       = width;
+    frame.Height      = height;
+    frame.DirtyRect   = dirty;
+    frame.Cells.resize( static_cast<size_t>( dirty.w ) * dirty.h );
+    for ( int row = 0; row < dirty.h; ++row ) {
+        const Cell* source = cells + static_cast<size_t>( dirty.y + row ) * width + dirty.x;
+        SDL_memcpy( frame.Cells.data() + static_cast<size_t>( row ) * dirty.w, source, dirty.w * sizeof( Cell ) );
+    }
+}
+
+SDL_Rect TileMapPipeline::find_changed_cells( const Cell* cells ) const
+{
+    int minX = m_collectedWidth;
+    int minY = m_collectedHeight;
+    int maxX = -1;
+    int maxY = -1;
+
+    for ( int y = 0; y < m_collectedHeight; ++y ) {
+        const Cell* row       = cells + static_cast<size_t>( y ) * m_collectedWidth;
+        const Cell* collected = m_collectedCells.data() + static_cast<size_t>( y ) * m_collectedWidth;
+        if ( SDL_memcmp( row, collected, m_collectedWidth * sizeof( Cell ) ) == 0 )
+            continue;
+
+        for ( int x = 0; x < m_collectedWidth; ++x ) {
+            if ( row[x] != collected[x] ) {
+                minX = std::min( minX, x );
+                maxX = std::max( maxX, x );
+            }
+        }
+        minY = std::min( minY, y );
+        maxY = y;
+    }
+
+    if ( maxY < 0 )
+        return {};
+    return { minX, minY, maxX - minX + 1, maxY - minY + 1 };
+}
+
+bool TileMapPipeline::ensure_celltexture( uint16_t width, uint16_t height )
+{
+    if ( m_cellTexture != nullptr && m_cellTextureWidth == width && m_cellTextureHeight == height )
+        return true;
+
+    GPUBackend* backend = m_renderer->get_backend();
+    if ( m_cellTexture != nullptr )
+        backend->release_texture( m_cellTexture );
+
+    SDL_GPUTextureCreateInfo textureCreateInfo = {};
+    textureCreateInfo.type                     = SDL_GPU_TEXTURETYPE_2D;
+    textureCreateInfo.format                   = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM;
+    textureCreateInfo.usage                    = SDL_GPU_TEXTUREUSAGE_SAMPLER;
+    textureCreateInfo.width                    = width;
+    textureCreateInfo.height                   = height;
+    textureCreateInfo.layer_count_or_depth     = 1;
+    textureCreateInfo.num_levels               = 1;
+
+    m_cellTexture       = backend->create_texture( &textureCreateInfo, "TileMapPipeline" );
+    m_cellTextureWidth  = ( m_cellTexture != nullptr ) ? width : 0;
+    m_cellTextureHeight = ( m_cellTexture != nullptr ) ? height : 0;
+    if ( m_cellTexture == nullptr ) {
+        IE_LOG_ERROR( "Failed to create the cell texture!" );
+        return false;
+    }
+    return true;
+}
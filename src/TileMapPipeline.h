@@ -0,0 +1,88 @@
+#pragma once
+#include "SDL3/SDL_gpu.h"
+
+#include "SimpleMath.h"
+namespace DXSM = DirectX::SimpleMath;
+
+#include "Sprite.h"
+#include "Asset.h"
+#include "AssetRepository.h"
+#include "GPUPipeline.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// Draws a grid of equally sized tiles as a single quad.
+// Every cell is one texel of a small RGBA8 cell texture, the fragment shader looks up the cell of the pixel
+// and tints the tile sprite with the cell color, an alpha of 0 leaves the cell empty.
+// Only the rectangle around the changed cells is uploaded, so a map costs one draw call whatever its size
+// and the uploads scale with the changes, not with the size of the map.
+class TileMapPipeline : public GPUPipeline
+{
+public:
+    // rgba8, red in the lowest byte (DXSM::Color::RGBA())
+    using Cell = uint32_t;
+
+    // see TileMap.vert.hlsl
+    struct TileMapUniform
+    {
+        float x, y, width, height;    // area covered by the map
+        float z, padding_a, padding_b, padding_c;
+    };
+
+    // the frame slots are handed over between the collecting and the render thread like the command queues
+    struct FrameData
+    {
+        bool              Visible     = false;
+        bool              UploadCells = false;    // Cells hold new content for DirtyRect of the cell texture
+        AssetUID<Sprite>  Tile;
+        uint16_t          Width     = 0;
+        uint16_t          Height    = 0;
+        SDL_Rect          DirtyRect = {};
+        TileMapUniform    Uniform   = {};
+        std::vector<Cell> Cells;    // DirtyRect.w * DirtyRect.h cells row by row
+    };
+
+public:
+    TileMapPipeline() = default;
+    virtual ~TileMapPipeline();
+
+    // Geerbt über GPUPipeline
+    bool init( GPURenderer* pRenderer ) override;
+    void submit( uint32_t nextFrameSlot ) override;
+    void begin_dispatch( uint32_t frameSlot ) override;
+    void end_dispatch() override;
+    void dispatch_copycommands( SDL_GPUCommandBuffer* cmdbuf, SDL_GPUCopyPass* copyPass ) override;
+    void dispatch_rendercommands( const DXSM::Matrix& viewProjection, SDL_GPUCommandBuffer* cmdbuf, SDL_GPURenderPass* renderPass ) override;
+
+    const std::string_view get_name() const override;
+    uint32_t               needs_processing() const override;
+    bool                   hash_commands( CommandHasher& hasher ) const override;
+
+    // not threadsafe, call once per frame from the thread that submits the frames
+    // cells holds width * height cells row by row, the map is drawn with its top left corner at x, y
+    void collect( AssetUID<Sprite> tileUID, const Cell* cells, uint16_t width, uint16_t height, float x, float y, float cellWidth, float cellHeight, uint16_t layer = 0 );
+
+private:
+    bool ensure_celltexture( uint16_t width, uint16_t height );
+    // bounding rectangle of the cells that differ from the collected ones, empty if none does
+    SDL_Rect find_changed_cells( const Cell* cells ) const;
+
+private:
+    std::weak_ptr<AssetRepository<Sprite>> m_spriteAssets;
+
+    std::vector<FrameData> m_frames;
+    uint32_t               m_collectingSlot = 0;
+
+    // content of the cell texture as last collected, only used by the collecting thread
+    std::vector<Cell> m_collectedCells;
+    uint16_t          m_collectedWidth  = 0;
+    uint16_t          m_collectedHeight = 0;
+
+    // render thread only
+    SDL_GPUTexture* m_cellTexture       = nullptr;
+    SDL_GPUSampler* m_cellSampler       = nullptr;    // owned by the renderer
+    uint16_t        m_cellTextureWidth  = 0;
+    uint16_t        m_cellTextureHeight = 0;
+};
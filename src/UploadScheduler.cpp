@@ -0,0 +1,269 @@
+#include "iepch.h"
+#include "UploadScheduler.h"
+
+#include "GPUBackend.h"
+#include "PixelConverter.h"
+#include "RenderGraph.h"
+
+UploadState UploadStatus::get_state() const
+{
+    return m_state.load( std::memory_order_acquire );
+}
+
+bool UploadStatus::is_scheduled() const
+{
+    UploadState state = get_state();
+    return state == UploadState::Scheduled || state == UploadState::Resident;
+}
+
+bool UploadStatus::is_resident() const
+{
+    return get_state() == UploadState::Resident;
+}
+
+bool UploadStatus::cancel()
+{
+    UploadState expected = UploadState::Queued;
+    return m_state.compare_exchange_strong( expected, UploadState::Cancelled, std::memory_order_acq_rel );
+}
+
+UploadScheduler::~UploadScheduler()
+{
+    release();
+}
+
+void UploadScheduler::init( StagingRing* stagingRing, uint32_t frameSlots, uint32_t frameBudget )
+{
+    IE_ASSERT( stagingRing != nullptr && frameSlots > 0 );
+    m_stagingRing = stagingRing;
+    m_frameBudget = frameBudget;
+    m_frameUploads.resize( frameSlots );
+}
+
+void UploadScheduler::release()
+{
+    for ( auto& uploads : m_frameUploads ) {
+        for ( Upload& upload : uploads )
+            destroy_upload( upload );
+    }
+    m_frameUploads.clear();
+
+    std::lock_guard<std::mutex> lock( m_requestMutex );
+    for ( Upload& upload : m_requests )
+        destroy_upload( upload );
+    m_requests.clear();
+}
+
+UploadHandle UploadScheduler::request_texture( SDL_GPUTexture* texture, SDL_Surface* surface, bool premultiply )
+{
+    IE_ASSERT( texture != nullptr && surface != nullptr );
+
+    Upload upload;
+    upload.Texture     = texture;
+    upload.Surface     = surface;
+    upload.Width       = static_cast<uint32_t>( surface->w );
+    upload.Height      = static_cast<uint32_t>( surface->h );
+    upload.Premultiply = premultiply;
+    upload.Status      = std::make_shared<UploadStatus>();
+
+    UploadHandle status = upload.Status;
+    std::lock_guard<std::mutex> lock( m_requestMutex );
+    m_requests.push_back( std::move( upload ) );
+    return status;
+}
+
+UploadHandle UploadScheduler::request_texture( SDL_GPUTexture* texture, std::vector<Uint8> data, std::vector<UploadLevel> levels )
+{
+    IE_ASSERT( texture != nullptr && data.empty() == false && levels.empty() == false );
+
+    Upload upload;
+    upload.Texture = texture;
+    upload.Data    = std::move( data );
+    upload.Levels  = std::move( levels );
+    upload.Status  = std::make_shared<UploadStatus>();
+
+    UploadHandle status = upload.Status;
+    std::lock_guard<std::mutex> lock( m_requestMutex );
+    m_requests.push_back( std::move( upload ) );
+    return status;
+}
+
+UploadHandle UploadScheduler::request_buffer( SDL_GPUBuffer* buffer, const void* data, uint32_t size )
+{
+    IE_ASSERT( buffer != nullptr && data != nullptr && size > 0 );
+
+    Upload upload;
+    upload.Buffer = buffer;
+    upload.Data.assign( static_cast<const Uint8*>( data ), static_cast<const Uint8*>( data ) + size );
+    upload.Status = std::make_shared<UploadStatus>();
+
+    UploadHandle status = upload.Status;
+    std::lock_guard<std::mutex> lock( m_requestMutex );
+    m_requests.push_back( std::move( upload ) );
+    return status;
+}
+
+void UploadScheduler::declare_passes( RenderGraph& graph, uint32_t frameSlot, bool unlimitedBudget )
+{
+    IE_ASSERT( frameSlot < m_frameUploads.size() );
+    std::vector<Upload>& uploads = m_frameUploads[frameSlot];
+    IE_ASSERT( uploads.empty() );
+
+    {
+        // the first upload is always taken, so one bigger than the budget does not block the queue
+        std::lock_guard<std::mutex> lock( m_requestMutex );
+        uint64_t                    budgetUsed = 0;
+        while ( m_requests.empty() == false ) {
+            Upload& upload = m_requests.front();
+            if ( unlimitedBudget == false && uploads.empty() == false && budgetUsed + upload.get_size() > m_frameBudget )
+                break;
+
+            budgetUsed += upload.get_size();
+            uploads.push_back( std::move( upload ) );
+            m_requests.pop_front();
+        }
+    }
+
+    // owners that released their resource in the meantime already dropped it
+    for ( Upload& upload : uploads ) {
+        UploadState expected = UploadState::Queued;
+        if ( upload.Status->m_state.compare_exchange_strong( expected, UploadState::Scheduled, std::memory_order_acq_rel ) == false ) {
+            destroy_upload( upload );
+        }
+        else if ( stage( upload ) == false ) {
+            // tried again next frame
+            upload.Status->m_state.store( UploadState::Queued, std::memory_order_release );
+            std::lock_guard<std::mutex> lock( m_requestMutex );
+            m_requests.push_back( std::move( upload ) );
+            upload.Status = nullptr;
+        }
+    }
+    std::erase_if( uploads, []( const Upload& upload ) { return upload.Status == nullptr; } );
+
+    if ( uploads.empty() )
+        return;
+
+    // nothing inside the graph reads the upload resource, the pass is declared before the passes drawing with the uploaded data
+    RenderResourceID uploadResource = graph.declare_resource( "AssetUpload" );
+    graph.mark_output( uploadResource );
+
+    graph.add_copypass( "AssetUpload", {}, { uploadResource }, [this, frameSlot]( RenderPassContext& context ) {
+        for ( Upload& upload : m_frameUploads[frameSlot] ) {
+            if ( upload.Texture != nullptr && upload.Levels.empty() == false ) {
+                // block compressed levels are tightly packed, SDL derives the row pitch from the format
+                for ( uint32_t level = 0; level < upload.Levels.size(); ++level ) {
+                    SDL_GPUTextureTransferInfo transferInfo = {};
+                    transferInfo.transfer_buffer            = upload.Allocation.TransferBuffer;
+                    transferInfo.offset                     = upload.Allocation.Offset + upload.Levels[level].Offset;
+
+                    SDL_GPUTextureRegion region = {};
+                    region.texture              = upload.Texture;
+                    region.mip_level            = level;
+                    region.w                    = upload.Levels[level].Width;
+                    region.h                    = upload.Levels[level].Height;
+                    region.d                    = 1;
+
+                    context.Backend->upload_to_texture( context.CopyPass, &transferInfo, &region, false );
+                }
+            }
+            else if ( upload.Texture != nullptr ) {
+                SDL_GPUTextureTransferInfo transferInfo = {};
+                transferInfo.transfer_buffer            = upload.Allocation.TransferBuffer;
+                transferInfo.offset                     = upload.Allocation.Offset;
+                transferInfo.pixels_per_row             = upload.Width;
+                transferInfo.rows_per_layer             = upload.Height;
+
+                SDL_GPUTextureRegion region = {};
+                region.texture              = upload.Texture;
+                region.w                    = upload.Width;
+                region.h                    = upload.Height;
+                region.d                    = 1;
+
+                context.Backend->upload_to_texture( context.CopyPass, &transferInfo, &region, false );
+            }
+            else {
+                SDL_GPUTransferBufferLocation location { .transfer_buffer = upload.Allocation.TransferBuffer, .offset = upload.Allocation.Offset };
+                SDL_GPUBufferRegion           region { .buffer = upload.Buffer, .offset = 0, .size = upload.get_size() };
+                context.Backend->upload_to_buffer( context.CopyPass, &location, &region, false );
+            }
+            upload.Recorded = true;
+        }
+    } );
+}
+
+void UploadScheduler::retire( uint32_t frameSlot )
+{
+    IE_ASSERT( frameSlot < m_frameUploads.size() );
+    std::vector<Upload>& uploads = m_frameUploads[frameSlot];
+
+    for ( Upload& upload : uploads ) {
+        if ( upload.Recorded ) {
+            m_uploadedCount.fetch_add( 1, std::memory_order_relaxed );
+            m_uploadedBytes.fetch_add( upload.get_size(), std::memory_order_relaxed );
+            upload.Status->m_state.store( UploadState::Resident, std::memory_order_release );
+            destroy_upload( upload );
+            continue;
+        }
+
+        // the frame was dropped, the staged copy is gone with it
+        upload.Recorded   = false;
+        upload.Allocation = {};
+        upload.Status->m_state.store( UploadState::Queued, std::memory_order_release );
+
+        std::lock_guard<std::mutex> lock( m_requestMutex );
+        m_requests.push_front( std::move( upload ) );
+    }
+    uploads.clear();
+}
+
+uint32_t UploadScheduler::get_pending_count() const
+{
+    std::lock_guard<std::mutex> lock( m_requestMutex );
+    return static_cast<uint32_t>( m_requests.size() );
+}
+
+uint64_t UploadScheduler::get_uploaded_count() const
+{
+    return m_uploadedCount.load( std::memory_order_relaxed );
+}
+
+uint64_t UploadScheduler::get_uploaded_bytes() const
+{
+    return m_uploadedBytes.load( std::memory_order_relaxed );
+}
+
+uint32_t UploadScheduler::Upload::get_size() const
+{
+    return ( Surface != nullptr ) ? Width * Height * 4 : static_cast<uint32_t>( Data.size() );
+}
+
+bool UploadScheduler::stage( Upload& upload )
+{
+    uint32_t size = upload.get_size();
+    Uint8*   data = m_stagingRing->begin_write( size, upload.Allocation );
+    if ( data == nullptr )
+        return false;
+
+    if ( upload.Surface != nullptr ) {
+        // converted straight into the mapped memory with tightly packed rows, there is no intermediate RGBA8 copy
+        // a surface that can not be converted is uploaded transparent instead of being retried every frame
+        if ( PixelConverter::convert_to_rgba8( upload.Surface, data, upload.Width * 4, upload.Premultiply ) == false )
+            SDL_memset( data, 0, size );
+    }
+    else {
+        SDL_memcpy( data, upload.Data.data(), size );
+    }
+
+    m_stagingRing->end_write( upload.Allocation );
+    return true;
+}
+
+void UploadScheduler::destroy_upload( Upload& upload )
+{
+    if ( upload.Surface ) {
+        SDL_DestroySurface( upload.Surface );
+        upload.Surface = nullptr;
+    }
+    upload.Data.clear();
+    upload.Status = nullptr;
+}
@@ -0,0 +1,121 @@
+#pragma once
+#include "SDL3/SDL_gpu.h"
+#include "SDL3/SDL_surface.h"
+
+#include "StagingRing.h"
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class RenderGraph;
+
+enum class UploadState : uint8_t
+{
+    Queued = 0,    // waiting for a frame with enough upload budget
+    Scheduled,     // recorded into the frame that is processed, everything recorded after it sees the data
+    Resident,      // the fence of that frame signaled
+    Cancelled      // the destination was released before the upload was scheduled
+};
+
+// one mip level of a texture upload, tightly packed at Offset in the data
+struct UploadLevel
+{
+    uint32_t Offset = 0;
+    uint32_t Width  = 0;
+    uint32_t Height = 0;
+};
+
+// shared between the owner of the destination and the scheduler
+class UploadStatus
+{
+public:
+    UploadState get_state() const;
+
+    // the destination can be used by commands recorded on the render thread
+    bool is_scheduled() const;
+    bool is_resident() const;
+
+    // call before releasing the destination, returns false when the upload was already recorded.
+    // SDL keeps released resources alive until the commandbuffers using them are done, so that is fine as well.
+    bool cancel();
+
+private:
+    friend class UploadScheduler;
+    std::atomic<UploadState> m_state = UploadState::Queued;
+};
+
+using UploadHandle = std::shared_ptr<UploadStatus>;
+
+// Uploads of asset data into gpu textures and buffers.
+// Requests are queued from any thread and recorded by the render thread into a single copy pass of the next processed frames,
+// the data goes through the staging ring of the renderer. Every frame records at most the byte budget (but at least one upload),
+// so loading a level spreads over a few frames instead of submitting a commandbuffer per asset.
+class UploadScheduler
+{
+public:
+    UploadScheduler() = default;
+    ~UploadScheduler();
+
+    UploadScheduler( const UploadScheduler& other )            = delete;
+    UploadScheduler( UploadScheduler&& other )                 = delete;
+    UploadScheduler& operator=( const UploadScheduler& other ) = delete;
+    UploadScheduler& operator=( UploadScheduler&& other )      = delete;
+
+    void init( StagingRing* stagingRing, uint32_t frameSlots, uint32_t frameBudget );
+    void release();
+
+    // threadsafe, takes ownership of the surface and destroys it once the upload is resident
+    // the surface has to cover all of the RGBA8 texture, it is converted from its format while staging
+    UploadHandle request_texture( SDL_GPUTexture* texture, SDL_Surface* surface, bool premultiply );
+    // threadsafe, uploads every level of a texture, e.g. a block compressed one with its mips
+    UploadHandle request_texture( SDL_GPUTexture* texture, std::vector<Uint8> data, std::vector<UploadLevel> levels );
+    // threadsafe, the data is copied
+    UploadHandle request_buffer( SDL_GPUBuffer* buffer, const void* data, uint32_t size );
+
+    // render thread only, declare before the passes that use the uploaded resources
+    // an unlimited budget records everything that is queued
+    void declare_passes( RenderGraph& graph, uint32_t frameSlot, bool unlimitedBudget = false );
+
+    // render thread only, the fence of the frame slot has to be signaled
+    // uploads that never made it into a submitted commandbuffer are queued again
+    void retire( uint32_t frameSlot );
+
+    uint32_t get_pending_count() const;
+    uint64_t get_uploaded_count() const;
+    uint64_t get_uploaded_bytes() const;
+
+private:
+    struct Upload
+    {
+        SDL_GPUTexture*          Texture = nullptr;
+        SDL_GPUBuffer*           Buffer  = nullptr;
+        SDL_Surface*             Surface = nullptr;
+        std::vector<Uint8>       Data;
+        std::vector<UploadLevel> Levels;    // only for textures without a surface
+        uint32_t                 Width       = 0;
+        uint32_t                 Height      = 0;
+        bool                     Premultiply = false;
+        UploadHandle             Status;
+        StagingRing::Allocation  Allocation;
+        bool                     Recorded = false;
+
+        uint32_t get_size() const;
+    };
+
+    bool stage( Upload& upload );
+    void destroy_upload( Upload& upload );
+
+private:
+    StagingRing*                     m_stagingRing = nullptr;
+    uint32_t                         m_frameBudget = 0;
+    std::vector<std::vector<Upload>> m_frameUploads;    // recorded into the frame in this slot
+
+    mutable std::mutex m_requestMutex;
+    std::deque<Upload> m_requests;
+
+    std::atomic<uint64_t> m_uploadedCount = 0;
+    std::atomic<uint64_t> m_uploadedBytes = 0;
+};